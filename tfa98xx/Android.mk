@@ -36,6 +36,7 @@ LOCAL_C_INCLUDES:=     $(LOCAL_PATH)/tfa/inc\
 LOCAL_SRC_FILES := 	\
 			tfa/src/initTfa9890.c\
 			tfa/src/Tfa98xx.c\
+			tfa/src/Tfa98xx_convert.c\
 			tfa/src/Tfa98xx_TextSupport.c\
 			tfa/src/Tfa98API.c
 
@@ -65,6 +66,7 @@ LOCAL_SRC_FILES:= 	srv/src/nxpTfa98xx.c\
             srv/src/tfaOsal.c\
 			srv/src/tfaContainer.c\
 			srv/src/tfaContainerWrite.c\
+			srv/src/tfaContCompile.c\
             srv/src/tfaContUtil.c\
 			srv/src/iniFile/minIni.c
 LOCAL_MODULE := libsrv
@@ -25,6 +25,7 @@ char *cliInit(int argc, char **argv);
 int cliCommands(int targetfd, char *xarg, Tfa98xx_handle_t *handlesIn);
 
 int cliTargetDevice(char *devname);
+int cliTargetBus(char *busarg);
 #ifndef WIN32
 void cliSocketServer(char *socket);
 void cliClientServer(char *socket);
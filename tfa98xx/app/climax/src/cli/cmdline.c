@@ -93,8 +93,20 @@ const char *gengetopt_args_info_full_help[] = {
   "      --slave=i2c address       override hardcoded I2C slave address",
   "  -L, --loop=count              loop the operation [0=forever]",
   "  -b, --verbose[=mask]          Enable verbose\n                                  (mask=timing|i2cserver|socket|scribo)",
-  "  -t, --trace[=filename]        Enable I2C transaction tracing to stdout/file",
+  "  -t, --trace[=filename]        Enable I2C transaction tracing to stdout/file,\n                                  printed from the trace ring when done",
   "  -q, --quiet                   Suppress printing to stdout",
+  "      --tracedump=filename      write the binary I2C trace ring to a file when\n                                  done",
+  "      --tracedecode=filename    print the binary I2C trace file written by\n                                  --tracedump",
+  "      --i2cstats                print the I2C transaction counts and latencies\n                                  per slave and subaddress, then reset them",
+  "      --parallel                cold start the devices concurrently, one thread per\n                                  device",
+  "      --broadcast               cold start the devices together, shared files once\n                                  via the generic address",
+  "      --irq[=file]              wait for the DSP on the interrupt pin, file is the\n                                  gpio value, without file the pin of the target if\n                                  it has one (e.g. -ddummy,irq), else the DSP is\n                                  polled",
+  "      --compile=file            record the profile switches of the started devices\n                                  to file",
+  "      --compiled=file           switch profiles with the file made by --compile",
+  "      --shadow                  keep a shadow of the registers, a read-modify-write\n                                  only writes",
+  "      --paramcache              skip the parameter uploads the DSP has from this\n                                  process already",
+  "      --i2cmax=bytes            largest I2C message of an i2c-dev adapter, incl\n                                  the slave address",
+  "      --bus=nr=target           the target of bus nr of the container device list,\n                                  e.g. 1=/dev/i2c-3, the -d target is bus 0",
     0
 };
 
@@ -146,11 +158,23 @@ init_help_array(void)
   gengetopt_args_info_help[42] = gengetopt_args_info_full_help[46];
   gengetopt_args_info_help[43] = gengetopt_args_info_full_help[47];
   gengetopt_args_info_help[44] = gengetopt_args_info_full_help[48];
-  gengetopt_args_info_help[45] = 0;
+  gengetopt_args_info_help[45] = gengetopt_args_info_full_help[49];
+  gengetopt_args_info_help[46] = gengetopt_args_info_full_help[50];
+  gengetopt_args_info_help[47] = gengetopt_args_info_full_help[51];
+  gengetopt_args_info_help[48] = gengetopt_args_info_full_help[52];
+  gengetopt_args_info_help[49] = gengetopt_args_info_full_help[53];
+  gengetopt_args_info_help[50] = gengetopt_args_info_full_help[54];
+  gengetopt_args_info_help[51] = gengetopt_args_info_full_help[55];
+  gengetopt_args_info_help[52] = gengetopt_args_info_full_help[56];
+  gengetopt_args_info_help[53] = gengetopt_args_info_full_help[57];
+  gengetopt_args_info_help[54] = gengetopt_args_info_full_help[58];
+  gengetopt_args_info_help[55] = gengetopt_args_info_full_help[59];
+  gengetopt_args_info_help[56] = gengetopt_args_info_full_help[60];
+  gengetopt_args_info_help[57] = 0;
 
 }
 
-const char *gengetopt_args_info_help[46];
+const char *gengetopt_args_info_help[58];
 
 typedef enum {ARG_NO
   , ARG_STRING
@@ -218,6 +242,18 @@ void clear_given (struct gengetopt_args_info *args_info)
   args_info->verbose_given = 0 ;
   args_info->trace_given = 0 ;
   args_info->quiet_given = 0 ;
+  args_info->tracedump_given = 0 ;
+  args_info->tracedecode_given = 0 ;
+  args_info->i2cstats_given = 0 ;
+  args_info->parallel_given = 0 ;
+  args_info->broadcast_given = 0 ;
+  args_info->irq_given = 0 ;
+  args_info->compile_given = 0 ;
+  args_info->compiled_given = 0 ;
+  args_info->shadow_given = 0 ;
+  args_info->paramcache_given = 0 ;
+  args_info->i2cmax_given = 0 ;
+  args_info->bus_given = 0 ;
 }
 
 static
@@ -275,6 +311,19 @@ void clear_args (struct gengetopt_args_info *args_info)
   args_info->verbose_orig = NULL;
   args_info->trace_arg = NULL;
   args_info->trace_orig = NULL;
+  args_info->tracedump_arg = NULL;
+  args_info->tracedump_orig = NULL;
+  args_info->tracedecode_arg = NULL;
+  args_info->tracedecode_orig = NULL;
+  args_info->irq_arg = NULL;
+  args_info->irq_orig = NULL;
+  args_info->compile_arg = NULL;
+  args_info->compile_orig = NULL;
+  args_info->compiled_arg = NULL;
+  args_info->compiled_orig = NULL;
+  args_info->i2cmax_orig = NULL;
+  args_info->bus_arg = NULL;
+  args_info->bus_orig = NULL;
 
 }
 
@@ -335,6 +384,20 @@ void init_args_info(struct gengetopt_args_info *args_info)
   args_info->verbose_help = gengetopt_args_info_full_help[46] ;
   args_info->trace_help = gengetopt_args_info_full_help[47] ;
   args_info->quiet_help = gengetopt_args_info_full_help[48] ;
+  args_info->tracedump_help = gengetopt_args_info_full_help[49] ;
+  args_info->tracedecode_help = gengetopt_args_info_full_help[50] ;
+  args_info->i2cstats_help = gengetopt_args_info_full_help[51] ;
+  args_info->parallel_help = gengetopt_args_info_full_help[52] ;
+  args_info->broadcast_help = gengetopt_args_info_full_help[53] ;
+  args_info->irq_help = gengetopt_args_info_full_help[54] ;
+  args_info->compile_help = gengetopt_args_info_full_help[55] ;
+  args_info->compiled_help = gengetopt_args_info_full_help[56] ;
+  args_info->shadow_help = gengetopt_args_info_full_help[57] ;
+  args_info->paramcache_help = gengetopt_args_info_full_help[58] ;
+  args_info->i2cmax_help = gengetopt_args_info_full_help[59] ;
+  args_info->bus_help = gengetopt_args_info_full_help[60] ;
+  args_info->bus_min = 0;
+  args_info->bus_max = 0;
 
 }
 
@@ -536,6 +599,18 @@ cmdline_parser_release (struct gengetopt_args_info *args_info)
   free_string_field (&(args_info->verbose_orig));
   free_string_field (&(args_info->trace_arg));
   free_string_field (&(args_info->trace_orig));
+  free_string_field (&(args_info->tracedump_arg));
+  free_string_field (&(args_info->tracedump_orig));
+  free_string_field (&(args_info->tracedecode_arg));
+  free_string_field (&(args_info->tracedecode_orig));
+  free_string_field (&(args_info->irq_arg));
+  free_string_field (&(args_info->irq_orig));
+  free_string_field (&(args_info->compile_arg));
+  free_string_field (&(args_info->compile_orig));
+  free_string_field (&(args_info->compiled_arg));
+  free_string_field (&(args_info->compiled_orig));
+  free_string_field (&(args_info->i2cmax_orig));
+  free_multiple_string_field (args_info->bus_given, &(args_info->bus_arg), &(args_info->bus_orig));
 
 
 
@@ -653,6 +728,29 @@ cmdline_parser_dump(FILE *outfile, struct gengetopt_args_info *args_info)
     write_into_file(outfile, "trace", args_info->trace_orig, 0);
   if (args_info->quiet_given)
     write_into_file(outfile, "quiet", 0, 0 );
+  if (args_info->tracedump_given)
+    write_into_file(outfile, "tracedump", args_info->tracedump_orig, 0);
+  if (args_info->tracedecode_given)
+    write_into_file(outfile, "tracedecode", args_info->tracedecode_orig, 0);
+  if (args_info->i2cstats_given)
+    write_into_file(outfile, "i2cstats", 0, 0 );
+  if (args_info->parallel_given)
+    write_into_file(outfile, "parallel", 0, 0 );
+  if (args_info->broadcast_given)
+    write_into_file(outfile, "broadcast", 0, 0 );
+  if (args_info->irq_given)
+    write_into_file(outfile, "irq", args_info->irq_orig, 0);
+  if (args_info->compile_given)
+    write_into_file(outfile, "compile", args_info->compile_orig, 0);
+  if (args_info->compiled_given)
+    write_into_file(outfile, "compiled", args_info->compiled_orig, 0);
+  if (args_info->shadow_given)
+    write_into_file(outfile, "shadow", 0, 0 );
+  if (args_info->paramcache_given)
+    write_into_file(outfile, "paramcache", 0, 0 );
+  if (args_info->i2cmax_given)
+    write_into_file(outfile, "i2cmax", args_info->i2cmax_orig, 0);
+  write_multiple_into_file(outfile, args_info->bus_given, "bus", args_info->bus_orig, 0);
 
 
   i = EXIT_SUCCESS;
@@ -919,6 +1017,9 @@ cmdline_parser_required2 (struct gengetopt_args_info *args_info, const char *pro
   if (check_multiple_option_occurrences(prog_name, args_info->xmem_given, args_info->xmem_min, args_info->xmem_max, "'--xmem' ('-x')"))
      error = 1;
 
+  if (check_multiple_option_occurrences(prog_name, args_info->bus_given, args_info->bus_min, args_info->bus_max, "'--bus'"))
+     error = 1;
+
 
   /* checks for dependences among options */
   if (args_info->currentprof_given && ! args_info->profile_given)
@@ -1211,6 +1312,7 @@ cmdline_parser_internal (
   struct generic_list * register_list = NULL;
   struct generic_list * regwrite_list = NULL;
   struct generic_list * xmem_list = NULL;
+  struct generic_list * bus_list = NULL;
   int error = 0;
   struct gengetopt_args_info local_args_info;
 
@@ -1283,6 +1385,18 @@ cmdline_parser_internal (
         { "verbose",    2, NULL, 'b' },
         { "trace",    2, NULL, 't' },
         { "quiet",    0, NULL, 'q' },
+        { "tracedump",    1, NULL, 0 },
+        { "tracedecode",    1, NULL, 0 },
+        { "i2cstats",    0, NULL, 0 },
+        { "parallel",    0, NULL, 0 },
+        { "broadcast",    0, NULL, 0 },
+        { "irq",    2, NULL, 0 },
+        { "compile",    1, NULL, 0 },
+        { "compiled",    1, NULL, 0 },
+        { "shadow",    0, NULL, 0 },
+        { "paramcache",    0, NULL, 0 },
+        { "i2cmax",    1, NULL, 0 },
+        { "bus",    1, NULL, 0 },
         { 0,  0, 0, 0 }
       };
 
@@ -1511,7 +1625,7 @@ cmdline_parser_internal (
             goto failure;
 
           break;
-        case 't':    /* Enable I2C transaction tracing to stdout/file.  */
+        case 't':    /* Enable I2C transaction tracing to stdout/file, printed from the trace ring when done.  */
 
 
           if (update_arg( (void *)&(args_info->trace_arg),
@@ -1816,6 +1930,171 @@ cmdline_parser_internal (
 
           }
 
+          /* write the binary I2C trace ring to a file when done.  */
+          else if (strcmp (long_options[option_index].name, "tracedump") == 0)
+          {
+
+
+            if (update_arg( (void *)&(args_info->tracedump_arg),
+                 &(args_info->tracedump_orig), &(args_info->tracedump_given),
+                &(local_args_info.tracedump_given), optarg, 0, 0, ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "tracedump", '-',
+                additional_error))
+              goto failure;
+
+          }
+          /* print the binary I2C trace file written by --tracedump.  */
+          else if (strcmp (long_options[option_index].name, "tracedecode") == 0)
+          {
+
+
+            if (update_arg( (void *)&(args_info->tracedecode_arg),
+                 &(args_info->tracedecode_orig), &(args_info->tracedecode_given),
+                &(local_args_info.tracedecode_given), optarg, 0, 0, ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "tracedecode", '-',
+                additional_error))
+              goto failure;
+
+          }
+          /* print the I2C transaction counts and latencies per slave and subaddress, then reset them.  */
+          else if (strcmp (long_options[option_index].name, "i2cstats") == 0)
+          {
+
+
+            if (update_arg( 0 ,
+                 0 , &(args_info->i2cstats_given),
+                &(local_args_info.i2cstats_given), optarg, 0, 0, ARG_NO,
+                check_ambiguity, override, 0, 0,
+                "i2cstats", '-',
+                additional_error))
+              goto failure;
+
+          }
+          /* cold start the devices concurrently, one thread per device.  */
+          else if (strcmp (long_options[option_index].name, "parallel") == 0)
+          {
+
+
+            if (update_arg( 0 ,
+                 0 , &(args_info->parallel_given),
+                &(local_args_info.parallel_given), optarg, 0, 0, ARG_NO,
+                check_ambiguity, override, 0, 0,
+                "parallel", '-',
+                additional_error))
+              goto failure;
+
+          }
+          /* .  */
+          else if (strcmp (long_options[option_index].name, "broadcast") == 0)
+          {
+
+
+            if (update_arg( 0 ,
+                 0 , &(args_info->broadcast_given),
+                &(local_args_info.broadcast_given), optarg, 0, 0, ARG_NO,
+                check_ambiguity, override, 0, 0,
+                "broadcast", '-',
+                additional_error))
+              goto failure;
+
+          }
+          /* wait for the DSP on the interrupt pin.  */
+          else if (strcmp (long_options[option_index].name, "irq") == 0)
+          {
+
+
+            if (update_arg( (void *)&(args_info->irq_arg),
+                 &(args_info->irq_orig), &(args_info->irq_given),
+                &(local_args_info.irq_given), optarg, 0, 0, ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "irq", '-',
+                additional_error))
+              goto failure;
+
+          }
+          /* record the profile switches of the started devices to file.  */
+          else if (strcmp (long_options[option_index].name, "compile") == 0)
+          {
+
+
+            if (update_arg( (void *)&(args_info->compile_arg),
+                 &(args_info->compile_orig), &(args_info->compile_given),
+                &(local_args_info.compile_given), optarg, 0, 0, ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "compile", '-',
+                additional_error))
+              goto failure;
+
+          }
+          /* switch profiles with the file made by --compile.  */
+          else if (strcmp (long_options[option_index].name, "compiled") == 0)
+          {
+
+
+            if (update_arg( (void *)&(args_info->compiled_arg),
+                 &(args_info->compiled_orig), &(args_info->compiled_given),
+                &(local_args_info.compiled_given), optarg, 0, 0, ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "compiled", '-',
+                additional_error))
+              goto failure;
+
+          }
+          /* keep a shadow of the registers, a read-modify-write only writes.  */
+          else if (strcmp (long_options[option_index].name, "shadow") == 0)
+          {
+
+
+            if (update_arg( 0 ,
+                 0 , &(args_info->shadow_given),
+                &(local_args_info.shadow_given), optarg, 0, 0, ARG_NO,
+                check_ambiguity, override, 0, 0,
+                "shadow", '-',
+                additional_error))
+              goto failure;
+
+          }
+          /* skip the parameter uploads the DSP has from this process already.  */
+          else if (strcmp (long_options[option_index].name, "paramcache") == 0)
+          {
+
+
+            if (update_arg( 0 ,
+                 0 , &(args_info->paramcache_given),
+                &(local_args_info.paramcache_given), optarg, 0, 0, ARG_NO,
+                check_ambiguity, override, 0, 0,
+                "paramcache", '-',
+                additional_error))
+              goto failure;
+
+          }
+          /* largest I2C message of an i2c-dev adapter, incl the slave address.  */
+          else if (strcmp (long_options[option_index].name, "i2cmax") == 0)
+          {
+
+
+            if (update_arg( (void *)&(args_info->i2cmax_arg),
+                 &(args_info->i2cmax_orig), &(args_info->i2cmax_given),
+                &(local_args_info.i2cmax_given), optarg, 0, 0, ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "i2cmax", '-',
+                additional_error))
+              goto failure;
+
+          }
+          /* the target of bus nr of the container device list, e.g. 1=/dev/i2c-3, the -d target is bus 0.  */
+          else if (strcmp (long_options[option_index].name, "bus") == 0)
+          {
+
+            if (update_multiple_arg_temp(&bus_list,
+                &(local_args_info.bus_given), optarg, 0, 0, ARG_STRING,
+                "bus", '-',
+                additional_error))
+              goto failure;
+
+          }
           break;
         case '?':    /* Invalid option.  */
           /* `getopt_long' already printed an error message.  */
@@ -1848,6 +2127,10 @@ cmdline_parser_internal (
     &(args_info->xmem_orig), args_info->xmem_given,
     local_args_info.xmem_given, 0,
     ARG_INT, xmem_list);
+  update_multiple_arg((void *)&(args_info->bus_arg),
+    &(args_info->bus_orig), args_info->bus_given,
+    local_args_info.bus_given, 0,
+    ARG_STRING, bus_list);
 
   args_info->volume_given += local_args_info.volume_given;
   local_args_info.volume_given = 0;
@@ -1859,6 +2142,8 @@ cmdline_parser_internal (
   local_args_info.regwrite_given = 0;
   args_info->xmem_given += local_args_info.xmem_given;
   local_args_info.xmem_given = 0;
+  args_info->bus_given += local_args_info.bus_given;
+  local_args_info.bus_given = 0;
 
   if (check_required)
     {
@@ -1878,6 +2163,7 @@ failure:
   free_list (register_list, 0 );
   free_list (regwrite_list, 0 );
   free_list (xmem_list, 0 );
+  free_list (bus_list, 1 );
 
   cmdline_parser_release (&local_args_info);
   return (EXIT_FAILURE);
@@ -156,10 +156,38 @@ struct gengetopt_args_info
   int verbose_arg;    /**< @brief Enable verbose (mask=timing|i2cserver|socket|scribo).  */
   char * verbose_orig;    /**< @brief Enable verbose (mask=timing|i2cserver|socket|scribo) original value given at command line.  */
   const char *verbose_help; /**< @brief Enable verbose (mask=timing|i2cserver|socket|scribo) help description.  */
-  char * trace_arg;    /**< @brief Enable I2C transaction tracing to stdout/file.  */
-  char * trace_orig;    /**< @brief Enable I2C transaction tracing to stdout/file original value given at command line.  */
-  const char *trace_help; /**< @brief Enable I2C transaction tracing to stdout/file help description.  */
+  char * trace_arg;    /**< @brief Enable I2C transaction tracing to stdout/file, printed from the trace ring when done.  */
+  char * trace_orig;    /**< @brief Enable I2C transaction tracing to stdout/file, printed from the trace ring when done original value given at command line.  */
+  const char *trace_help; /**< @brief Enable I2C transaction tracing to stdout/file, printed from the trace ring when done help description.  */
   const char *quiet_help; /**< @brief Suppress printing to stdout help description.  */
+  char * tracedump_arg;    /**< @brief write the binary I2C trace ring to a file when done.  */
+  char * tracedump_orig;    /**< @brief write the binary I2C trace ring to a file when done original value given at command line.  */
+  const char *tracedump_help; /**< @brief write the binary I2C trace ring to a file when done help description.  */
+  char * tracedecode_arg;    /**< @brief print the binary I2C trace file written by --tracedump.  */
+  char * tracedecode_orig;    /**< @brief print the binary I2C trace file written by --tracedump original value given at command line.  */
+  const char *tracedecode_help; /**< @brief print the binary I2C trace file written by --tracedump help description.  */
+  const char *i2cstats_help; /**< @brief print the I2C transaction counts and latencies per slave and subaddress, then reset them help description.  */
+  const char *parallel_help; /**< @brief cold start the devices concurrently, one thread per device help description.  */
+  const char *broadcast_help; /**< @brief  help description.  */
+  char * irq_arg;    /**< @brief wait for the DSP on the interrupt pin.  */
+  char * irq_orig;    /**< @brief wait for the DSP on the interrupt pin original value given at command line.  */
+  const char *irq_help; /**< @brief wait for the DSP on the interrupt pin help description.  */
+  char * compile_arg;    /**< @brief record the profile switches of the started devices to file.  */
+  char * compile_orig;    /**< @brief record the profile switches of the started devices to file original value given at command line.  */
+  const char *compile_help; /**< @brief record the profile switches of the started devices to file help description.  */
+  char * compiled_arg;    /**< @brief switch profiles with the file made by --compile.  */
+  char * compiled_orig;    /**< @brief switch profiles with the file made by --compile original value given at command line.  */
+  const char *compiled_help; /**< @brief switch profiles with the file made by --compile help description.  */
+  const char *shadow_help; /**< @brief keep a shadow of the registers, a read-modify-write only writes help description.  */
+  const char *paramcache_help; /**< @brief skip the parameter uploads the DSP has from this process already help description.  */
+  int i2cmax_arg;    /**< @brief largest I2C message of an i2c-dev adapter, incl the slave address.  */
+  char * i2cmax_orig;    /**< @brief largest I2C message of an i2c-dev adapter, incl the slave address original value given at command line.  */
+  const char *i2cmax_help; /**< @brief largest I2C message of an i2c-dev adapter, incl the slave address help description.  */
+  char ** bus_arg;    /**< @brief the target of bus nr of the container device list, e.g. 1=/dev/i2c-3, the -d target is bus 0.  */
+  char ** bus_orig;    /**< @brief the target of bus nr of the container device list, e.g. 1=/dev/i2c-3, the -d target is bus 0 original value given at command line.  */
+  unsigned int bus_min; /**< @brief the target of bus nr of the container device list, e.g. 1=/dev/i2c-3, the -d target is bus 0's minimum occurreces */
+  unsigned int bus_max; /**< @brief the target of bus nr of the container device list, e.g. 1=/dev/i2c-3, the -d target is bus 0's maximum occurreces */
+  const char *bus_help; /**< @brief the target of bus nr of the container device list, e.g. 1=/dev/i2c-3, the -d target is bus 0 help description.  */
 
   unsigned int help_given ;    /**< @brief Whether help was given.  */
   unsigned int full_help_given ;    /**< @brief Whether full-help was given.  */
@@ -203,6 +231,18 @@ struct gengetopt_args_info
   unsigned int verbose_given ;    /**< @brief Whether verbose was given.  */
   unsigned int trace_given ;    /**< @brief Whether trace was given.  */
   unsigned int quiet_given ;    /**< @brief Whether quiet was given.  */
+  unsigned int tracedump_given ;    /**< @brief Whether tracedump was given.  */
+  unsigned int tracedecode_given ;    /**< @brief Whether tracedecode was given.  */
+  unsigned int i2cstats_given ;    /**< @brief Whether i2cstats was given.  */
+  unsigned int parallel_given ;    /**< @brief Whether parallel was given.  */
+  unsigned int broadcast_given ;    /**< @brief Whether broadcast was given.  */
+  unsigned int irq_given ;    /**< @brief Whether irq was given.  */
+  unsigned int compile_given ;    /**< @brief Whether compile was given.  */
+  unsigned int compiled_given ;    /**< @brief Whether compiled was given.  */
+  unsigned int shadow_given ;    /**< @brief Whether shadow was given.  */
+  unsigned int paramcache_given ;    /**< @brief Whether paramcache was given.  */
+  unsigned int i2cmax_given ;    /**< @brief Whether i2cmax was given.  */
+  unsigned int bus_given ;    /**< @brief Whether bus was given.  */
 
 } ;
 
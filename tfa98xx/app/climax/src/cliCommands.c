@@ -23,6 +23,7 @@
 #include <inttypes.h>    //TODO fix/converge types
 #endif
 #include <lxScribo.h>
+#include "NXP_I2C.h"
 
 #include "cmdline.h"
 #include "climax.h"
@@ -201,17 +202,19 @@ int cliCommands(int targetfd, char *xarg, Tfa98xx_handle_t *handlesIn)
     // read xmem
     for (i = 0; i < (int)gCmdLine.xmem_given; ++i)
     {
-        int value;
         unsigned int offset=gCmdLine.xmem_arg[i]&0xffff /*mask off DMEM*/;
         int count = gCmdLine.count_given? gCmdLine.count_arg-1 :  0;
         enum Tfa98xx_DMEM memtype = (gCmdLine.xmem_arg[i]>>16)&3;
 
         if ( !writes ) { // read if no write arg
-            do {
-                    error = tfa98xx_DspRead(gCmdLine.xmem_arg[i], handlesIn, &value); /* memtype handled inside */
-                               PRINT("xmem[0x%04x] : 0x%06x\n", offset, value);
-                               offset++;
-            } while (count--);
+            int j, *values = malloc((count+1) * sizeof(int));
+            if (values == NULL)
+                return tfa_srv_api_error_Fail;
+            /* one burst read, memtype handled inside */
+            error = tfa98xx_DspReadBlock(gCmdLine.xmem_arg[i], count+1, handlesIn, values);
+            for (j = 0; error == tfa_srv_api_error_Ok && j <= count; j++)
+                               PRINT("xmem[0x%04x] : 0x%06x\n", offset + j, values[j]);
+            free(values);
         } else {
                         if( handlesIn[0] == -1) //TODO properly handle open/close dev
                         PRINT_ASSERT( nxpTfa98xx_Open(&handlesIn[0]));
@@ -570,4 +573,29 @@ int cliTargetDevice(char *devname)
     //return fd or die
 }
 
+/*
+ * register the target of a container bus, busarg is nr=target
+ */
+int cliTargetBus(char *busarg)
+{
+    char *target;
+    long bus;
+    int fd;
+
+    bus = strtol(busarg, &target, 0);
+    if (target == busarg || *target != '=' || bus < 1 || bus >= NXP_I2C_MAX_BUSSES) {
+        PRINT("Bad bus %s, use nr=target with nr 1..%d\n", busarg, NXP_I2C_MAX_BUSSES-1);
+        exit(1);
+    }
+    target++;
+
+    fd = lxScriboRegisterBus((int)bus, target);
+    if (fd < 0) {
+        PRINT("Can't open %s\n", target);
+        exit(1);
+    }
+
+    return fd;
+}
+
 
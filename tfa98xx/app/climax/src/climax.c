@@ -53,8 +53,12 @@ void i2cserver_set_verbose(int val);/* used in i2cserver.c */
 extern int optind;   // processed option count
 #endif
 
-int lxScriboListenSocketInit(char *);
-void CmdProcess(void* , int );
+#if !(defined(WIN32) || defined(_X64))
+#include <poll.h>
+#include <errno.h>
+#include <fcntl.h>
+#include "cmd.h"
+#endif
 
 /*
  * translate string to uppercase
@@ -119,6 +123,23 @@ int climax_args(int argc, char *argv[]) {
  * functions called from scribo telnet
  */
 int climain(int argc, char *argv[]);
+/*
+ * save the I2C trace ring on exit
+ */
+static void cliTraceDump(void)
+{
+    int n = NXP_I2C_TraceDump(gCmdLine.tracedump_arg);
+
+    if (n >= 0 && !cli_quiet)
+        PRINT("%d I2C trace records written to %s\n", n, gCmdLine.tracedump_arg);
+}
+/*
+ * print the I2C trace ring on exit, --trace records only
+ */
+static void cliTracePrint(void)
+{
+    NXP_I2C_TracePrint();
+}
 int cliload(char *name) {
     return tfa98xx_cnt_loadfile(name, 0);
 }
@@ -139,6 +160,20 @@ int climain(int argc, char *argv[])
     tfa98xxI2cSlave = TFA_I2CSLAVEBASE; /* use a default just in case */
     devicename = cliInit(argc, argv);
 
+    if ( gCmdLine.tracedecode_given ) {
+        return NXP_I2C_TraceDecode(gCmdLine.tracedecode_arg) < 0;
+    }
+    if ( gCmdLine.tracedump_given ) {
+        static int registered;
+        if (!registered++)
+            atexit(cliTraceDump);
+    }
+    if ( gCmdLine.trace_given ) {
+        static int registered;
+        if (!registered++)
+            atexit(cliTracePrint);
+    }
+
     if ( gCmdLine.maximus_given ) {
             tfa_cont_dev_type(gCmdLine.maximus_arg);
     } else
@@ -182,6 +217,13 @@ int climain(int argc, char *argv[])
         tfaContGetSlave(0, &tfa98xxI2cSlave); // set 1st slave
     }
 
+    if ( gCmdLine.compiled_given ) {
+        if ( tfaContLoadCompiled(gCmdLine.compiled_arg) ) {
+            PRINT_ERROR("Load compiled profiles failed\n");
+            return 1;
+        }
+    }
+
     if ( gCmdLine.profile_given ) {
         if ( tfa98xx_cnt_max_device() == -1) {
             PRINT("Please supply a container file with profile argument.\n");
@@ -232,6 +274,16 @@ int climain(int argc, char *argv[])
     }
 
     fd = cliTargetDevice(devicename);
+    for (i = 0; i < (int)gCmdLine.bus_given; i++)
+        cliTargetBus(gCmdLine.bus_arg[i]);
+
+    if (gCmdLine.irq_given) {
+        /* without a file the target may have registered its pin */
+        if (NXP_I2C_GetIrq() >= 0)
+            tfaRunRpcIrq(1);
+        else
+            PRINT_ERROR("no interrupt pin, the DSP is polled\n");
+    }
 
     tfaLiveDataVerbose(cli_verbose);
 
@@ -248,6 +300,14 @@ int climain(int argc, char *argv[])
         }
     }
 
+    if ( gCmdLine.compile_given ) {
+        error = tfaContCompile(gCmdLine.compile_arg);
+        if (error != tfa_srv_api_error_Ok) {
+            PRINT("last status: %d (%s)\n", error, nxpTfa98xxGetErrorString(error));
+            return error;
+        }
+    }
+
     if (gCmdLine.stop_given) {
         if (cli_verbose)
             PRINT("Stop given\n");
@@ -317,6 +377,11 @@ int climain(int argc, char *argv[])
         tfa98xxLogger( gCmdLine.logger_arg, gCmdLine.count_arg);
     }
 
+    if ( gCmdLine.i2cstats_given ) {
+        NXP_I2C_StatPrint(); /* snapshot of everything done above */
+        NXP_I2C_StatReset();
+    }
+
 #if !(defined(WIN32) || defined(_X64))
     if ( gCmdLine.server_given ) {
        // PRINT("statusreg:0x%02x\n", tfa98xxReadRegister(0,handlesIn)); // read to ensure device is opened
@@ -338,32 +403,62 @@ int climain(int argc, char *argv[])
  *
  */
 int activeSocket; // global
+/*
+ * serve up to CMD_MAX_CLIENTS clients, each with its own parse state
+ *  the commands are executed one at the time in the order they come in
+ */
 void cliSocketServer(char *socket)
 {
-     int length, i;
-     uint8_t cmd[2], buf[256], *ptr, *devname;
+    struct pollfd fds[1 + CMD_MAX_CLIENTS];
+    cmd_client_t *clients[1 + CMD_MAX_CLIENTS];
+    cmd_client_t *client;
+    int listenSocket, nfds, i, fd;
 
-    activeSocket=lxScriboListenSocketInit(socket);
+    listenSocket=lxScriboListenSocketOpen(socket);
 
-    if(activeSocket<0) {
+    if(listenSocket<0) {
         PRINT_ERROR("something wrong with socket %s\n", socket);
         lxScriboSocketExit(1);
     }
 
+    Cmd_Init();
+    fds[0].fd = listenSocket;
+    fds[0].events = POLLIN;
+    nfds = 1;
+
     while(1){
-        length = read(activeSocket, buf, 256);
-        if (socket_verbose & (length>0)) {
-            PRINT("recv: ");
-            for(i=0;i<length;i++)
-                 PRINT("0x%02x ", buf[i]);
-            PRINT("\n");
+        if (poll(fds, nfds, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            PRINT_ERROR("poll error on socket %s\n", socket);
+            lxScriboSocketExit(1);
         }
-        if (length>0)
-          CmdProcess(buf,  length);
-        else {
-            close(activeSocket);
-            tfaRun_Sleepus(10000);
-            activeSocket=lxScriboListenSocketInit(socket);
+        /* going down, so a closed client can be replaced by the last one */
+        for (i = nfds-1; i > 0; i--) {
+            if ((fds[i].revents & (POLLIN|POLLHUP|POLLERR)) == 0)
+                continue;
+            if (Cmd_Read(clients[i]) <= 0) {
+                close(fds[i].fd);
+                Cmd_Close(clients[i]);
+                nfds--;
+                fds[i] = fds[nfds];
+                clients[i] = clients[nfds];
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            fd = lxScriboListenSocketAccept(listenSocket);
+            if (fd < 0)
+                continue;
+            client = Cmd_Open(fd);
+            if (client == NULL) {
+                PRINT_ERROR("too many clients, max is %d\n", CMD_MAX_CLIENTS);
+                close(fd);
+                continue;
+            }
+            fds[nfds].fd = fd;
+            fds[nfds].events = POLLIN;
+            fds[nfds].revents = 0;
+            clients[nfds++] = client;
         }
     }
 
@@ -375,8 +470,7 @@ void cliSocketServer(char *socket)
 
 void cliClientServer(char *server)
 {
-     int length, i;
-     uint8_t cmd[2], buf[256], *ptr, *devname;
+    cmd_client_t *client;
 
     activeSocket=lxScriboSocketInit(server);
 
@@ -385,20 +479,16 @@ void cliClientServer(char *server)
         exit(1);
     }
 
+    Cmd_Init();
+    client = Cmd_Open(activeSocket);
+
     while(1){
-        length = read(activeSocket, buf, 256);
-        if (socket_verbose & (length>0)) {
-            PRINT("recv: ");
-            for(i=0;i<length;i++)
-                 PRINT("0x%02x ", buf[i]);
-            PRINT("\n");
-        }
-        if (length>0)
-          CmdProcess(buf,  length);
-        else {
+        if (Cmd_Read(client) <= 0) {
             close(activeSocket);
+            Cmd_Close(client);
             tfaRun_Sleepus(10000);
             activeSocket=lxScriboSocketInit(server);
+            client = Cmd_Open(activeSocket);
         }
     }
 }
@@ -436,6 +526,23 @@ char *cliInit(int argc, char **argv)
         tfa_cnt_verbose(cli_verbose);
         lxDummyVerbose((0x10 & gCmdLine.verbose_arg)!=0);
     }
+    tfaRunParallelStart(gCmdLine.parallel_given);
+    tfaRunBroadcastStart(gCmdLine.broadcast_given);
+    tfaRunShadow(gCmdLine.shadow_given);
+    tfaRunParamCache(gCmdLine.paramcache_given);
+    if (gCmdLine.i2cmax_given)
+        lxI2cSetMaxSize(gCmdLine.i2cmax_arg);
+#if !(defined(WIN32) || defined(_X64))
+    if (gCmdLine.irq_given && gCmdLine.irq_arg) {
+        /* gpio value file, the edge must be configured already */
+        int fd = open(gCmdLine.irq_arg, O_RDONLY);
+        if (fd < 0) {
+            PRINT_ERROR("can't open interrupt %s\n", gCmdLine.irq_arg);
+            exit(1);
+        }
+        NXP_I2C_SetIrq(fd);
+    }
+#endif
     tfa98xx_verbose = cli_verbose;
     tfa98xx_quiet = gCmdLine.quiet_given;
     tfa_cnt_verbose(tfa98xx_verbose);
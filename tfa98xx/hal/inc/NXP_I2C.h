@@ -77,7 +77,11 @@ void NXP_I2C_Trace_file(char *filename);
  */
 void NXP_I2C_rev(int *major, int *minor, int *revision);
 
-/* The maximum I2C message size allowed for read and write buffers, incl the slave address */
+/* The maximum nr of busses (adapters or targets) that can be registered */
+#define NXP_I2C_MAX_BUSSES 4
+
+/* The default maximum I2C message size allowed for read and write buffers, incl the slave address
+   A target that can take more reports it with NXP_I2C_MaxSizeInterface() */
 #define NXP_I2C_MAX_SIZE 254
 /* The maximum I2C burst size, transaction will be split into smaller chunks */
 //#define NXP_I2C_MAX_BURST 32 //if defined then NXP_I2C_Write() will enable this, note that the read has not been done yet
@@ -106,13 +110,151 @@ NXP_I2C_Error_t NXP_I2C_WriteRead(  unsigned char sla,
 
                 unsigned char read_buffer[] );
 
+/* A single transaction of a batch, see NXP_I2C_Batch()
+   The buffers hold the data only, the slave address is in sla.
+   @sla = slave address
+   @num_write_bytes = size of write_data[]
+   @write_data[] = byte array of data to write
+   @num_read_bytes = number of bytes to read after the restart, 0 for a write
+   @read_buffer[] = byte array to receive the read data
+*/
+typedef struct NXP_I2C_Msg {
+    unsigned char sla;
+    int num_write_bytes;
+    const unsigned char *write_data;
+    int num_read_bytes;
+    unsigned char *read_buffer;
+} NXP_I2C_Msg_t;
+
+/* Execute a list of transactions in as few round trips as the target allows.
+   Each entry is handled like NXP_I2C_Write() or, if num_read_bytes is set,
+   like NXP_I2C_WriteRead(). The transactions are executed in order and the
+   first failure stops the batch. A target that pipelines the transactions
+   may already have been sent a few of the ones behind the failure, these
+   are executed as well.
+   @num_msgs = size of msgs[]
+   @msgs[] = the transactions
+*/
+NXP_I2C_Error_t NXP_I2C_Batch(int num_msgs, NXP_I2C_Msg_t msgs[]);
+
+/* Same as above but on a specific bus
+   The calls without a bus argument are for bus 0.
+   A bus that was not registered falls back to bus 0.
+   @bus = bus id, 0..NXP_I2C_MAX_BUSSES-1
+*/
+NXP_I2C_Error_t NXP_I2C_WriteBus(int bus, unsigned char sla,
+                int num_write_bytes,
+                const unsigned char data[] );
+NXP_I2C_Error_t NXP_I2C_WriteReadBus(int bus, unsigned char sla,
+                int num_write_bytes,
+                const unsigned char write_data[],
+                int num_read_bytes,
+                unsigned char read_buffer[] );
+NXP_I2C_Error_t NXP_I2C_BatchBus(int bus, int num_msgs, NXP_I2C_Msg_t msgs[]);
+
 /* Read back the version info */
 NXP_I2C_Error_t NXP_I2C_Version(char *data);
 
-/* Returns the number of bytes that can be transfered in one transaction */
+/* Returns the number of bytes that can be transfered in one transaction
+   This is the smallest size of all registered busses */
 int NXP_I2C_BufferSize();
-/* enable/disable trace */
+/* Same as above for a specific bus */
+int NXP_I2C_BufferSizeBus(int bus);
+/* Return the bus the transactions for bus go to, 0 if bus is not registered */
+int NXP_I2C_ResolveBus(int bus);
+/* enable/disable trace
+   The transactions are only recorded, see NXP_I2C_TracePrint() */
 void NXP_I2C_Trace(int on);
+
+/* Binary trace
+   All transactions are recorded in a ring of the last NXP_I2C_TRACE_RECORDS,
+   independent of NXP_I2C_Trace(). A record holds the first
+   NXP_I2C_TRACE_DATA bytes, incl the slave address.
+*/
+#define NXP_I2C_TRACE_RECORDS 1024
+#define NXP_I2C_TRACE_DATA 24
+typedef struct NXP_I2C_TraceRecord {
+    unsigned int time_us;       /* monotonic time, wraps after 71 minutes */
+    unsigned short length;      /* transaction length incl the slave address */
+    unsigned char bus;
+    char kind;                  /* 'w' write, 'W'/'R' write/read part of a write-read */
+    unsigned char data[NXP_I2C_TRACE_DATA];
+} NXP_I2C_TraceRecord_t;
+
+/* Copy the last max records to records[], oldest first.
+   Return the number of records copied.
+*/
+int NXP_I2C_TraceGet(int max, NXP_I2C_TraceRecord_t records[]);
+/* Write the trace ring to a binary file.
+   Return the number of records written or -1 on error.
+*/
+int NXP_I2C_TraceDump(char *filename);
+/* Print a file written by NXP_I2C_TraceDump() to the trace output.
+   Return the number of records printed or -1 on error.
+*/
+int NXP_I2C_TraceDecode(char *filename);
+/* Print the trace ring to the trace output, oldest first.
+   Return the number of records printed.
+*/
+int NXP_I2C_TracePrint(void);
+
+/* Transaction statistics
+   Writes and write-reads are counted per slave and subaddress (the first
+   byte written). The latency of a transaction is kept in a histogram with
+   log2 microsecond buckets: bucket 0 is <1us, bucket n is [2^(n-1), 2^n) us.
+*/
+#define NXP_I2C_STAT_ENTRIES 256
+#define NXP_I2C_STAT_BUCKETS 24
+typedef struct NXP_I2C_Stat {
+    unsigned char sla;
+    unsigned char subaddress;
+    char kind;                  /* 'w' write, 'r' write-read */
+    unsigned int count;
+    unsigned int bytes;         /* written + read, incl the slave address */
+    unsigned int total_us;
+    unsigned int max_us;
+    unsigned int histogram[NXP_I2C_STAT_BUCKETS];
+} NXP_I2C_Stat_t;
+
+/* Copy up to max entries to stats[], in order of first use.
+   Return the number of entries copied.
+*/
+int NXP_I2C_StatGet(int max, NXP_I2C_Stat_t stats[]);
+/* Clear all statistics */
+void NXP_I2C_StatReset(void);
+/* Return the upper bound in us of the percent percentile, max_us for 100 */
+unsigned int NXP_I2C_StatPercentile(const NXP_I2C_Stat_t *stat, int percent);
+/* Print the statistics table, busiest entries first.
+   Return the number of entries printed.
+*/
+int NXP_I2C_StatPrint(void);
+
+/* Capture
+   The capture function is called after every transaction with the data as it
+   went to the bus, the HAL bus is in bus and the slave address in sla.
+   For a write num_read_bytes is 0.
+   This allows recording the traffic of a higher level call, e.g. to replay it.
+   A NULL capture function disables it.
+*/
+typedef void (*NXP_I2C_Capture_t)(void *context, int bus, unsigned char sla,
+                int num_write_bytes, const unsigned char write_data[],
+                int num_read_bytes);
+void NXP_I2C_Capture(NXP_I2C_Capture_t capture, void *context);
+
+/* Interrupt
+   The fd of the amplifier interrupt pin, it must become readable (pipe) or
+   signal POLLPRI (sysfs gpio value with edge detection) when the pin asserts.
+   Return the previous fd, -1 is none.
+*/
+int NXP_I2C_SetIrq(int fd);
+/* Return the interrupt fd, -1 is none.
+*/
+int NXP_I2C_GetIrq(void);
+/* Wait at most timeout_us for the interrupt.
+   Without an interrupt fd this is a plain sleep of timeout_us.
+   Return 1 on interrupt, 0 on timeout, -1 if there is no interrupt fd.
+*/
+int NXP_I2C_WaitIrq(int timeout_us);
 /*
  * use tracefile fo output
  *  args:
@@ -122,13 +264,34 @@ void NXP_I2C_Trace(int on);
  *  return fd or -1 on error
  */
 void NXP_I2C_Trace_file(char *filename);
-/* fill the interface */
+/* fill the interface of bus 0 */
 int  NXP_I2C_Interface(char  *target,
         int (*init)(char *dev),
         int (*write)(int fd, int size, unsigned char *buffer, unsigned int *pError),
         int (*write_read)(int fd, int wsize, const unsigned char *wbuffer,
                 int rsize, unsigned char *rbuffer, unsigned int *pError),
                 int (*version_str)(char *buffer, int fd));
+/* fill the interface of a bus
+ *  each bus has its own target and file descriptor
+ *  return fd or -1 on error */
+int  NXP_I2C_InterfaceBus(int bus, char  *target,
+        int (*init)(char *dev),
+        int (*write)(int fd, int size, unsigned char *buffer, unsigned int *pError),
+        int (*write_read)(int fd, int wsize, const unsigned char *wbuffer,
+                int rsize, unsigned char *rbuffer, unsigned int *pError),
+                int (*version_str)(char *buffer, int fd));
+/* add a batch function to the interface that was filled last
+ *  without it NXP_I2C_Batch() will do a write(_read) call per transaction
+ *  the batch function returns the nr of transactions that were executed,
+ *  or -1 if the connection is lost, then the target is initialized again */
+void NXP_I2C_BatchInterface(int (*batch)(int fd, int num_msgs,
+                NXP_I2C_Msg_t *msgs, unsigned int *pError));
+/* add a max size function to the interface that was filled last
+ *  it returns the largest transaction, incl the slave address, that the
+ *  target of fd can take; it is called now and after every recovery
+ *  transactions above NXP_I2C_MAX_SIZE are passed to the batch function
+ *  without a copy, so a bus without one stays at NXP_I2C_MAX_SIZE */
+void NXP_I2C_MaxSizeInterface(int (*max_size)(int fd));
 
 #if (defined(WIN32) || defined(_X64))
 NXP_I2C_Error_t init_I2C();
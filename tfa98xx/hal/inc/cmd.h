@@ -19,7 +19,22 @@
 #ifndef CMD_H_
 #define CMD_H_
 
+/* nr of clients that can be connected to the server at the same time */
+#define CMD_MAX_CLIENTS 8
+
+typedef struct cmd_client cmd_client_t;
+
 void Cmd_Init(void);
 void CmdProcess(void* buf, int len);
 
+/*
+ * per client command processing
+ *  Cmd_Read() reads what is available on the client fd and executes all
+ *  complete commands, it returns the read() result
+ */
+cmd_client_t *Cmd_Open(int fd);
+void Cmd_Close(cmd_client_t *client);
+int Cmd_Fd(cmd_client_t *client);
+int Cmd_Read(cmd_client_t *client);
+
 #endif /* CMD_H_ */
@@ -56,8 +56,11 @@ enum devkit_pinget {
     pinget_tfa_int_l, //4
     pinget_tfa_int_r
 };
+struct NXP_I2C_Msg; /* from NXP_I2C.h */
+
 void  lxScriboVerbose(int level);        // set verbose level.
 int lxScriboRegister(char *dev);    // register target and return opened file desc.
+int lxScriboRegisterBus(int bus, char *dev);    // register target of a bus and return opened file desc.
 int lxScriboGetFd(void);            // return active file desc.
 char * lxScriboGetName(void);    // target name
 
@@ -65,9 +68,14 @@ int lxScriboVersion(char *buffer, int fd);
 int lxScriboWrite(int fd, int size, unsigned char *buffer, unsigned int *pError);
 int lxScriboWriteRead(int fd, int wsize, const unsigned char *wbuffer
                                            , int rsize, unsigned char *rbuffer, unsigned int *pError);
+int lxScriboBatch(int fd, int num_msgs, struct NXP_I2C_Msg *msgs, unsigned int *pError);
+int lxScriboMaxSize(int fd);
 int lxScriboPrintTargetRev(int fd);
 int lxScriboSerialInit(char *dev);
 int lxScriboSocketInit(char *dev);
+int lxScriboListenSocketInit(char *socketnr);
+int lxScriboListenSocketOpen(char *socketnr);
+int lxScriboListenSocketAccept(int listenfd);
 void lxScriboSocketExit(int status);
 int lxScriboSetPin(int fd, int pin, int value);
 
@@ -83,6 +91,9 @@ int lxI2cInit(char *dev);
 int lxI2cWrite(int fd, int size, unsigned char *buffer, unsigned int *pError);
 int lxI2cWriteRead(int fd, int wsize, const unsigned char *wbuffer
                                            , int rsize, unsigned char *rbuffer, unsigned int *pError);
+int lxI2cBatch(int fd, int num_msgs, struct NXP_I2C_Msg *msgs, unsigned int *pError);
+int lxI2cMaxSize(int fd);
+void lxI2cSetMaxSize(int size);
 int lxI2cVersion(char *buffer, int fd);
 
 void lxDummyVerbose(int level);
@@ -91,6 +102,8 @@ int lxDummyInit(char *dev);
 int lxDummyWrite(int fd, int size, unsigned char *buffer, unsigned int *pError);
 int lxDummyWriteRead(int fd, int wsize, const unsigned char *wbuffer
                                            , int rsize, unsigned char *rbuffer, unsigned int *pError);
+int lxDummyBatch(int fd, int num_msgs, struct NXP_I2C_Msg *msgs, unsigned int *pError);
+int lxDummyMaxSize(int fd);
 int lxDummyVersion(char *buffer, int fd);
 
 int lxHtcInit(char *dev);
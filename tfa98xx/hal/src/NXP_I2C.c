@@ -16,6 +16,10 @@
 
 #if !(defined(WIN32) || defined(_X64))
 #include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <poll.h>
+#define NXP_I2C_LOCKING
 #else
 #undef __cplusplus
 
@@ -36,6 +40,7 @@
 #include "NXP_I2C.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <stdint.h>
 #include <string.h>
@@ -44,16 +49,63 @@
 #include "lxScribo.h"
 #include "Scribo.h"
 
-/* the interface */
-static int (*lxInit)(char *dev);
-static int (*lxWrite)(int fd, int size, unsigned char *buffer, unsigned int *pError);
-static int (*lxWriteRead)(int fd, int wsize, const unsigned char *wbuffer
-              , int rsize, unsigned char *rbuffer, unsigned int *pError);
-static int (*lxVersionStr)(char *buffer, int fd);
+/* the interface of a bus */
+struct nxp_i2c_bus {
+    int (*lxInit)(char *dev);
+    int (*lxWrite)(int fd, int size, unsigned char *buffer, unsigned int *pError);
+    int (*lxWriteRead)(int fd, int wsize, const unsigned char *wbuffer
+                  , int rsize, unsigned char *rbuffer, unsigned int *pError);
+    int (*lxVersionStr)(char *buffer, int fd);
+    int (*lxBatch)(int fd, int num_msgs, NXP_I2C_Msg_t *msgs, unsigned int *pError);
+    int (*lxMaxSize)(int fd);
+    int maxSize;                    /* largest transaction incl the slave address */
+    int i2cTargetFd;                /* file descriptor for target device */
+    int registered;
+    char target[FILENAME_MAX];      /* kept for recovery */
+#ifdef NXP_I2C_LOCKING
+    pthread_mutex_t lock;           /* 1 transaction (or batch) at the time */
+#endif
+};
+static struct nxp_i2c_bus busses[NXP_I2C_MAX_BUSSES];
+static int lastBus;    /* bus of the last NXP_I2C_InterfaceBus() call */
+
+/*
+ * the bus locks are recursive: a batch without batch support in the
+ *  interface is done with the single transaction calls
+ */
+#ifdef NXP_I2C_LOCKING
+static pthread_once_t busLockOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t initLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void bus_lock_init(void)
+{
+    pthread_mutexattr_t attr;
+    int i;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    for (i = 0; i < NXP_I2C_MAX_BUSSES; i++)
+        pthread_mutex_init(&busses[i].lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+static void bus_lock(struct nxp_i2c_bus *pBus)
+{
+    pthread_once(&busLockOnce, bus_lock_init);
+    pthread_mutex_lock(&pBus->lock);
+}
+
+static void bus_unlock(struct nxp_i2c_bus *pBus)
+{
+    pthread_mutex_unlock(&pBus->lock);
+}
+#else
+#define bus_lock(pBus)
+#define bus_unlock(pBus)
+#endif
 
 static FILE *traceoutput = NULL;
 
-static int gI2cBufSz=NXP_I2C_MAX_SIZE;
 /*
  * accounting globals
  */
@@ -74,8 +126,6 @@ typedef struct
 
 static bool bInit = false;
 
-static int i2cTargetFd=-1;                         /* file descriptor for target device */
-
 int NXP_I2C_verbose;
 extern int lxScriboGetFd(void);
 //#define VERBOSE(format, args...) if (NXP_I2C_verbose) PRINT(format, ##args)
@@ -120,20 +170,321 @@ void NXP_I2C_Trace(int on) {
     NXP_I2C_verbose = on;
 }
 
-static void hexdump(int num_write_bytes, const unsigned char * data)
+static void hexdump(FILE *out, int num_write_bytes, const unsigned char * data)
 {
     int i;
 
     for(i=0;i<num_write_bytes;i++)
     {
-        PRINT_FILE(traceoutput, "0x%02x ", data[i]);
+        PRINT_FILE(out, "0x%02x ", data[i]);
+    }
+}
+
+/*
+ * binary trace
+ *  every transaction is recorded in a ring of fixed size records, this is
+ *  cheap enough to leave on; the text trace is decoded from the records
+ *  afterwards, nothing is printed on the bus path
+ */
+static NXP_I2C_TraceRecord_t traceRing[NXP_I2C_TRACE_RECORDS];
+static unsigned int traceHead; /* free running, next record */
+#if defined(__GNUC__)
+#define TRACE_NEXT() __sync_fetch_and_add(&traceHead, 1)
+#else
+#define TRACE_NEXT() (traceHead++)
+#endif
+#define TRACE_MAGIC "I2CT"
+
+static unsigned int i2c_trace_time(void)
+{
+#if !(defined(WIN32) || defined(_X64))
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned int)(now.tv_sec * 1000000 + now.tv_nsec / 1000);
+#else
+    return (unsigned int)GetTickCount() * 1000;
+#endif
+}
+
+/*
+ * print a record as text
+ */
+static void i2c_trace_print(FILE *out, const NXP_I2C_TraceRecord_t *rec)
+{
+    int n = rec->length < NXP_I2C_TRACE_DATA ? rec->length : NXP_I2C_TRACE_DATA;
+
+    PRINT_FILE(out, "%10u.%06u bus%d ", rec->time_us / 1000000, rec->time_us % 1000000, rec->bus);
+    PRINT_FILE(out, "I2C %c [%3d]: ", rec->kind, rec->length);
+    hexdump(out, n, rec->data);
+    if (n < rec->length)
+        PRINT_FILE(out, "...");
+    PRINT_FILE(out, "\n");
+}
+
+/*
+ * record a transaction
+ *  kind is 'w' for a write, 'W' and 'R' for the parts of a write-read
+ */
+static void i2c_trace_record(struct nxp_i2c_bus *pBus, char kind, unsigned char sla,
+                int length, const unsigned char *data)
+{
+    NXP_I2C_TraceRecord_t *rec = &traceRing[TRACE_NEXT() % NXP_I2C_TRACE_RECORDS];
+    int n = length < NXP_I2C_TRACE_DATA-1 ? length : NXP_I2C_TRACE_DATA-1;
+
+    rec->time_us = i2c_trace_time();
+    rec->length = (unsigned short)(length+1);
+    rec->bus = (unsigned char)(pBus - busses);
+    rec->kind = kind;
+    rec->data[0] = sla;
+    memcpy(&rec->data[1], data, n);
+}
+
+int NXP_I2C_TraceGet(int max, NXP_I2C_TraceRecord_t records[])
+{
+    unsigned int head = traceHead, first;
+    int i, n;
+
+    n = head < NXP_I2C_TRACE_RECORDS ? head : NXP_I2C_TRACE_RECORDS;
+    if (n > max)
+        n = max;
+    first = head - n;
+    for (i = 0; i < n; i++)
+        records[i] = traceRing[(first + i) % NXP_I2C_TRACE_RECORDS];
+
+    return n;
+}
+
+int NXP_I2C_TraceDump(char *filename)
+{
+    static NXP_I2C_TraceRecord_t records[NXP_I2C_TRACE_RECORDS];
+    unsigned int header[2];
+    FILE *out;
+    int n;
+
+    out = fopen(filename, "wb");
+    if (out == NULL) {
+        PRINT_ERROR("Can't open %s\n", filename);
+        return -1;
+    }
+
+    n = NXP_I2C_TraceGet(NXP_I2C_TRACE_RECORDS, records);
+    header[0] = sizeof(NXP_I2C_TraceRecord_t);
+    header[1] = n;
+    fwrite(TRACE_MAGIC, 4, 1, out);
+    fwrite(header, sizeof(header), 1, out);
+    fwrite(records, sizeof(NXP_I2C_TraceRecord_t), n, out);
+    fclose(out);
+
+    return n;
+}
+
+int NXP_I2C_TraceDecode(char *filename)
+{
+    NXP_I2C_TraceRecord_t rec;
+    unsigned int header[2], i;
+    char magic[4];
+    FILE *in, *out = traceoutput ? traceoutput : stdout;
+
+    in = fopen(filename, "rb");
+    if (in == NULL) {
+        PRINT_ERROR("Can't open %s\n", filename);
+        return -1;
+    }
+    if (fread(magic, 4, 1, in) != 1 || memcmp(magic, TRACE_MAGIC, 4) != 0
+            || fread(header, sizeof(header), 1, in) != 1
+            || header[0] != sizeof(NXP_I2C_TraceRecord_t)) {
+        PRINT_ERROR("%s is not a trace dump of this version\n", filename);
+        fclose(in);
+        return -1;
+    }
+
+    for (i = 0; i < header[1] && fread(&rec, sizeof(rec), 1, in) == 1; i++)
+        i2c_trace_print(out, &rec);
+    fclose(in);
+
+    return i;
+}
+
+int NXP_I2C_TracePrint(void)
+{
+    static NXP_I2C_TraceRecord_t records[NXP_I2C_TRACE_RECORDS];
+    FILE *out = traceoutput ? traceoutput : stdout;
+    unsigned int head = traceHead;
+    int i, n;
+
+    n = NXP_I2C_TraceGet(NXP_I2C_TRACE_RECORDS, records);
+    if (head > (unsigned int)n)
+        PRINT_FILE(out, "%u older I2C trace records were overwritten\n", head - n);
+    for (i = 0; i < n; i++)
+        i2c_trace_print(out, &records[i]);
+    fflush(out);
+
+    return n;
+}
+
+/*
+ * transaction statistics
+ *  statIndex is an open addressed hash of slave/subaddress/kind to entry+1,
+ *  twice the size of the table so a probe always ends on a free slot
+ */
+static NXP_I2C_Stat_t statTable[NXP_I2C_STAT_ENTRIES];
+static unsigned short statIndex[2*NXP_I2C_STAT_ENTRIES];
+static int statUsed;
+static unsigned int statDropped; /* not counted because the table was full */
+#ifdef NXP_I2C_LOCKING
+static pthread_mutex_t statLock = PTHREAD_MUTEX_INITIALIZER;
+#define stat_lock() pthread_mutex_lock(&statLock)
+#define stat_unlock() pthread_mutex_unlock(&statLock)
+#else
+#define stat_lock()
+#define stat_unlock()
+#endif
+
+static int i2c_stat_bucket(unsigned int us)
+{
+    int bucket = 0;
+
+    while (us && bucket < NXP_I2C_STAT_BUCKETS-1) {
+        us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+/* capture hook, see NXP_I2C_Capture() */
+static NXP_I2C_Capture_t i2c_capture;
+static void *i2c_capture_context;
+
+void NXP_I2C_Capture(NXP_I2C_Capture_t capture, void *context)
+{
+    i2c_capture_context = context;
+    i2c_capture = capture;
+}
+
+/*
+ * account a transaction
+ *  kind is 'w' for a write and 'r' for a write-read
+ */
+static void i2c_stat_record(char kind, unsigned char sla, int num_write_bytes,
+                const unsigned char *write_data, int num_read_bytes, unsigned int us)
+{
+    unsigned char sub = num_write_bytes ? write_data[0] : 0;
+    unsigned int key = (sla << 9) | (sub << 1) | (kind == 'r');
+    unsigned int h = (key * 2654435761u) >> 23; /* 9 bits */
+    NXP_I2C_Stat_t *stat = NULL;
+
+    stat_lock();
+    gNXP_i2c_writes += num_write_bytes+1;
+    if (num_read_bytes)
+        gNXP_i2c_reads += num_read_bytes+1;
+
+    while (statIndex[h]) {
+        NXP_I2C_Stat_t *s = &statTable[statIndex[h]-1];
+        if (s->sla == sla && s->subaddress == sub && s->kind == kind) {
+            stat = s;
+            break;
+        }
+        h = (h+1) % (2*NXP_I2C_STAT_ENTRIES);
+    }
+    if (stat == NULL && statUsed < NXP_I2C_STAT_ENTRIES) {
+        stat = &statTable[statUsed++];
+        memset(stat, 0, sizeof(*stat));
+        stat->sla = sla;
+        stat->subaddress = sub;
+        stat->kind = kind;
+        statIndex[h] = (unsigned short)statUsed;
     }
+
+    if (stat) {
+        stat->count++;
+        stat->bytes += num_write_bytes+1 + (num_read_bytes ? num_read_bytes+1 : 0);
+        stat->total_us += us;
+        if (us > stat->max_us)
+            stat->max_us = us;
+        stat->histogram[i2c_stat_bucket(us)]++;
+    } else
+        statDropped++;
+    stat_unlock();
+}
+
+int NXP_I2C_StatGet(int max, NXP_I2C_Stat_t stats[])
+{
+    int n;
+
+    stat_lock();
+    n = statUsed < max ? statUsed : max;
+    memcpy(stats, statTable, n * sizeof(NXP_I2C_Stat_t));
+    stat_unlock();
+
+    return n;
 }
-static void i2c_print_trace(char *format, int length, unsigned char *data) {
-     PRINT_FILE(traceoutput, format, length);
-     hexdump(length, data);
-     PRINT_FILE(traceoutput, "\n");
-     fflush(traceoutput);
+
+void NXP_I2C_StatReset(void)
+{
+    stat_lock();
+    memset(statIndex, 0, sizeof(statIndex));
+    statUsed = 0;
+    statDropped = 0;
+    stat_unlock();
+}
+
+unsigned int NXP_I2C_StatPercentile(const NXP_I2C_Stat_t *stat, int percent)
+{
+    unsigned int need, sum = 0, upper;
+    int bucket;
+
+    if (stat->count == 0)
+        return 0;
+    if (percent >= 100)
+        return stat->max_us;
+
+    need = (unsigned int)(((unsigned long long)stat->count * percent + 99) / 100);
+    if (need == 0)
+        need = 1;
+    for (bucket = 0; bucket < NXP_I2C_STAT_BUCKETS-1; bucket++) {
+        sum += stat->histogram[bucket];
+        if (sum >= need)
+            break;
+    }
+    upper = 1u << bucket;
+
+    return upper < stat->max_us ? upper : stat->max_us;
+}
+
+static int i2c_stat_compare(const void *a, const void *b)
+{
+    const NXP_I2C_Stat_t *sa = a, *sb = b;
+
+    if (sa->total_us != sb->total_us)
+        return sa->total_us < sb->total_us ? 1 : -1;
+    return sa->count < sb->count ? 1 : sa->count > sb->count ? -1 : 0;
+}
+
+int NXP_I2C_StatPrint(void)
+{
+    static NXP_I2C_Stat_t stats[NXP_I2C_STAT_ENTRIES];
+    unsigned int count = 0, total_us = 0;
+    int i, n;
+
+    n = NXP_I2C_StatGet(NXP_I2C_STAT_ENTRIES, stats);
+    qsort(stats, n, sizeof(NXP_I2C_Stat_t), i2c_stat_compare);
+
+    PRINT(" sla kind  sub   count    bytes   total_us   p50_us   p99_us   max_us\n");
+    for (i = 0; i < n; i++) {
+        NXP_I2C_Stat_t *s = &stats[i];
+
+        PRINT("0x%02x   %c  0x%02x %7u %8u %10u %8u %8u %8u\n",
+                s->sla, s->kind, s->subaddress, s->count, s->bytes, s->total_us,
+                NXP_I2C_StatPercentile(s, 50), NXP_I2C_StatPercentile(s, 99), s->max_us);
+        count += s->count;
+        total_us += s->total_us;
+    }
+    PRINT("total: %u transactions, %u us\n", count, total_us);
+    if (statDropped)
+        PRINT("%u transactions not counted, table full\n", statDropped);
+
+    return n;
 }
 
 
@@ -141,6 +492,12 @@ static NXP_I2C_Error_t init_if_firsttime(void)
 {
     NXP_I2C_Error_t retval = NXP_I2C_Ok;
 
+    if (bInit)
+        return retval;
+
+#ifdef NXP_I2C_LOCKING
+    pthread_mutex_lock(&initLock);
+#endif
     if (!bInit)
     {
         int fd = lxScriboRegister(NULL); /* this will register the default target */
@@ -150,15 +507,114 @@ static NXP_I2C_Error_t init_if_firsttime(void)
         NXP_I2C_Trace_file(0); /* default to stdout */
         bInit = true;
     }
+#ifdef NXP_I2C_LOCKING
+    pthread_mutex_unlock(&initLock);
+#endif
 
     return retval;
 }
 
-static int  recover(void) {
-    i2cTargetFd = (*lxInit)(NULL); /* this should reset the connection */
-    return i2cTargetFd<0; /* failed if -1 */
+/*
+ * return the interface for this bus
+ *  unregistered busses use bus 0, like before there was more than 1
+ */
+static struct nxp_i2c_bus *get_bus(int bus)
+{
+    static int warned;
+
+    if ( bus < 0 || bus >= NXP_I2C_MAX_BUSSES || !busses[bus].registered ) {
+        if ( bus != 0 && !warned ) {
+            PRINT("Warning: i2c bus %d is not registered, using bus 0\n", bus);
+            warned = 1;
+        }
+        bus = 0;
+    }
+    return &busses[bus];
+}
+
+static int  recover(struct nxp_i2c_bus *pBus) {
+    char target[FILENAME_MAX];
+
+    strcpy(target, pBus->target); /* init may modify the name */
+    pBus->i2cTargetFd = (*pBus->lxInit)(target); /* this should reset the connection */
+    if (pBus->lxMaxSize && pBus->i2cTargetFd >= 0)
+        pBus->maxSize = (*pBus->lxMaxSize)(pBus->i2cTargetFd); /* may be another target now */
+    return pBus->i2cTargetFd<0; /* failed if -1 */
+}
+
+/*
+ * the nr of bytes, excl the slave address, that fit in 1 transaction
+ *  only the batch function takes the data without a copy, without it
+ *  the buffers of the single calls are the limit
+ */
+static int bus_max_bytes(struct nxp_i2c_bus *pBus)
+{
+    if (pBus->lxBatch == NULL || pBus->maxSize < NXP_I2C_MAX_SIZE)
+        return NXP_I2C_MAX_SIZE - 1;
+    return pBus->maxSize - 1;
+}
+
+/*
+ * a single transaction through the batch function of the bus
+ *  the caller's buffers go to the target as they are, the slave address
+ *  is not prepended in a copy
+ *  return 1 if it was executed
+ */
+static int bus_transfer(struct nxp_i2c_bus *pBus, unsigned char sla,
+        int num_write_bytes, const unsigned char write_data[],
+        int num_read_bytes, unsigned char read_data[], uint32_t *pError)
+{
+    NXP_I2C_Msg_t msg;
+
+    msg.sla = sla;
+    msg.num_write_bytes = num_write_bytes;
+    msg.write_data = write_data;
+    msg.num_read_bytes = num_read_bytes;
+    msg.read_buffer = read_data;
+
+    *pError = NXP_I2C_Ok;
+    if ((*pBus->lxBatch)(pBus->i2cTargetFd, 1, &msg, pError) != 1) {
+        if (*pError == NXP_I2C_Ok)
+            *pError = NXP_I2C_NoAck;
+        return 0;
+    }
+    return 1;
 }
 /* fill the interface and init */
+int  NXP_I2C_InterfaceBus(int bus, char  *target,
+        int (*init)(char *dev),
+        int (*write)(int fd, int size, unsigned char *buffer, unsigned int *pError),
+        int (*write_read)(int fd, int wsize, const unsigned char *wbuffer,
+                                   int rsize, unsigned char *rbuffer, unsigned int *pError),
+                int (*version_str)(char *buffer, int fd))
+{
+    struct nxp_i2c_bus *pBus;
+
+    if ( bus < 0 || bus >= NXP_I2C_MAX_BUSSES ) {
+        PRINT_ERROR("%s: bad bus nr %d\n", __FUNCTION__, bus);
+        return -1;
+    }
+    pBus = &busses[bus];
+
+    bus_lock(pBus);
+    pBus->lxInit = init;
+    pBus->lxWrite = write;
+    pBus->lxWriteRead = write_read;
+    pBus->lxVersionStr = version_str;
+    pBus->lxBatch = NULL; /* must be added by NXP_I2C_BatchInterface() */
+    pBus->lxMaxSize = NULL; /* and by NXP_I2C_MaxSizeInterface() */
+    pBus->maxSize = NXP_I2C_MAX_SIZE;
+    if ( target )
+        strncpy(pBus->target, target, sizeof(pBus->target)-1);
+    pBus->i2cTargetFd = (*pBus->lxInit)(target);
+    pBus->registered = 1;
+    lastBus = bus;
+    if ( bus == 0 )
+        bInit = true; /* lxScriboRegister() can be called before */
+    bus_unlock(pBus);
+    return pBus->i2cTargetFd;
+}
+
 int  NXP_I2C_Interface(char  *target,
         int (*init)(char *dev),
         int (*write)(int fd, int size, unsigned char *buffer, unsigned int *pError),
@@ -166,42 +622,75 @@ int  NXP_I2C_Interface(char  *target,
                                    int rsize, unsigned char *rbuffer, unsigned int *pError),
                 int (*version_str)(char *buffer, int fd))
 {
-        lxInit = init;
-    lxWrite = write;
-    lxWriteRead = write_read;
-        lxVersionStr = version_str;
-    i2cTargetFd = (*lxInit)(target);
-    bInit = true; /* lxScriboRegister() can be called before */
-    return i2cTargetFd;
+    return NXP_I2C_InterfaceBus(0, target, init, write, write_read, version_str);
+}
+
+void NXP_I2C_BatchInterface(int (*batch)(int fd, int num_msgs,
+                NXP_I2C_Msg_t *msgs, unsigned int *pError))
+{
+    busses[lastBus].lxBatch = batch;
+}
+
+void NXP_I2C_MaxSizeInterface(int (*max_size)(int fd))
+{
+    struct nxp_i2c_bus *pBus = &busses[lastBus];
+
+    bus_lock(pBus);
+    pBus->lxMaxSize = max_size;
+    if (max_size && pBus->i2cTargetFd >= 0)
+        pBus->maxSize = (*max_size)(pBus->i2cTargetFd);
+    bus_unlock(pBus);
 }
 
 NXP_I2C_Error_t NXP_I2C_Write(  unsigned char sla,
                                 int num_write_bytes,
                                 const unsigned char data[] )
+{
+    return NXP_I2C_WriteBus(0, sla, num_write_bytes, data);
+}
+
+NXP_I2C_Error_t NXP_I2C_WriteBus(int bus, unsigned char sla,
+                                int num_write_bytes,
+                                const unsigned char data[] )
 {
   NXP_I2C_Error_t retval;
   uint32_t error;
+  struct nxp_i2c_bus *pBus;
+  unsigned int start, elapsed;
 
-    if (num_write_bytes > gI2cBufSz)
+    retval = init_if_firsttime();
+    pBus = get_bus(bus);
+
+    if (num_write_bytes > bus_max_bytes(pBus))
     {
         PRINT_ERROR("%s: too many bytes: %d\n", __FUNCTION__, num_write_bytes);
         return NXP_I2C_UnsupportedValue;
     }
 
-    retval = init_if_firsttime();
-
     if (NXP_I2C_Ok == retval)
     {
-        unsigned char buffer[NXP_I2C_MAX_SIZE+1];
-        buffer[0] = sla;
+        bus_lock(pBus);
+        start = i2c_trace_time();
+        if (pBus->lxBatch) {
+            bus_transfer(pBus, sla, num_write_bytes, data, 0, NULL, &error);
+        } else {
+            unsigned char buffer[NXP_I2C_MAX_SIZE];
+            buffer[0] = sla;
 
-        memcpy((void*)&buffer[1], (void*)data, num_write_bytes+1); // prepend slave address
+            memcpy((void*)&buffer[1], (void*)data, num_write_bytes); // prepend slave address
 
-        (*lxWrite)(i2cTargetFd, num_write_bytes+1, buffer, &error );
+            (*pBus->lxWrite)(pBus->i2cTargetFd, num_write_bytes+1, buffer, &error );
+        }
+        elapsed = i2c_trace_time() - start;
+        bus_unlock(pBus);
 
         retval =  error;
 
-        VERBOSE i2c_print_trace("I2C w [%3d]: ", num_write_bytes+1,  buffer);
+        i2c_stat_record('w', sla, num_write_bytes, data, 0, elapsed);
+        if (i2c_capture)
+            (*i2c_capture)(i2c_capture_context, bus, sla, num_write_bytes, data, 0);
+
+        i2c_trace_record(pBus, 'w', sla, num_write_bytes, data);
     }
     return retval;
 }
@@ -211,23 +700,58 @@ NXP_I2C_Error_t NXP_I2C_WriteRead(  unsigned char sla,
                                     const unsigned char write_data[],
                                     int num_read_bytes,
                                     unsigned char read_data[] )
+{
+    return NXP_I2C_WriteReadBus(0, sla, num_write_bytes, write_data,
+                                num_read_bytes, read_data);
+}
+
+NXP_I2C_Error_t NXP_I2C_WriteReadBus(int bus, unsigned char sla,
+                                    int num_write_bytes,
+                                    const unsigned char write_data[],
+                                    int num_read_bytes,
+                                    unsigned char read_data[] )
 {
   NXP_I2C_Error_t retval;
   uint32_t error;
+  struct nxp_i2c_bus *pBus;
+  unsigned int start, elapsed;
+
+  retval = init_if_firsttime();
+  pBus = get_bus(bus);
 
-    if (num_write_bytes > gI2cBufSz)
+    if (num_write_bytes > bus_max_bytes(pBus))
     {
         PRINT_ERROR("%s: too many bytes to write: %d\n", __FUNCTION__, num_write_bytes);
         return NXP_I2C_UnsupportedValue;
     }
-    if (num_read_bytes > gI2cBufSz)
+    if (num_read_bytes > bus_max_bytes(pBus))
     {
         PRINT_ERROR("%s: too many bytes to read: %d\n", __FUNCTION__, num_read_bytes);
         return NXP_I2C_UnsupportedValue;
     }
 
-  retval = init_if_firsttime();
-  if (NXP_I2C_Ok==retval)
+  if (NXP_I2C_Ok==retval && pBus->lxBatch)
+  {
+      i2c_trace_record(pBus, 'W', sla, num_write_bytes, write_data);
+
+      bus_lock(pBus);
+      start = i2c_trace_time();
+      /* the data is read straight into read_data */
+      if (bus_transfer(pBus, sla, num_write_bytes, write_data, num_read_bytes, read_data, &error)) {
+          elapsed = i2c_trace_time() - start;
+          i2c_trace_record(pBus, 'R', sla|1, num_read_bytes, read_data);
+          i2c_stat_record('r', sla, num_write_bytes, write_data, num_read_bytes, elapsed);
+          if (i2c_capture)
+              (*i2c_capture)(i2c_capture_context, bus, sla, num_write_bytes, write_data, num_read_bytes);
+      } else {
+          PRINT_ERROR("empty read in %s\n", __FUNCTION__);
+          recover(pBus);
+      }
+      bus_unlock(pBus);
+
+      retval =  error;
+  }
+  else if (NXP_I2C_Ok==retval)
   {
       unsigned char wbuffer[NXP_I2C_MAX_SIZE], rbuffer[NXP_I2C_MAX_SIZE];
 
@@ -236,26 +760,111 @@ NXP_I2C_Error_t NXP_I2C_WriteRead(  unsigned char sla,
 
       rbuffer[0] = sla|1; //read slave
 
-      VERBOSE i2c_print_trace("I2C W [%3d]: ", num_write_bytes+1,  wbuffer);
+      i2c_trace_record(pBus, 'W', sla, num_write_bytes, write_data);
 
       /* num_read_bytes will include the slave byte, so it's incremented by 1 if ok */
-      num_read_bytes = (*lxWriteRead)(i2cTargetFd,  num_write_bytes+1, wbuffer,
+      bus_lock(pBus);
+      start = i2c_trace_time();
+      num_read_bytes = (*pBus->lxWriteRead)(pBus->i2cTargetFd,  num_write_bytes+1, wbuffer,
                                                                                                             num_read_bytes+1, rbuffer, &error);
+      elapsed = i2c_trace_time() - start;
 
       retval =  error;
 
       //    if (!WriteRead(sla >> 1, write_data, ((uint16_t)num_write_bytes), read_data, &rCnt))
         if (num_read_bytes ) {
-            VERBOSE i2c_print_trace("I2C R [%3d]: ", num_read_bytes,  rbuffer); // also show slave
+            i2c_trace_record(pBus, 'R', rbuffer[0], num_read_bytes-1, &rbuffer[1]); // also show slave
             memcpy((void*)read_data, (void*)&rbuffer[1], num_read_bytes-1); // remove slave address
+            i2c_stat_record('r', sla, num_write_bytes, write_data, num_read_bytes-1, elapsed);
+            if (i2c_capture)
+                (*i2c_capture)(i2c_capture_context, bus, sla, num_write_bytes, write_data, num_read_bytes-1);
         } else {
             PRINT_ERROR("empty read in %s\n", __FUNCTION__);
-            recover();
+            recover(pBus);
         }
+      bus_unlock(pBus);
   }
   return retval;
 }
 
+NXP_I2C_Error_t NXP_I2C_Batch(int num_msgs, NXP_I2C_Msg_t msgs[])
+{
+    return NXP_I2C_BatchBus(0, num_msgs, msgs);
+}
+
+NXP_I2C_Error_t NXP_I2C_BatchBus(int bus, int num_msgs, NXP_I2C_Msg_t msgs[])
+{
+    NXP_I2C_Error_t retval;
+    uint32_t error = NXP_I2C_Ok;
+    struct nxp_i2c_bus *pBus;
+    int i, done;
+    unsigned int start, elapsed;
+
+    retval = init_if_firsttime();
+    if (NXP_I2C_Ok != retval)
+        return retval;
+    pBus = get_bus(bus);
+
+    for (i=0; i<num_msgs; i++) {
+        if (msgs[i].num_write_bytes > bus_max_bytes(pBus)
+                || msgs[i].num_read_bytes > bus_max_bytes(pBus))
+        {
+            PRINT_ERROR("%s: too many bytes in transaction %d\n", __FUNCTION__, i);
+            return NXP_I2C_UnsupportedValue;
+        }
+    }
+
+    if (pBus->lxBatch == NULL) {
+        /* no batch support in this interface: one call per transaction */
+        bus_lock(pBus);
+        for (i=0; i<num_msgs && retval == NXP_I2C_Ok; i++) {
+            if (msgs[i].num_read_bytes)
+                retval = NXP_I2C_WriteReadBus(bus, msgs[i].sla, msgs[i].num_write_bytes,
+                        msgs[i].write_data, msgs[i].num_read_bytes, msgs[i].read_buffer);
+            else
+                retval = NXP_I2C_WriteBus(bus, msgs[i].sla, msgs[i].num_write_bytes,
+                        msgs[i].write_data);
+        }
+        bus_unlock(pBus);
+        return retval;
+    }
+
+    bus_lock(pBus);
+    start = i2c_trace_time();
+    done = (*pBus->lxBatch)(pBus->i2cTargetFd, num_msgs, msgs, &error);
+    elapsed = i2c_trace_time() - start;
+    if (done < 0)
+        recover(pBus);
+    bus_unlock(pBus);
+
+    for (i=0; i<done; i++) {
+        i2c_trace_record(pBus, msgs[i].num_read_bytes ? 'W' : 'w',
+                msgs[i].sla, msgs[i].num_write_bytes, msgs[i].write_data);
+        if (msgs[i].num_read_bytes)
+            i2c_trace_record(pBus, 'R', msgs[i].sla|1,
+                    msgs[i].num_read_bytes, msgs[i].read_buffer);
+        /* the transactions of a batch share its time evenly */
+        i2c_stat_record(msgs[i].num_read_bytes ? 'r' : 'w', msgs[i].sla,
+                msgs[i].num_write_bytes, msgs[i].write_data,
+                msgs[i].num_read_bytes, elapsed / done);
+        if (i2c_capture)
+            (*i2c_capture)(i2c_capture_context, bus, msgs[i].sla, msgs[i].num_write_bytes,
+                    msgs[i].write_data, msgs[i].num_read_bytes);
+    }
+
+    retval = error;
+    if (done < 0) {
+        PRINT_ERROR("empty batch in %s\n", __FUNCTION__);
+        if (retval == NXP_I2C_Ok)
+            retval = NXP_I2C_NoAck;
+    } else if (retval == NXP_I2C_Ok && done != num_msgs) {
+        PRINT_ERROR("short batch in %s: %d of %d\n", __FUNCTION__, done, num_msgs);
+        retval = NXP_I2C_NoAck;
+    }
+
+    return retval;
+}
+
 NXP_I2C_Error_t NXP_I2C_Version(char *data)
 {
         NXP_I2C_Error_t retval;
@@ -266,7 +875,7 @@ NXP_I2C_Error_t NXP_I2C_Version(char *data)
 
     if (NXP_I2C_Ok == retval)
     {
-        fd = (*lxVersionStr)(data, fd);
+        fd = (*busses[0].lxVersionStr)(data, fd);
     }
 
         if (fd < bufSz) {
@@ -278,12 +887,78 @@ NXP_I2C_Error_t NXP_I2C_Version(char *data)
     return retval;
 }
 
-int NXP_I2C_BufferSize()
+static int irqFd = -1;
+
+int NXP_I2C_SetIrq(int fd)
+{
+    int old = irqFd;
+
+    irqFd = fd;
+    return old;
+}
+
+int NXP_I2C_GetIrq(void)
+{
+    return irqFd;
+}
+
+int NXP_I2C_WaitIrq(int timeout_us)
+{
+#if !(defined(WIN32) || defined(_X64))
+    struct pollfd pfd;
+    char value[16];
+    int ret;
+
+    if (irqFd < 0) {
+        if (timeout_us > 0)
+            usleep(timeout_us);
+        return -1;
+    }
+
+    pfd.fd = irqFd;
+    pfd.events = POLLIN | POLLPRI;
+    pfd.revents = 0;
+    ret = poll(&pfd, 1, (timeout_us + 999) / 1000);
+    if (ret <= 0)
+        return 0;
+
+    /* consume the event: rewind for sysfs, drain for a pipe */
+    lseek(irqFd, 0, SEEK_SET);
+    if (read(irqFd, value, sizeof(value)) < 0)
+        return 0;
+
+    return 1;
+#else
+    Sleep((timeout_us + 999) / 1000);
+    return -1;
+#endif
+}
+
+int NXP_I2C_BufferSizeBus(int bus)
 {
     NXP_I2C_Error_t error;
     error = init_if_firsttime();
     if (error == NXP_I2C_Ok) {
-        return gI2cBufSz > NXP_I2C_MAX_SIZE ? gI2cBufSz : NXP_I2C_MAX_SIZE - 1;
+        return bus_max_bytes(get_bus(bus));
     }
     return NXP_I2C_MAX_SIZE - 1; //255 is minimum
 }
+
+int NXP_I2C_ResolveBus(int bus)
+{
+    return (int)(get_bus(bus) - busses);
+}
+
+int NXP_I2C_BufferSize()
+{
+    int bus, size, min = NXP_I2C_BufferSizeBus(0);
+
+    for (bus = 1; bus < NXP_I2C_MAX_BUSSES; bus++) {
+        if (!busses[bus].registered)
+            continue;
+        size = NXP_I2C_BufferSizeBus(bus);
+        if (size < min)
+            min = size;
+    }
+    return min;
+}
@@ -26,6 +26,7 @@
 #include <stdio.h>
 #if !(defined(WIN32) || defined(_X64))
 #include <unistd.h>
+#include <time.h>
 #endif
 #include <stdlib.h>
 #include <stdint.h>
@@ -75,6 +76,8 @@ static const char *typeNames[] = {
 
 void convertBytes2Data24(int num_bytes, const unsigned char bytes[],
                    int data[]);
+/* largest transaction incl the slave address */
+#define LXDUMMY_MAX_SIZE 4096
 /* globals */
 static int dummy_warm = 0; // can be set via "warm" argument
 static int lxDummy_verbose = 0;
@@ -211,6 +214,7 @@ struct dummy_device{
 //    } intreg;
     uint8_t fracdelaytable[3*9];
     int irqpin;
+    unsigned long long rpc_due; /* ns time the pending RPC ack sets, 0 if none */
 } ;
 static struct dummy_device dev[MAX_DUMMIES]; // max
 static int thisdev=0;
@@ -219,6 +223,7 @@ static int thisdev=0;
 /*  */
 
 static int i2cWrite(int length, const uint8_t *data);
+static int i2cWriteGeneric(int length, const uint8_t *data);
 static int i2cRead(int length, uint8_t *data);
 /*  */
 /* - TFA registers read/write */
@@ -234,6 +239,7 @@ static int tfaWrite(const uint8_t *data);
 static int lxDummyMemr(int type, uint8_t *data);
 static int lxDummyMemw(int type, const uint8_t *data);
 static int isClockOn(int thisdev); /* True if CF is ok and running */
+static void cfAck(int thisdev, enum tfa_fw_event evt);
 /*  */
 /* - DSP RPC interaction response */
 /*  */
@@ -307,6 +313,156 @@ static Tfa98xx_Config_t lastConfig;
 static Tfa98xx_Preset_t lastPreset;
 static Tfa98xx_SpeakerParameters_t lastSpeaker;
 
+/******************************************************************************
+ * bus timing model
+ *  off by default: every transaction returns immediately
+ *  it is enabled by a bus speed in the dummy arg, e.g. -ddummy90,400k,rpc=800
+ *  then each transaction holds the caller as long as it takes on a real bus
+ */
+static struct dummy_timing {
+    unsigned int bitrate;       /* bits/s, 0 is no timing */
+    unsigned int startstop_ns;  /* START/STOP setup and hold + bus free time */
+    unsigned int stretch_us;    /* clock stretching on each DSP memory access */
+    unsigned int rpc_us;        /* DSP RPC processing time till the ack */
+    unsigned long long busfree; /* ns, the bus is busy till then */
+} timing = {0, 0, 0, 500, 0};
+
+/* the interrupt pin as a pipe, see NXP_I2C_SetIrq() */
+static int dummyIrqPipe[2] = {-1, -1};
+
+static unsigned long long dummyTimeNs(void)
+{
+#if !(defined(WIN32) || defined(_X64))
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000000000 + now.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+/*
+ * wait till deadline
+ *  sleep for the bulk and spin for the rest, a sleep overshoots by tens
+ *  of us and that is in the order of a short transaction at 400k
+ */
+static void dummyWaitUntil(unsigned long long deadline)
+{
+#if !(defined(WIN32) || defined(_X64))
+    if (deadline > dummyTimeNs() + 200000) {
+        struct timespec ts;
+
+        ts.tv_sec = (deadline - 100000) / 1000000000;
+        ts.tv_nsec = (deadline - 100000) % 1000000000;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+            ;
+    }
+    while (dummyTimeNs() < deadline)
+        ;
+#endif
+}
+
+/*
+ * handle a timing arg, return 0 if it is not one
+ *  100k/400k/1M or any <n>k/<n>M bus speed, stretch=<us>, rpc=<us>
+ */
+static int dummyTimingArg(const char *arg)
+{
+#if !(defined(WIN32) || defined(_X64))
+    unsigned int value;
+    char unit;
+    int end = 0;
+
+    if (sscanf(arg, "stretch=%u%n", &value, &end) == 1 && arg[end] == '\0')
+        timing.stretch_us = value;
+    else if (sscanf(arg, "rpc=%u%n", &value, &end) == 1 && arg[end] == '\0')
+        timing.rpc_us = value;
+    else if (sscanf(arg, "%u%c%n", &value, &unit, &end) == 2 && arg[end] == '\0'
+            && (unit == 'k' || unit == 'M') && value) {
+        timing.bitrate = value * (unit == 'M' ? 1000000 : 1000);
+        /* tSU;STA + tHD;STA + tSU;STO + tBUF from the I2C spec */
+        if (timing.bitrate <= 100000)
+            timing.startstop_ns = 17400;
+        else if (timing.bitrate <= 400000)
+            timing.startstop_ns = 3100;
+        else
+            timing.startstop_ns = 1280;
+    } else
+        return 0;
+
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+/*
+ * make the interrupt pin available as a pipe to the HAL
+ */
+static void dummyIrqInit(void)
+{
+#if !(defined(WIN32) || defined(_X64))
+    if (dummyIrqPipe[0] >= 0)
+        return;
+    if (pipe(dummyIrqPipe) < 0) {
+        PRINT_ERROR("dummy: no irq pipe\n");
+        return;
+    }
+    fcntl(dummyIrqPipe[1], F_SETFL, O_NONBLOCK);
+    NXP_I2C_SetIrq(dummyIrqPipe[0]);
+    PRINT("dummy: interrupt pin on fd %d\n", dummyIrqPipe[0]);
+#endif
+}
+
+/*
+ * account the bus time of a transaction
+ *  both sizes include the slave address, a byte is 8 bits + ack and
+ *  a write-read has a repeated START
+ */
+static void dummyBusTime(int wsize, const uint8_t *wdata, int rsize)
+{
+    unsigned long long now, start, cost;
+
+    if (timing.bitrate == 0)
+        return;
+
+    cost = (unsigned long long)(wsize + rsize) * 9 * 1000000000 / timing.bitrate;
+    cost += timing.startstop_ns * (rsize ? 2 : 1);
+    if (wsize > 1 && wdata[1] == TFA98XX_CF_MEM)
+        cost += timing.stretch_us * 1000;
+
+    now = dummyTimeNs();
+    start = timing.busfree > now ? timing.busfree : now;
+    timing.busfree = start + cost;
+    dummyWaitUntil(timing.busfree);
+}
+
+/*
+ * set the ack of an RPC, immediately or after the DSP processing time
+ */
+static void dummyRpcAck(int thisdev)
+{
+    if (timing.bitrate && timing.rpc_us) {
+        dev[thisdev].rpc_due = dummyTimeNs() + timing.rpc_us * 1000ULL;
+        if (dummyIrqPipe[1] < 0)
+            return; /* ack on the next status poll */
+        /* no timer here to raise the interrupt later, so hold the bus
+         * till the DSP is done; the time is the same for the caller */
+        dummyWaitUntil(dev[thisdev].rpc_due);
+        dev[thisdev].rpc_due = 0;
+    }
+    cfAck(thisdev, tfa_fw_i2c_cmd_ack);
+}
+
+static void dummyRpcPoll(int thisdev)
+{
+    if (dev[thisdev].rpc_due && dummyTimeNs() >= dev[thisdev].rpc_due) {
+        dev[thisdev].rpc_due = 0;
+        cfAck(thisdev, tfa_fw_i2c_cmd_ack);
+    }
+}
+
 /******************************************************************************
  * HAL interface called via Scribo registered functions
  */
@@ -317,8 +473,12 @@ int lxDummyWriteRead(int fd, int NrOfWriteBytes, const uint8_t *WriteData,
     fd = 0; /* Remove unreferenced formal parameter warning */
 
     *pError = NXP_I2C_Ok;
+    dummyBusTime(NrOfWriteBytes, WriteData, NrOfReadBytes);
     /* there's always a write */
-    length = i2cWrite(NrOfWriteBytes, WriteData);
+    if ((WriteData[0] & ~1) == TFA98XX_GENERIC_SLAVE_ADDRESS && NrOfReadBytes == 0)
+        length = i2cWriteGeneric(NrOfWriteBytes, WriteData);
+    else
+        length = i2cWrite(NrOfWriteBytes, WriteData);
     /* and maybe a read */
     if ((NrOfReadBytes != 0) && (length != 0)) {
         length = i2cRead(NrOfReadBytes, ReadData);
@@ -341,6 +501,43 @@ int lxDummyWrite(int fd, int size, uint8_t *buffer, uint32_t *pError)
     return lxDummyWriteRead(fd, size, buffer, 0, NULL, pError);
 }
 
+/*
+ * all transactions of a batch are executed back to back, there is
+ *  no bus turnaround to save here but it keeps the call sequence of
+ *  the real targets
+ */
+int lxDummyBatch(int fd, int num_msgs, NXP_I2C_Msg_t *msgs, uint32_t *pError)
+{
+    uint8_t wbuffer[LXDUMMY_MAX_SIZE], rbuffer[LXDUMMY_MAX_SIZE];
+    int done;
+
+    *pError = NXP_I2C_Ok;
+    for (done = 0; done < num_msgs; done++) {
+        int wsize = msgs[done].num_write_bytes, rsize = msgs[done].num_read_bytes;
+
+        wbuffer[0] = msgs[done].sla;
+        memcpy(&wbuffer[1], msgs[done].write_data, wsize);
+        rbuffer[0] = msgs[done].sla | 1;
+        lxDummyWriteRead(fd, wsize+1, wbuffer, rsize ? rsize+1 : 0, rbuffer, pError);
+        if (*pError != NXP_I2C_Ok)
+            break;
+        if (rsize)
+            memcpy(msgs[done].read_buffer, &rbuffer[1], rsize);
+    }
+
+    return done;
+}
+
+/*
+ * the dummy takes any size that fits its buffers
+ */
+int lxDummyMaxSize(int fd)
+{
+    fd = 0; /* Remove unreferenced formal parameter warning */
+
+    return LXDUMMY_MAX_SIZE;
+}
+
 int lxDummyVersion(char *buffer, int fd)
 {
         return 1;
@@ -380,16 +577,34 @@ int lxDummyInit(char *file)
     if (file) {
     lxDummyArg = strchr(file, ','); /* the extra arg is after the comma */
 
-    if (lxDummyArg) {
+    while (lxDummyArg) {
+        char arg[FILENAME_MAX], *next;
+        int len;
+
         lxDummyArg++; /* skip the comma */
-        if (strcmp(lxDummyArg, "warm")==0)
+        next = strchr(lxDummyArg, ','); /* more args */
+        len = next ? (int)(next - lxDummyArg) : (int)strlen(lxDummyArg);
+        if (len >= (int)sizeof(arg))
+            len = sizeof(arg) - 1;
+        memcpy(arg, lxDummyArg, len);
+        arg[len] = '\0';
+
+        if (strcmp(arg, "warm")==0)
             dummy_warm=1;
-        else if (!setInputFile(lxDummyArg))    /* if filename use it */
+        else if (strcmp(arg, "irq")==0)
+            dummyIrqInit();
+        else if (dummyTimingArg(arg))
+            ;
+        else if (!setInputFile(arg))    /* if filename use it */
         {
-            lxDummyFailTest = atoi(lxDummyArg);
+            lxDummyFailTest = atoi(arg);
         }
+        DUMMYVERBOSE PRINT("arg: %s\n", arg);
+        lxDummyArg = next;
     }
-    DUMMYVERBOSE PRINT("arg: %s\n", lxDummyArg);
+    if (timing.bitrate)
+        PRINT("dummy: bus timing %u bit/s, clock stretch %u us, rpc %u us\n",
+                timing.bitrate, timing.stretch_us, timing.rpc_us);
     } else {
         PRINT("%s: called with NULL arg\n", __FUNCTION__);
     }
@@ -511,6 +726,29 @@ static int i2cRead(int length, uint8_t *data)
     return length;
 }
 
+/*
+ * write i2c to the generic slave address: all devices take it
+ */
+static int i2cWriteGeneric(int length, const uint8_t *data)
+{
+    uint8_t buffer[LXDUMMY_MAX_SIZE];
+    int i, acked = 0, current = thisdev;
+
+    if (length > (int)sizeof(buffer))
+        return 0;
+    memcpy(buffer, data, length);
+    for(i=0;i<MAX_DUMMIES;i++){
+        if (dev[i].slave == 0)
+            continue;
+        buffer[0] = dev[i].slave << 1;
+        if (i2cWrite(length, buffer))
+            acked++;
+    }
+    thisdev = current;
+
+    return acked ? length : 0;
+}
+
 /*
  * write i2c
  */
@@ -820,6 +1058,7 @@ static int tfaRead(uint8_t *data)
         dev[thisdev].currentreg++;    /* autoinc */
         break;
     case TFA98XX_CF_STATUS /*0x73 */:
+        dummyRpcPoll(thisdev);
         regval = dev[thisdev].Reg[reg];    /* just return */
         reglen = 2;
         dev[thisdev].currentreg++;    /* autoinc */
@@ -889,6 +1128,8 @@ static int i2cCfControlReg(uint16_t val)
         negedge = (oldval & ~newval);
         clearack = negedge;
         dev[thisdev].Reg[TFA98XX_CF_STATUS] &= ~(clearack & TFA98XX_CF_CONTROLS_REQ_MSK);
+        if (clearack & (1<<TFA98XX_CF_CONTROLS_REQ_POS))
+            dev[thisdev].rpc_due = 0; /* request withdrawn */
     }
     // reset transition 1->0 increment count_boot
     if ( dev[thisdev].Reg[TFA98XX_CF_CONTROLS] & TFA98XX_CF_CONTROLS_RST_MSK ) {// reset is on
@@ -915,7 +1156,7 @@ static int i2cCfControlReg(uint16_t val)
         } else
             ack=0;
         if(ack)
-            cfAck(thisdev, tfa_fw_i2c_cmd_ack);
+            dummyRpcAck(thisdev);
     }
 
     return val;
@@ -932,11 +1173,12 @@ static int updateInterrupt(int thisdev) {
     /* get all the input flags */
     status[0] = dev[thisdev].Reg[TFA98XX_STATUSREG];
     status[1] = dev[thisdev].Reg[0x30]; //TODO statusflags need datasheet?
-    /* the Ack flags are all or-ed into a seperate reg */
-    dev[thisdev].intack_sum = ((dev[thisdev].Reg[TFA98XX_CF_STATUS] & TFA98XX_CF_STATUS_ACK_MSK) !=0) << 1  |
-                                              ((dev[thisdev].Reg[TFA98XX_CF_STATUS] & TFA98XX_CF_STATUS_ERR_MSK) !=0 );
+    /* the Ack flags are all or-ed into a seperate reg, ack is tfa_irq_cfma_ack */
+    dev[thisdev].intack_sum = ((dev[thisdev].Reg[TFA98XX_CF_STATUS] & TFA98XX_CF_STATUS_ACK_MSK) !=0)  |
+                                              ((dev[thisdev].Reg[TFA98XX_CF_STATUS] & TFA98XX_CF_STATUS_ERR_MSK) !=0 ) << 1;
     status[2] = dev[thisdev].intack_sum ;
 
+    dev[thisdev].irqpin = 0; /* follows the enabled flags */
     for(x=0;x<3;x++) {
         out = &dev[thisdev].Reg[TFA98XX_INTERRUPT_OUT_REG1+x];
         in = &dev[thisdev].Reg[TFA98XX_INTERRUPT_IN_REG1+x];
@@ -957,6 +1199,8 @@ static int updateInterrupt(int thisdev) {
     edge = dev[thisdev].irqpin != pin; //true if pin changed
     if (edge)
         FUNC_TRACE("IRQ pin %d\n", dev[thisdev].irqpin);
+    if (edge && dev[thisdev].irqpin && dummyIrqPipe[1] >= 0)
+        write(dummyIrqPipe[1], "1", 1); /* if full an event is pending already */
     return edge;
 }
 
@@ -22,6 +22,10 @@
 #include <string.h>
 #include <stdint.h>
 #include <fcntl.h>
+#if defined(__linux__)
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#endif
 
 #include "dbgprint.h"
 #include "lxScribo.h"
@@ -32,10 +36,63 @@ int i2c_trace=0;
 extern int tfa98xxI2cSlave;
 static   char filename[FILENAME_MAX];
 
+/* an open adapter per registered bus */
+static struct {
+    char name[FILENAME_MAX];
+    int fd;
+    int rdwr;    /* I2C_RDWR works, see lxI2cRdwrSupported() */
+} lxI2cBus[NXP_I2C_MAX_BUSSES];
+
 #ifndef I2C_SLAVE
 #define I2C_SLAVE    0x0703    /* dummy address for building API    */
 #endif
 
+/*
+ * combined write/read with a repeated start via I2C_RDWR
+ *  cleared per adapter on the first transfer it refuses so that
+ *  subsequent calls go straight to the I2C_SLAVE+write+read path
+ */
+#if defined(I2C_RDWR) && defined(I2C_M_RD)
+#define LXI2C_RDWR    1
+#else
+#define LXI2C_RDWR    0
+#endif
+
+/* the I2C_RDWR flag of the adapter of fd */
+static int *lxI2cRdwrSupported(int fd)
+{
+    static int other = LXI2C_RDWR; /* an fd that was not opened here */
+    int i;
+
+    for (i=0; i<NXP_I2C_MAX_BUSSES; i++)
+        if ( lxI2cBus[i].name[0] && lxI2cBus[i].fd == fd )
+            return &lxI2cBus[i].rdwr;
+    return &other;
+}
+
+/* the kernel refuses I2C_RDWR calls with more messages than this */
+#ifndef I2C_RDWR_IOCTL_MAX_MSGS
+#define I2C_RDWR_IOCTL_MAX_MSGS    42
+#endif
+/* and i2c-dev refuses messages longer than this */
+#define LXI2C_MAX_SIZE    8192
+
+/* the largest transaction the user allows, 0 keeps NXP_I2C_MAX_SIZE */
+static int lxI2cUserMaxSize = 0;
+
+/*
+ * did the adapter refuse the I2C_RDWR call itself
+ *  an adapter with a length limit refuses a longer message with
+ *  EOPNOTSUPP too, longest is the longest transaction of the call
+ *  incl the slave address
+ */
+static int lxI2cRdwrRefused(int longest)
+{
+    if ( errno == ENOTTY || errno == EINVAL )
+        return 1;
+    return errno == EOPNOTSUPP && longest <= NXP_I2C_MAX_SIZE;
+}
+
 static void hexdump(int num_write_bytes, const unsigned char * data)
 {
     int i;
@@ -61,14 +118,50 @@ void  lxI2cSlave(int fd, int slave)
 
 }
 
+/*
+ * write the subaddress and read back the data in a single I2C_RDWR call
+ *  the adapter issues a repeated start between the 2 messages so no other
+ *  master can get in between and it costs 1 syscall instead of 3
+ *  return the nr of bytes read or -1 on failure
+ *  errno is left to the caller to decide on the fallback
+ */
+static int lxI2cRdwr(int fd, int NrOfWriteBytes, const uint8_t * WriteData,
+        int NrOfReadBytes, uint8_t * ReadData)
+{
+#if defined(I2C_RDWR) && defined(I2C_M_RD)
+    struct i2c_msg msgs[2];
+    struct i2c_rdwr_ioctl_data rdwr;
+
+    msgs[0].addr = WriteData[0]>>1;
+    msgs[0].flags = 0;
+    msgs[0].len = NrOfWriteBytes - 1;
+    msgs[0].buf = (uint8_t *)&WriteData[1];
+
+    msgs[1].addr = WriteData[0]>>1;
+    msgs[1].flags = I2C_M_RD;
+    msgs[1].len = NrOfReadBytes - 1;
+    msgs[1].buf = &ReadData[1];
+
+    rdwr.msgs = msgs;
+    rdwr.nmsgs = 2;
+
+    if ( ioctl(fd, I2C_RDWR, &rdwr) < 0 )
+        return -1;
+
+    return NrOfReadBytes - 1;
+#else
+    errno = ENOTTY;
+    return -1;
+#endif
+}
+
 /* SC42158
  *  Remove slave checking and use the address from the transaction.
  */
 int lxI2cWriteRead(int fd, int NrOfWriteBytes, const uint8_t * WriteData,
         int NrOfReadBytes, uint8_t * ReadData, unsigned int *pError) {
     int ln = -1;
-
-    lxI2cSlave(fd, WriteData[0]>>1 );
+    int done = 0;
 
     if (NrOfWriteBytes & i2c_trace) {
         PRINT("W %d:", NrOfWriteBytes);
@@ -76,20 +169,37 @@ int lxI2cWriteRead(int fd, int NrOfWriteBytes, const uint8_t * WriteData,
         PRINT("\n");
     }
 
-    if (NrOfWriteBytes > 2)
+    if (NrOfReadBytes && NrOfWriteBytes > 1 && *lxI2cRdwrSupported(fd)) {
+        ln = lxI2cRdwr(fd, NrOfWriteBytes, WriteData, NrOfReadBytes, ReadData);
+        if ( ln >= 0 ) {
+            done = 1;
+        } else if ( lxI2cRdwrRefused(NrOfWriteBytes > NrOfReadBytes ? NrOfWriteBytes : NrOfReadBytes) ) {
+            /* adapter can't do combined transfers: use separate ones from now on */
+            if (i2c_trace) PRINT("I2C_RDWR not supported, falling back\n");
+            *lxI2cRdwrSupported(fd) = 0;
+        } else {
+            done = 1; /* a real bus error, retrying the slow way won't help */
+        }
+    }
 
-        ln = write(fd, &WriteData[1],  NrOfWriteBytes - 1);
+    if (!done) {
+        lxI2cSlave(fd, WriteData[0]>>1 );
 
-    if (NrOfReadBytes) { // bigger
-        //if ( (ReadData[0]>1) != (WriteData[0]>1) ) // if block read is different
-        //        write(fd, &ReadData[0],  1);
-        ln = write(fd, &WriteData[1],1); //write sub address
-    if ( ln < 0 ) {
-      *pError = NXP_I2C_NoAck; /* treat all errors as nack */
-    } else {
-      ln = read(fd,  &ReadData[1], NrOfReadBytes-1);
+        if (NrOfWriteBytes > 2)
+
+            ln = write(fd, &WriteData[1],  NrOfWriteBytes - 1);
+
+        if (NrOfReadBytes) { // bigger
+            //if ( (ReadData[0]>1) != (WriteData[0]>1) ) // if block read is different
+            //        write(fd, &ReadData[0],  1);
+            ln = write(fd, &WriteData[1],1); //write sub address
+            if ( ln < 0 ) {
+                *pError = NXP_I2C_NoAck; /* treat all errors as nack */
+            } else {
+                ln = read(fd,  &ReadData[1], NrOfReadBytes-1);
+            }
+        }
     }
-  }
 
     if (NrOfReadBytes & i2c_trace) {
         PRINT("R %d:", NrOfReadBytes);
@@ -107,6 +217,126 @@ int lxI2cWriteRead(int fd, int NrOfWriteBytes, const uint8_t * WriteData,
     return ln+1;
 }
 
+/*
+ * execute a batch of transactions
+ *  as many as fit are packed in a single I2C_RDWR call, a write/read
+ *  pair is never split over 2 calls
+ *  if the adapter can't do that each transaction is done on its own
+ *  return the nr of transactions that were executed
+ */
+int lxI2cBatch(int fd, int num_msgs, NXP_I2C_Msg_t *msgs, unsigned int *pError)
+{
+    int done = 0;
+
+    *pError = NXP_I2C_Ok;
+
+#if defined(I2C_RDWR) && defined(I2C_M_RD)
+    while (*lxI2cRdwrSupported(fd) && done < num_msgs) {
+        struct i2c_msg imsgs[I2C_RDWR_IOCTL_MAX_MSGS];
+        struct i2c_rdwr_ioctl_data rdwr;
+        int n = 0, i = done, longest = 0;
+
+        while ( i < num_msgs ) {
+            int need = msgs[i].num_read_bytes ? 2 : 1;
+            if ( n + need > I2C_RDWR_IOCTL_MAX_MSGS )
+                break;
+            imsgs[n].addr = msgs[i].sla>>1;
+            imsgs[n].flags = 0;
+            imsgs[n].len = msgs[i].num_write_bytes;
+            imsgs[n].buf = (uint8_t *)msgs[i].write_data;
+            n++;
+            if ( msgs[i].num_write_bytes > longest )
+                longest = msgs[i].num_write_bytes;
+            if ( msgs[i].num_read_bytes > longest )
+                longest = msgs[i].num_read_bytes;
+            if ( msgs[i].num_read_bytes ) {
+                imsgs[n].addr = msgs[i].sla>>1;
+                imsgs[n].flags = I2C_M_RD;
+                imsgs[n].len = msgs[i].num_read_bytes;
+                imsgs[n].buf = msgs[i].read_buffer;
+                n++;
+            }
+            i++;
+        }
+
+        rdwr.msgs = imsgs;
+        rdwr.nmsgs = n;
+        if ( ioctl(fd, I2C_RDWR, &rdwr) < 0 ) {
+            if ( lxI2cRdwrRefused(longest + 1) ) {
+                if (i2c_trace) PRINT("I2C_RDWR not supported, falling back\n");
+                *lxI2cRdwrSupported(fd) = 0;
+                break;
+            }
+            *pError = NXP_I2C_NoAck; /* treat all errors as nack */
+            perror("i2c batch error");
+            return done;
+        }
+        if (i2c_trace) PRINT("I2C batch of %d messages\n", n);
+        done = i;
+    }
+#endif
+
+    /* one at the time, like lxI2cWriteRead() but straight from the msg buffers */
+    for ( ; done < num_msgs; done++) {
+        int wsize = msgs[done].num_write_bytes, rsize = msgs[done].num_read_bytes;
+        int ln = 0;
+
+        if (i2c_trace) {
+            PRINT("W %d:", wsize+1);
+            hexdump(wsize, msgs[done].write_data);
+            PRINT("\n");
+        }
+        lxI2cSlave(fd, msgs[done].sla>>1);
+        if ( wsize > 1 )
+            ln = write(fd, msgs[done].write_data, wsize);
+        if ( ln >= 0 && rsize ) {
+            ln = write(fd, msgs[done].write_data, 1); //write sub address
+            if ( ln >= 0 )
+                ln = read(fd, msgs[done].read_buffer, rsize);
+        }
+        if ( ln < 0 ) {
+            *pError = NXP_I2C_NoAck; /* treat all errors as nack */
+            perror("i2c slave error");
+            break;
+        }
+    }
+
+    return done;
+}
+
+/*
+ * allow transactions up to size bytes, incl the slave address
+ *  an adapter driver may have a lower limit than i2c-dev and it can't
+ *  be asked for it, so only the user can raise NXP_I2C_MAX_SIZE
+ *  call it before the bus is registered
+ */
+void lxI2cSetMaxSize(int size)
+{
+    lxI2cUserMaxSize = size;
+}
+
+/*
+ * the largest transaction the adapter of fd takes
+ *  NXP_I2C_MAX_SIZE unless the user allowed more with lxI2cSetMaxSize()
+ *  and the adapter does plain I2C, i2c-dev passes messages up to
+ *  LXI2C_MAX_SIZE, an SMBus only adapter is left at the default
+ */
+int lxI2cMaxSize(int fd)
+{
+#if defined(I2C_FUNCS) && defined(I2C_FUNC_I2C)
+    unsigned long funcs;
+    int size = lxI2cUserMaxSize;
+
+    if ( size > NXP_I2C_MAX_SIZE && ioctl(fd, I2C_FUNCS, &funcs) == 0 && (funcs & I2C_FUNC_I2C) ) {
+        if ( size > LXI2C_MAX_SIZE + 1 )
+            size = LXI2C_MAX_SIZE + 1; /* + slave address */
+        if (i2c_trace) PRINT("I2C adapter max size %d\n", size);
+        return size;
+    }
+#endif
+    return NXP_I2C_MAX_SIZE;
+}
+
 int lxI2cWrite(int fd, int size, uint8_t *buffer, unsigned int *pError)
 {
     return lxI2cWriteRead( fd, size, buffer, 0, NULL, pError);
@@ -115,10 +345,14 @@ int lxI2cWrite(int fd, int size, uint8_t *buffer, unsigned int *pError)
 /*
  * SC42158
  *  Slave is set in the transaction call.
+ *
+ * every adapter name gets its own fd, re-init of a name that is
+ *  open will close and reopen it (recovery)
+ *  if devname==NULL the last one is reopened
  */
 int lxI2cInit(char *devname)
 {
-    static int fd=-1;
+    int fd, i, slot=-1;
 
     if ( devname )
         strcpy(filename, devname);
@@ -126,8 +360,21 @@ int lxI2cInit(char *devname)
 //    if ( lxScribo_verbose ) TODO
 //        printf("Opening serial Scribo connection on %d\n", filename);
 
-    if (fd != -1 )
-        if (close(fd) )
+    for (i=0; i<NXP_I2C_MAX_BUSSES; i++) {
+        if ( lxI2cBus[i].name[0] && strcmp(lxI2cBus[i].name, filename)==0 ) {
+            slot = i;
+            break;
+        }
+        if ( slot < 0 && lxI2cBus[i].name[0]==0 )
+            slot = i;
+    }
+    if ( slot < 0 ) {
+        ERRORMSG("Too many i2c busses for %s\n", filename);
+        _exit(1);
+    }
+
+    if ( lxI2cBus[slot].name[0] && lxI2cBus[slot].fd != -1 )
+        if (close(lxI2cBus[slot].fd) )
             _exit(1);
 
     fd = open(filename, O_RDWR | O_NONBLOCK | O_EXCL, 0);
@@ -135,6 +382,10 @@ int lxI2cInit(char *devname)
         ERRORMSG("Can't open i2c bus:%s\n", filename);
         _exit(1);
     }
+    if ( lxI2cBus[slot].name[0]==0 )
+        lxI2cBus[slot].rdwr = LXI2C_RDWR; /* a recovery keeps what was found */
+    strcpy(lxI2cBus[slot].name, filename);
+    lxI2cBus[slot].fd = fd;
 
     return fd;
 }
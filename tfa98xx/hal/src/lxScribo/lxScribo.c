@@ -29,6 +29,10 @@
 #include <stdio.h>
 #if !(defined(WIN32) || defined(_X64))
 #include <unistd.h>
+#include <sys/uio.h>
+#include <poll.h>
+#include <time.h>
+#include <errno.h>
 #endif
 #include <stdint.h>
 #include <ctype.h>
@@ -40,7 +44,7 @@
 
 int lxScribo_verbose = 0;
 #define VERBOSE if (lxScribo_verbose)
-static char dev[FILENAME_MAX]; /* device name */
+static char lxScriboDev[FILENAME_MAX]; /* device name of bus 0 */
 static int lxScriboFd=-1;
 static int isDirect=0;        // global that tells if scribo is used for the target
 
@@ -53,9 +57,19 @@ const uint16_t cmdWrite     = 'w' ;  //Write I2C
 const uint16_t cmdWriteRead = ('w' << 8 | 'r');  // 'wr' Write and read I2C
 const uint16_t cmdPinSet        = ('p' << 8 | 's') ;  //pin set
 const uint16_t cmdPinRead     = ('p' << 8 | 'r') ;  //pin get
+const uint16_t cmdBufLength = ('b' << 8 | 'l');  // 'bl' I2C buffer length
 
 const uint8_t terminator    = 0x02;  //All commands and answers are terminated with 0x02
 
+/* max time to wait for a complete response (or part of it) */
+#define LXSCRIBO_RX_TIMEOUT_MS    1000
+
+/* nr of commands that are sent before the first response is read */
+#define LXSCRIBO_PIPELINE    8
+/* a frame is header + payload + readcount + terminator, the payload is not copied */
+#define LXSCRIBO_HEAD        5
+#define LXSCRIBO_TAIL        3
+
 struct cmdHeader {
     uint16_t cmd;
     uint16_t length;
@@ -91,6 +105,10 @@ static void dump_buffer(int length, char *buf)
     fflush(stdout);
 }
 
+#if !(defined(WIN32) || defined(_X64))
+static int lxScriboReadAll(int fd, uint8_t *buffer, int size);
+#endif
+
 static int lxScriboGetResponseHeader(int fd, const uint16_t cmd, int* prlength)
 {
     uint8_t response[6];
@@ -110,7 +128,7 @@ static int lxScriboGetResponseHeader(int fd, const uint16_t cmd, int* prlength)
     } while (length<sizeof(response) );
 
 #elif !(defined(WIN32) || defined(_X64))
-    length = read(fd, response, sizeof(response)); //
+    length = lxScriboReadAll(fd, response, sizeof(response)); //
 #endif //CYGWIN
     VERBOSE hexdump("rsp:", response, sizeof(response));
 
@@ -175,7 +193,7 @@ int lxScriboSetPin(int fd, int pin, int value)
     stat = lxScriboGetResponseHeader( fd, cmdPinSet, &rlength);
     assert(stat == 0);
     assert(rlength == 0); // expect no return data
-    ret = read(fd, &term, 1);
+    ret = lxScriboReadAll(fd, &term, 1);
     assert(ret == 1);
 
     VERBOSE PRINT("term: 0x%02x\n", term);
@@ -255,206 +273,320 @@ int lxScriboVersion(char *buffer, int fd)
 #endif
 }
 #if !(defined(WIN32) || defined(_X64))
-int lxScriboWrite(int fd, int size, uint8_t *buffer, uint32_t *pError)
+/*
+ * milliseconds left until deadline
+ */
+static int lxScriboTimeLeft(const struct timespec *deadline)
 {
-    uint8_t cmd[5], slave,term;
-    int status, total=0;
-    int rlength;
+    struct timespec now;
+    long ms;
 
-    *pError = NXP_I2C_Ok;
-    // slave is the 1st byte in wbuffer
-    slave = buffer[0] >> 1;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ms = (deadline->tv_sec - now.tv_sec) * 1000
+            + (deadline->tv_nsec - now.tv_nsec) / 1000000;
 
-    size -= 1;
-    buffer++;
+    return ms > 0 ? (int)ms : 0;
+}
 
-    cmd[0] = cmdWrite;// lsb
-    cmd[1] = cmdWrite>>8;// msb
-    cmd[2] = slave; // 1st byte is the i2c slave address
-    cmd[3] = size & 0xff; // lsb
-    cmd[4] = (size >> 8) & 0xff; // msb
+/*
+ * read until all bytes are in, a stream may return less than asked for
+ *  wait for the data with poll() so that this returns as soon as the
+ *  last byte arrives, give up after LXSCRIBO_RX_TIMEOUT_MS
+ *  return the nr of bytes read, or the read error if nothing was read
+ */
+static int lxScriboReadAll(int fd, uint8_t *buffer, int size)
+{
+    struct timespec deadline;
+    struct pollfd pfd;
+    int actual, length = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += LXSCRIBO_RX_TIMEOUT_MS / 1000;
+    deadline.tv_nsec += (LXSCRIBO_RX_TIMEOUT_MS % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
 
-    // write header
-    VERBOSE PRINT("cmd: 0x%02x 0x%02x 0x%02x 0x%02x 0x%02x ",
-            cmd[0], cmd[1],cmd[2],cmd[3],cmd[4]);
-    status = write(fd, cmd, sizeof(cmd));
-    if(status>0)
-        total+=status;
-    else
-    {
-        *pError = NXP_I2C_NoAck;
-        return status;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+
+    while (length < size) {
+        actual = poll(&pfd, 1, lxScriboTimeLeft(&deadline));
+        if (actual < 0 && errno == EINTR)
+            continue;
+        if (actual == 0) {
+            ERRORMSG("scribo timeout: got %d of %d bytes\n", length, size);
+            break;
+        }
+        if (actual < 0 || (pfd.revents & (POLLERR | POLLNVAL)))
+            return length ? length : -1;
+
+        actual = read(fd, buffer + length, size - length);
+        if (actual < 0 && errno == EINTR)
+            continue;
+        if (actual <= 0)
+            return length ? length : actual;
+        length += actual;
     }
-    // write payload
-    VERBOSE hexdump("\t\twdata:", buffer, size);
-    status = write(fd, buffer, size);
-    if(status>0)
-        total+=status;
-    else
-    {
-        *pError = NXP_I2C_NoAck;
-        return status;
+    return length;
+}
+
+/*
+ * put a write or write-read command for msg in iov[3]
+ *  head and tail hold the framing, the payload is taken from msg as is
+ *  return the frame length
+ */
+static int lxScriboFrame(struct iovec *iov, uint8_t *head, uint8_t *tail,
+        const NXP_I2C_Msg_t *msg)
+{
+    uint16_t cmd = msg->num_read_bytes ? cmdWriteRead : cmdWrite;
+    int wsize = msg->num_write_bytes, length = 0;
+
+    //Format = 'wr'(16) + sla(8) + w_cnt(16) + data(8 * w_cnt) + r_cnt(16) + 0x02
+    //      or 'w'(16) + sla(8) + w_cnt(16) + data(8 * w_cnt) + 0x02
+    head[0] = cmd & 0xff; // lsb
+    head[1] = cmd >> 8; // msb
+    head[2] = msg->sla >> 1;
+    head[3] = wsize & 0xff; // lsb
+    head[4] = (wsize >> 8) & 0xff; // msb
+    if (msg->num_read_bytes) {
+        tail[length++] = msg->num_read_bytes & 0xff; // lsb
+        tail[length++] = (msg->num_read_bytes >> 8) & 0xff; // msb
     }
-    // write terminator
-    cmd[0] = terminator;
-    VERBOSE PRINT("term: 0x%02x\n", cmd[0]);
-    status = write(fd, cmd, 1);
-    if(status>0)
-        total+=status;
-    else
-    {
-        *pError = NXP_I2C_NoAck;
-        return status;
+    tail[length++] = terminator;
+
+    iov[0].iov_base = head;
+    iov[0].iov_len = LXSCRIBO_HEAD;
+    iov[1].iov_base = (void *)msg->write_data;
+    iov[1].iov_len = wsize;
+    iov[2].iov_base = tail;
+    iov[2].iov_len = length;
+
+    return LXSCRIBO_HEAD + wsize + length;
+}
+
+/*
+ * write all of iov, a stream may take less than offered
+ *  return 0 if all length bytes went out
+ */
+static int lxScriboWritev(int fd, struct iovec *iov, int iovcnt, int length)
+{
+    int actual;
+
+    VERBOSE {
+        int i;
+        for (i = 0; i < iovcnt; i++)
+            hexdump(i ? "    " : "cmd:", iov[i].iov_base, iov[i].iov_len);
     }
+    while (length > 0) {
+        actual = writev(fd, iov, iovcnt);
+        if (actual < 0 && errno == EINTR)
+            continue;
+        if (actual <= 0)
+            return -1;
+        length -= actual;
+        /* skip what was written */
+        while (iovcnt && actual >= (int)iov->iov_len) {
+            actual -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt) {
+            iov->iov_base = (uint8_t *)iov->iov_base + actual;
+            iov->iov_len -= actual;
+        }
+    }
+    return 0;
+}
 
-    status = lxScriboGetResponseHeader(fd, cmdWrite, &rlength);
-    if (status != 0)
-    {
+/*
+ * collect the response of the command for msg
+ *  a status error is returned in pError but the stream is still in sync
+ *  return 0 if the whole response was read, -1 if the stream is broken
+ */
+static int lxScriboResponse(int fd, NXP_I2C_Msg_t *msg, uint32_t *pError)
+{
+    uint16_t cmd = msg->num_read_bytes ? cmdWriteRead : cmdWrite;
+    int status, rlength = 0;
+    uint8_t term;
+
+    status = lxScriboGetResponseHeader(fd, cmd, &rlength);
+    if (status < 0) {
+        *pError = NXP_I2C_NoAck;
+        return -1;
+    }
+    if (status != 0 && *pError == NXP_I2C_Ok)
         *pError = status;
+    if (rlength > msg->num_read_bytes) {
+        ERRORMSG("scribo protocol error: expected %d bytes , got %d bytes\n",
+                msg->num_read_bytes, rlength);
+        *pError = NXP_I2C_BufferOverRun;
+        return -1;
     }
-    assert(rlength == 0); // expect no return data
-    status = read(fd, &term, 1);
-    if (status < 0)
-    {
-        if (*pError == NXP_I2C_Ok) *pError = NXP_I2C_NoAck;
-        return status;
+    if (rlength > 0) {
+        if (lxScriboReadAll(fd, msg->read_buffer, rlength) != rlength) {
+            *pError = NXP_I2C_NoAck;
+            return -1;
+        }
+        VERBOSE hexdump("\trdata:", msg->read_buffer, rlength);
+    }
+    if (rlength < msg->num_read_bytes) {
+        ERRORMSG("scribo protocol error: expected %d bytes , got %d bytes\n",
+                msg->num_read_bytes, rlength);
+        if (*pError == NXP_I2C_Ok)
+            *pError = NXP_I2C_NoAck;
+    }
+    if (lxScriboReadAll(fd, &term, 1) != 1) {
+        *pError = NXP_I2C_NoAck;
+        return -1;
     }
     assert(term == terminator);
-    VERBOSE PRINT("term: 0x%02x\n", term);
-    return total;
+    VERBOSE PRINT("rterm: 0x%02x\n", term);
+
+    return 0;
+}
+
+/*
+ * send one command in a single write and wait for its response
+ */
+static int lxScriboTransfer(int fd, NXP_I2C_Msg_t *msg, uint32_t *pError)
+{
+    uint8_t head[LXSCRIBO_HEAD], tail[LXSCRIBO_TAIL];
+    struct iovec iov[3];
+    int length;
+
+    *pError = NXP_I2C_Ok;
+
+    length = lxScriboFrame(iov, head, tail, msg);
+    if (lxScriboWritev(fd, iov, 3, length) < 0) {
+        *pError = NXP_I2C_NoAck;
+        return -1;
+    }
+
+    return lxScriboResponse(fd, msg, pError) < 0 ? -1 : length;
+}
+
+int lxScriboWrite(int fd, int size, uint8_t *buffer, uint32_t *pError)
+{
+    NXP_I2C_Msg_t msg;
+
+    // slave is the 1st byte in wbuffer
+    msg.sla = buffer[0];
+    msg.num_write_bytes = size - 1;
+    msg.write_data = buffer + 1;
+    msg.num_read_bytes = 0;
+    msg.read_buffer = NULL;
+
+    return lxScriboTransfer(fd, &msg, pError);
 }
 
 int lxScriboWriteRead(int fd, int wsize, const uint8_t *wbuffer, int rsize,
         uint8_t *rbuffer, uint32_t *pError) {
-    uint8_t cmd[5], rcnt[2], slave, *rptr, term;
-    int length = 0;
-    int status, total = 0;
-    int rlength;
+    NXP_I2C_Msg_t msg;
+
+    if ((wbuffer[0] | 1) != rbuffer[0]) { // write & read must be to same target
+        PRINT("!!!! write slave != read slave !!! %s:%d\n", __FILE__, __LINE__);
+        *pError = NXP_I2C_UnsupportedValue;
+        return -1;
+    }
+
+    // slave is the 1st byte in wbuffer and rbuffer, remove here
+    msg.sla = wbuffer[0];
+    msg.num_write_bytes = wsize - 1;
+    msg.write_data = wbuffer + 1;
+    msg.num_read_bytes = rsize - 1;
+    msg.read_buffer = rbuffer + 1;
+
+    if (lxScriboTransfer(fd, &msg, pError) < 0)
+        return 0;
+
+    return rsize; // we need 1 more for the length because of the slave address
+}
+
+/*
+ * pipelined batch
+ *  up to LXSCRIBO_PIPELINE commands are sent in one write before the
+ *  responses are collected in order, this hides the round trip for all
+ *  but the first command
+ *  a status error stops the batch after the window it is in, the commands
+ *  of that window were sent and are executed by the target
+ *  return the nr of transactions that were executed, -1 if the stream is
+ *  broken and the target must be recovered
+ */
+int lxScriboBatch(int fd, int num_msgs, NXP_I2C_Msg_t *msgs, uint32_t *pError)
+{
+    uint8_t heads[LXSCRIBO_PIPELINE][LXSCRIBO_HEAD], tails[LXSCRIBO_PIPELINE][LXSCRIBO_TAIL];
+    struct iovec iov[3 * LXSCRIBO_PIPELINE];
+    int done = 0;
 
     *pError = NXP_I2C_Ok;
-    // slave is the 1st byte in wbuffer
-    slave = wbuffer[0] >> 1;
-
-    wsize -= 1;
-    wbuffer++;
-
-    if ((slave<<1) + 1 == rbuffer[0]) // write & read to same target
-            {
-        //Format = 'wr'(16) + sla(8) + w_cnt(16) + data(8 * w_cnt) + r_cnt(16) + 0x02
-        cmd[0] = cmdWriteRead & 0xFF ;
-        cmd[1] = cmdWriteRead >> 8;
-        cmd[2] = slave;
-        cmd[3] = wsize & 0xff; // lsb
-        cmd[4] = (wsize >> 8) & 0xff; // msb
-
-        // write header
-        VERBOSE hexdump("cmd:", cmd, sizeof(cmd));
-        status = write(fd, cmd, sizeof(cmd));
-        if (status > 0)
-            total += status;
-        else
-        {
-            *pError = NXP_I2C_NoAck;
-            return status;
-        }
-        // write payload
-        VERBOSE hexdump("\t\twdata:", wbuffer, wsize);
-        status = write(fd, wbuffer, wsize);
-        if (status > 0)
-            total += status;
-        else
-        {
-            *pError = NXP_I2C_NoAck;
-            return status;
-        }
 
-        // write readcount
-        rsize -= 1;
-        rcnt[0] = rsize & 0xff; // lsb
-        rcnt[1] = (rsize >> 8) & 0xff; // msb
-        VERBOSE hexdump("rdcount:",rcnt, 2);
-        status = write(fd, rcnt, 2);
-        if (status > 0)
-            total += status;
-        else
-        {
-            *pError = NXP_I2C_NoAck;
-            return status;
-        }
+    while (done < num_msgs) {
+        int i, n, length = 0;
 
-        // write terminator
-        cmd[0] = terminator;
-        VERBOSE PRINT("term: 0x%02x\n", cmd[0]);
-        status = write(fd, cmd, 1);
-        if (status > 0)
-            total += status;
-        else
-        {
-            *pError = NXP_I2C_NoAck;
-            return status;
-        }
+        n = num_msgs - done;
+        if (n > LXSCRIBO_PIPELINE)
+            n = LXSCRIBO_PIPELINE;
 
-        //if( rcnt[1] | rcnt[0] >100)    // TODO check timing
-        if (rsize > 100) // ?????????????????????????????????????
-            usleep(20000);
-        // slave is the 1st byte in rbuffer, remove here
-        //rsize -= 1;
-        rptr = rbuffer+1;
-        // read back, blocking
-        status = lxScriboGetResponseHeader(fd, cmdWriteRead, &rlength);
-        if (status != 0)
-        {
-            *pError = status;
-        }
-        //assert(rlength == rsize);
-        if  ( rlength != rsize) {
-            ERRORMSG("scribo protocol error: expected %d bytes , got %d bytes\n", rsize, rlength);
-        }
-        /*** FOR CYGWING - remove or fix this!
-        //    VERBOSE PRINT("Reading %d bytes\n", rsize);
-        #ifdef CYGWIN
-            length=0;
-            do {
-                int actual;
-                actual = read(fd, rptr, rsize-length);  //
-                rptr += actual;
-                length += actual;
-                if(actual<0)
-                        break;
-            } while (length<rsize );
-        #else
-                length = read(fd, rptr, rsize); //
-        #endif //CYGWIN
-        ****/
-
-
-        //    VERBOSE PRINT("Reading %d bytes\n", rsize);
-        length = read(fd, rptr, rsize); //
-        if (length < 0)
-        {
-            if (*pError == NXP_I2C_Ok) *pError = NXP_I2C_NoAck;
+        for (i = 0; i < n; i++)
+            length += lxScriboFrame(&iov[3 * i], heads[i], tails[i], &msgs[done + i]);
+
+        if (lxScriboWritev(fd, iov, 3 * n, length) < 0) {
+            *pError = NXP_I2C_NoAck;
             return -1;
         }
-        VERBOSE hexdump("\trdata:",rptr, rsize);
-        // else something wrong, still read the terminator
-        //    if(status>0) TODO handle error
-        status = read(fd, &term, 1);
-        if (length < 0)
-        {
-            if (*pError == NXP_I2C_Ok) *pError = NXP_I2C_NoAck;
-            return -1;
+
+        /* all responses must be consumed to keep the stream in sync,
+         * the responses behind a broken one can't be found anymore */
+        for (i = 0; i < n; i++) {
+            if (lxScriboResponse(fd, &msgs[done + i], pError) < 0)
+                return -1;
         }
-        assert(term == terminator);
-        VERBOSE PRINT("rterm: 0x%02x\n", term);
+
+        done += n;
+        if (*pError != NXP_I2C_Ok)
+            break; /* status error somewhere in this window */
     }
-    else {
-        PRINT("!!!! write slave != read slave !!! %s:%d\n", __FILE__, __LINE__);
-        *pError = NXP_I2C_UnsupportedValue;
-        status = -1;
-        return status;
+
+    return done;
+}
+
+/*
+ * ask the target for its I2C buffer length
+ *  a target that doesn't know the command stays at the default
+ *  return the largest transaction incl the slave address
+ */
+int lxScriboMaxSize(int fd)
+{
+    uint8_t cmd[3], data[2], term;
+    int status, rlength = 0, i, size;
+
+    cmd[0] = cmdBufLength & 0xff;
+    cmd[1] = cmdBufLength >> 8;
+    cmd[2] = terminator;
+
+    VERBOSE hexdump("cmd:", cmd, sizeof(cmd));
+    if (write(fd, cmd, sizeof(cmd)) != sizeof(cmd))
+        return NXP_I2C_MAX_SIZE;
+
+    status = lxScriboGetResponseHeader(fd, cmdBufLength, &rlength);
+    if (status < 0)
+        return NXP_I2C_MAX_SIZE;
+    /* consume the whole response to keep the stream in sync */
+    for (i = 0; i < rlength; i++) {
+        if (lxScriboReadAll(fd, &data[i < 2 ? i : 1], 1) != 1)
+            return NXP_I2C_MAX_SIZE;
     }
-    return length>0 ? (length + 1) : 0; // we need 1 more for the length because of the slave address
+    if (lxScriboReadAll(fd, &term, 1) != 1 || term != terminator)
+        return NXP_I2C_MAX_SIZE;
+    if (status != 0 || rlength != 2)
+        return NXP_I2C_MAX_SIZE;
+
+    size = data[0] | data[1] << 8;
+    VERBOSE PRINT("scribo buffer length: %d\n", size);
 
+    return size + 1; /* the length is without the slave address */
 }
 #endif // windows
 
@@ -465,6 +597,29 @@ int lxScriboWriteRead(int fd, int wsize, const uint8_t *wbuffer, int rsize,
  */
 int lxScriboRegister(char *target)
 {
+    return lxScriboRegisterBus(0, target);
+}
+
+/**
+ * register the low level I2C HAL interface of a bus
+ *  the fd and name of bus 0 are the ones returned by lxScriboGetFd()
+ *  and lxScriboGetName()
+ *  @param bus bus id, 0..NXP_I2C_MAX_BUSSES-1
+ *  @param target device name; if NULL the default will be registered
+ *  @return file descriptor of target device if successful
+ */
+int lxScriboRegisterBus(int bus, char *target)
+{
+    static char busdev[NXP_I2C_MAX_BUSSES][FILENAME_MAX]; /* init may modify the name */
+    char *dev;
+    int fd=-1;
+
+    if ( bus < 0 || bus >= NXP_I2C_MAX_BUSSES ) {
+        ERRORMSG("%s: bad bus nr %d\n", __FUNCTION__, bus);
+        return -1;
+    }
+    dev = busdev[bus];
+
     if (target ){
         strcpy(dev, target);
     } else {
@@ -472,41 +627,51 @@ int lxScriboRegister(char *target)
     }
 
     if ( lxScribo_verbose ) {
-            PRINT("%s:target device=%s\n", __FUNCTION__, dev);
+            PRINT("%s:target device[%d]=%s\n", __FUNCTION__, bus, dev);
     }
 
     /* tell the HAL which interface functions : */
 
     /////////////// dummy //////////////////////////////
     if ( strncmp (dev, "dummy",  5 ) == 0 ) {// if dummy act dummy
-        lxScriboFd = NXP_I2C_Interface(dev, lxDummyInit, lxDummyWrite, lxDummyWriteRead, lxDummyVersion);
-        isDirect=1; // don't use unix filedescriptor for read/write
+        fd = NXP_I2C_InterfaceBus(bus, dev, lxDummyInit, lxDummyWrite, lxDummyWriteRead, lxDummyVersion);
+        NXP_I2C_BatchInterface(lxDummyBatch);
+        NXP_I2C_MaxSizeInterface(lxDummyMaxSize);
+        if (bus==0)
+            isDirect=1; // don't use unix filedescriptor for read/write
     }
 #if !( defined(WIN32) || defined(_X64) ) // posix/linux
 #ifdef    HAL_HID
     /////////////// hid //////////////////////////////
     else if ( strncmp( dev , "hid", 3 ) == 0)    { // hid
-        lxScriboFd = NXP_I2C_Interface(dev,lxHidInit,lxHidWrite,lxHidWriteRead, lxHidVersion);
+        fd = NXP_I2C_InterfaceBus(bus, dev,lxHidInit,lxHidWrite,lxHidWriteRead, lxHidVersion);
     }
 #endif
     /////////////// network //////////////////////////////
     else if ( strchr( dev , ':' ) != 0)    { // if : in name > it's a socket
-        lxScriboFd = NXP_I2C_Interface(dev, lxScriboSocketInit, lxScriboWrite, lxScriboWriteRead, lxScriboVersion);
+        fd = NXP_I2C_InterfaceBus(bus, dev, lxScriboSocketInit, lxScriboWrite, lxScriboWriteRead, lxScriboVersion);
+        NXP_I2C_BatchInterface(lxScriboBatch);
+        NXP_I2C_MaxSizeInterface(lxScriboMaxSize);
     }
     /////////////// i2c //////////////////////////////
     else if ( strncmp (dev, "/dev/sma",  8 ) == 0 ) { // if /dev/i2c... direct i2c device
-        lxScriboFd = NXP_I2C_Interface(dev, lxI2cInit, lxI2cWrite, lxI2cWriteRead, lxI2cVersion);
-        isDirect=1;    // don't use unix filedescriptorfor read/write
+        fd = NXP_I2C_InterfaceBus(bus, dev, lxI2cInit, lxI2cWrite, lxI2cWriteRead, lxI2cVersion);
+        NXP_I2C_BatchInterface(lxI2cBatch);
+        NXP_I2C_MaxSizeInterface(lxI2cMaxSize);
+        if (bus==0)
+            isDirect=1;    // don't use unix filedescriptorfor read/write
         VERBOSE PRINT("%s: i2c\n", __FUNCTION__);
     }
     /////////////// serial/USB //////////////////////////////
     else if ( strncmp (dev, "/dev/tty",  8 ) == 0 ) { // if /dev/ it must be a serial device
-        lxScriboFd = NXP_I2C_Interface(dev, lxScriboSerialInit, lxScriboWrite, lxScriboWriteRead, lxScriboVersion);
+        fd = NXP_I2C_InterfaceBus(bus, dev, lxScriboSerialInit, lxScriboWrite, lxScriboWriteRead, lxScriboVersion);
+        NXP_I2C_BatchInterface(lxScriboBatch);
+        NXP_I2C_MaxSizeInterface(lxScriboMaxSize);
     }
 
 #else /////////////// Scribo server //////////////////////////////
     else if ( strncmp (dev, "scribo",  5 ) == 0 ) {// Scribo server dll interface
-        lxScriboFd = NXP_I2C_Interface(dev, lxWindowsInit, lxWindowsWrite, lxWindowsWriteRead, lxWindowsVersion);
+        fd = NXP_I2C_InterfaceBus(bus, dev, lxWindowsInit, lxWindowsWrite, lxWindowsWriteRead, lxWindowsVersion);
     }
 #endif
     else {
@@ -514,7 +679,12 @@ int lxScriboRegister(char *target)
         _exit(1);
     }
 
-    return lxScriboFd;
+    if (bus==0) {
+        strcpy(lxScriboDev, dev);
+        lxScriboFd = fd;
+    }
+
+    return fd;
 }
 
 int lxScriboGetFd(void)
@@ -527,7 +697,7 @@ int lxScriboGetFd(void)
 
 char * lxScriboGetName(void)
 {
-    return dev;
+    return lxScriboDev;
 }
 
 int lxScriboPrintTargetRev(int fd)
@@ -25,6 +25,7 @@
 #endif
 
 #include "lxScribo.h"
+#include "NXP_I2C.h"
 
 #ifndef B460800
 #define B460800 460800
@@ -35,6 +36,12 @@
 extern int lxScribo_verbose;
 static   char filename[FILENAME_MAX];
 
+/* an open tty per registered bus */
+static struct {
+    char name[FILENAME_MAX];
+    int fd;
+} lxSerialBus[NXP_I2C_MAX_BUSSES];
+
 /*
  * init or recover the connection
  *   if dev==NULL recover else just open
@@ -42,7 +49,7 @@ static   char filename[FILENAME_MAX];
 int lxScriboSerialInit(char *dev)
 {
     struct termios tio;
-    static int tty_fd=-1;
+    int tty_fd=-1, i, slot=-1;
 //    char tmp[256];
 
     if ( dev )
@@ -51,8 +58,21 @@ int lxScriboSerialInit(char *dev)
     if ( lxScribo_verbose )
         printf("Opening serial Scribo connection on %s\n", filename);
 
-    if (tty_fd != -1 )
-        if (close(tty_fd) )
+    for (i=0; i<NXP_I2C_MAX_BUSSES; i++) {
+        if ( lxSerialBus[i].name[0] && strcmp(lxSerialBus[i].name, filename)==0 ) {
+            slot = i;
+            break;
+        }
+        if ( slot < 0 && lxSerialBus[i].name[0]==0 )
+            slot = i;
+    }
+    if ( slot < 0 ) {
+        printf("Too many serial busses for %s\n", filename);
+        _exit(1);
+    }
+
+    if ( lxSerialBus[slot].name[0] && lxSerialBus[slot].fd != -1 )
+        if (close(lxSerialBus[slot].fd) )
             _exit(1);
 
     memset(&tio,0,sizeof(tio));
@@ -76,6 +96,9 @@ int lxScriboSerialInit(char *dev)
 
     tcsetattr(tty_fd,TCSANOW,&tio);
 
+    strcpy(lxSerialBus[slot].name, filename);
+    lxSerialBus[slot].fd = tty_fd;
+
 
     //    lxScriboSetPin(tty_fd, 4, 0x8000); // Weak pull-up on PA4. Is power-up UDA1355.
 
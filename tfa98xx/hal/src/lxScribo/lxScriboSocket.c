@@ -30,9 +30,33 @@
 #include <arpa/inet.h>
 #endif
 
+#include "NXP_I2C.h"
+
 static    int listenSocket=-1;
 static int activeSocket=-1;
 
+/* the servers that are connected, one per bus */
+static char servers[NXP_I2C_MAX_BUSSES][FILENAME_MAX];
+
+/*
+ * return 1 if there is a connection to this server, else remember it
+ *  the name is checked before it gets modified by the init
+ */
+static int lxScriboSocketIsOpen(const char *server)
+{
+    int i;
+
+    for (i=0; i<NXP_I2C_MAX_BUSSES; i++) {
+        if ( strcmp(servers[i], server)==0 )
+            return 1;
+        if ( servers[i][0]==0 ) {
+            strncpy(servers[i], server, FILENAME_MAX-1);
+            return 0;
+        }
+    }
+    return 0;
+}
+
 typedef void (*sighandler_t)(int);
 
 /*
@@ -59,6 +83,7 @@ void lxScriboSocketExit(int status)
         read(activeSocket, buf, 256);
         close(activeSocket);
     }
+    fflush(stdout); /* _exit() doesn't */
     _exit(status);
 }
 
@@ -89,7 +114,7 @@ int lxScriboSocketInit(char *server)//, char *hostname)
        struct hostent *host;
        int port;
 
-       if ( server==0 ) {
+       if ( server==0 || lxScriboSocketIsOpen(server) ) {
            fprintf (stderr, "%s:called for recovery, exiting for now...", __FUNCTION__);
            lxScriboSocketExit(1);
        }
@@ -133,15 +158,15 @@ int lxScriboSocketInit(char *server)//, char *hostname)
 }
 
 /*
- * the sockets are created first and then waits until a connection is done
- * the active socket is returned
+ * create the listening socket
+ *  the listen socket is returned, or -1 on error
  */
-int lxScriboListenSocketInit(char *socketnr)
+int lxScriboListenSocketOpen(char *socketnr)
 {
-    int port;
+    int port, on = 1;
     int  rc;
     char hostname[50];
-    char clientIP [INET6_ADDRSTRLEN];
+    struct sockaddr_in serverAdd;
 
     port = atoi(socketnr);
     if(port==0) // illegal input
@@ -154,10 +179,6 @@ int lxScriboListenSocketInit(char *socketnr)
         return -1;
     }
 
-    struct sockaddr_in serverAdd;
-    struct sockaddr_in clientAdd;
-    socklen_t clientAddLen;
-
     atexit(lxScriboAtexit);
     (void) signal(SIGINT, lxScriboCtlc);
 
@@ -177,6 +198,8 @@ int lxScriboListenSocketInit(char *socketnr)
         printf("Error creating socket\n");
         return -1;
     }
+    /* no bind error when re-opened while the old connection lingers */
+    setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
 
     if(bind(listenSocket, (struct sockaddr*) &serverAdd, sizeof(serverAdd)) == -1){
         printf("Bind error\n");
@@ -188,16 +211,47 @@ int lxScriboListenSocketInit(char *socketnr)
         return -1;
     }
 
+    return listenSocket;
+}
+
+/*
+ * wait for a connection on the listen socket
+ *  the new socket is returned, or -1 on error
+ */
+int lxScriboListenSocketAccept(int listenfd)
+{
+    int fd;
+    char clientIP [INET6_ADDRSTRLEN];
+    struct sockaddr_in clientAdd;
+    socklen_t clientAddLen;
+
     clientAddLen = sizeof(clientAdd);
-    activeSocket = accept(listenSocket, (struct sockaddr*) &clientAdd, &clientAddLen);
+    fd = accept(listenfd, (struct sockaddr*) &clientAdd, &clientAddLen);
+    if (fd < 0) {
+        printf("Accept error\n");
+        return -1;
+    }
 
-    inet_ntop(AF_INET, &clientAdd.sin_addr.s_addr, clientIP, sizeof(clientAdd));
+    inet_ntop(AF_INET, &clientAdd.sin_addr.s_addr, clientIP, sizeof(clientIP));
     printf("Received connection from %s\n", clientIP);
 
+    return fd;
+}
+
+/*
+ * the sockets are created first and then waits until a connection is done
+ * the active socket is returned
+ */
+int lxScriboListenSocketInit(char *socketnr)
+{
+    if (lxScriboListenSocketOpen(socketnr) < 0)
+        return -1;
+
+    activeSocket = lxScriboListenSocketAccept(listenSocket);
+
     close(listenSocket);
 
     return (activeSocket);
-
 }
 
 
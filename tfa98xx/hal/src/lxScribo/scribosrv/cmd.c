@@ -19,6 +19,7 @@
 #include <stdbool.h>
 #include <string.h>
 #include <unistd.h>
+#include <stdio.h>
 #include "ErrorCodes.h"
 #include "cmd.h"
 #include "i2cserver.h"
@@ -38,13 +39,17 @@
 
 #else
 #include <stdio.h>
+#include "NXP_I2C.h"
 #include "lxScribo.h"
 #define SCRIBO_VERSION_STRING "Scribo,2.0,20120515,SocketServer"
 //#define SCRIBO_VERSION_STRING "Scribo,1.71,20120209,Development board"//,Scipio,0.23,20120328,AT-Mega2561"
 
 #endif //LPCDEMO
 
-#define CMDSIZE 300
+#define CMDSIZE 1040   /* max size of a single command */
+#define CMDRING 4096   /* receive ring of a client, must be a power of 2 */
+#define CMDOUT 4096    /* replies of a client that are sent in 1 write */
+#define RESULTSIZE 1040 /* max reply of a single command */
 #define LOGERR 1
 
 /*
@@ -136,19 +141,85 @@ void cmd_stop(void *buf, int len) {
     lxScriboSocketExit(0);
 
 }
-static uint8_t cmdbuf[CMDSIZE];
-static int idx;
+/*
+ * per client parse state
+ *  the received bytes stay in the ring until the command is complete,
+ *  replies are collected and sent in 1 write when all received commands
+ *  are done
+ */
+struct cmd_client {
+    int fd;
+    int inuse;
+    unsigned int head, tail;    /* free running ring indices */
+    uint8_t ring[CMDRING];
+    int outlen;
+    uint8_t out[CMDOUT];
+    int batch;                  /* executing a batch, don't flush */
+    uint16_t batchErr;          /* 1st error in the batch */
+};
+
+static struct cmd_client clients[CMD_MAX_CLIENTS];
+static struct cmd_client *legacy; /* for CmdProcess() */
+
+/* for commands that wrap around the end of the ring */
+static uint8_t scratch[CMDRING];
 
-static uint8_t resultbuf[512];
+#define CMD(b1, b2) ((b1) | ((b2) << 8))
 
-void Cmd_Init(void)
+static unsigned int cmd_avail(struct cmd_client *c)
+{
+    return c->head - c->tail;
+}
+
+static uint8_t cmd_byte(struct cmd_client *c, unsigned int off)
+{
+    return c->ring[(c->tail + off) & (CMDRING - 1)];
+}
+
+static uint16_t cmd_word(struct cmd_client *c, unsigned int off)
+{
+    return cmd_byte(c, off) | (cmd_byte(c, off + 1) << 8);
+}
+
+/*
+ * return len contiguous bytes at off, only copied when they wrap
+ */
+static uint8_t *cmd_data(struct cmd_client *c, unsigned int off, int len)
+{
+    unsigned int start = (c->tail + off) & (CMDRING - 1);
+    int n;
+
+    if (start + len <= CMDRING)
+        return &c->ring[start];
+
+    n = CMDRING - start;
+    memcpy(scratch, &c->ring[start], n);
+    memcpy(scratch + n, c->ring, len - n);
+    return scratch;
+}
+
+static void cmd_flush(struct cmd_client *c)
 {
-    idx = 0;
+    if (c->outlen) {
+        hostWrite(c->fd, c->out, c->outlen);
+        c->outlen = 0;
+    }
 }
 
+/*
+ * the buffer for the next reply, the data goes at offset 6
+ */
+static uint8_t *ResultBuf(struct cmd_client *c)
+{
+    if (!c->batch && (CMDOUT - c->outlen) < RESULTSIZE)
+        cmd_flush(c);
+    return &c->out[c->outlen];
+}
 
-static void Result(uint16_t cmd, uint16_t err, uint16_t cnt)
+static void Result(struct cmd_client *c, uint16_t cmd, uint16_t err, uint16_t cnt)
 {
+    uint8_t *resultbuf = ResultBuf(c);
+
     resultbuf[0] = cmd >> 8;
     resultbuf[1] = cmd & 0xFF;
     resultbuf[2] = err & 0xFF;
@@ -156,42 +227,127 @@ static void Result(uint16_t cmd, uint16_t err, uint16_t cnt)
     resultbuf[4] = cnt & 0xFF;
     resultbuf[5] = cnt >> 8;
     resultbuf[6 + cnt] = 0x02;
-    hostWrite(activeSocket, resultbuf, 7 + cnt);
+    c->outlen += 7 + cnt;
+    if (c->batch && err != eNone && c->batchErr == eNone)
+        c->batchErr = err;
 }
 
+/*
+ * ascii commands get the whole input as a string
+ */
+static int cmd_ascii(struct cmd_client *c, uint16_t cmd, unsigned int off, int idx)
+{
+    char line[256];
+    int len = idx < (int)sizeof(line) ? idx : (int)sizeof(line) - 1;
 
-#define CMD(b1, b2) ((b1) | ((b2) << 8))
+    memcpy(line, cmd_data(c, off, len), len);
+    line[len] = '\0';
 
-void CmdProcess(void* buf, int len)
+    cmd_flush(c); /* keep the replies in order */
+    activeSocket = c->fd;
+
+    switch(cmd)
+    {
+    case CMD('t', 's'): // 'st' ascii command: start
+        // start 'profile' 'vstep left' 'vstep right'": st 0 3 3 ; st 0 -1 -1
+        cmd_start(line, len);
+        break;
+    case CMD('p', 'o'): // 'op' ascii command: stop
+        cmd_stop(line, len);
+        break;
+    case CMD('d', 'l'): // 'ld' ascii command: (re)load container
+        cmd_load(line, len);
+        break;
+    case CMD('x', 'e'): // 'ex' ascii command: exit
+        lxScriboSocketExit(0);
+        break;
+    case CMD('o', 'd'): // 'do' ascii command
+        {
+        char *args[]={"server", "-ddummy", "-r0"};
+        climain(3, args);
+        }
+        break;
+    }
+
+    return idx; /* all input is consumed */
+}
+
+static int cmd_run(struct cmd_client *c, unsigned int off, int len, int batch);
+
+/*
+ * execute the r, w and wr commands of a batch
+ *  the replies are put in 1 'bt' reply
+ */
+static void cmd_batch(struct cmd_client *c, unsigned int off, int len)
+{
+    uint8_t *resultbuf = ResultBuf(c);
+    int start = c->outlen;
+    uint16_t cnt;
+
+    c->outlen += 6; /* header goes here when the size is known */
+    c->batch = 1;
+    c->batchErr = eNone;
+
+    if (cmd_run(c, off, len, 1) < len && c->batchErr == eNone)
+        c->batchErr = eInvalidLength | eBadFormat; /* incomplete command */
+
+    c->batch = 0;
+    cnt = c->outlen - start - 6;
+    resultbuf[0] = CMD('b', 't') >> 8;
+    resultbuf[1] = CMD('b', 't') & 0xFF;
+    resultbuf[2] = c->batchErr & 0xFF;
+    resultbuf[3] = c->batchErr >> 8;
+    resultbuf[4] = cnt & 0xFF;
+    resultbuf[5] = cnt >> 8;
+    c->out[c->outlen++] = 0x02;
+#if LOGERR
+    if (c->batchErr != eNone)
+    {
+        rprintf("BT:%d - 0x%04X\r\n", len, c->batchErr);
+    }
+#endif
+}
+
+/*
+ * execute the complete commands in the len bytes at off
+ *  a batch only takes r, w and wr and must fit in the reply buffer
+ *  return the nr of bytes consumed
+ */
+static int cmd_run(struct cmd_client *c, unsigned int off, int len, int batch)
 {
     uint16_t cmd;
     int n;
-    int st;
     uint8_t sla;
     uint16_t err;
     uint16_t cnt;
     uint16_t cntR;
     int nR;
     int processed;
+    int st = 0;
+    int idx;
     int v;
+    uint8_t *resultbuf;
+
+#define B(i) cmd_byte(c, off + st + (i))
+#define W(i) cmd_word(c, off + st + (i))
 
-    st = 0;
-    while (st < len)
+    do
     {
-        do
+        processed = 0;
+        idx = len - st;
+        if (idx >= 2)
         {
-            processed = 0;
-            n = CMDSIZE - idx;
-            if (n > len - st)
+            cmd = CMD(B(1), B(0));
+            if (batch && (CMDOUT - c->outlen) < RESULTSIZE + 1)
             {
-                n = len - st;
+                c->batchErr = eBufferOverRun;
             }
-            memcpy(cmdbuf + idx, buf + st, len);
-            st += n;
-            idx += n;
-            if (idx >= 2)
+            else if (batch && cmd != CMD(0, 'r') && cmd != CMD(0, 'w') && cmd != CMD('w', 'r'))
+            {
+                c->batchErr = eBadCmd;
+            }
+            else
             {
-                cmd = CMD(cmdbuf[1], cmdbuf[0]);
                 switch(cmd)
                 {
                 case CMD(0, 'r'):  //I2C read
@@ -200,25 +356,26 @@ void CmdProcess(void* buf, int len)
                     {
                         err = eNone;
                         // Expect(3);
-                        sla = cmdbuf[2];
-                        cnt = cmdbuf[3] | (cmdbuf[4] << 8);
+                        sla = B(2);
+                        cnt = W(3);
                         if (sla > 127) err = eBadSlaveAddress;
                         if (sla == 0xFF) err = eBadFormat | eComErr; //Yes, the previous err might be overwritten. Intended
                         if (cnt == 0xFFFF) err = eMissingReadCount | eBadFormat;
-                        if (cmdbuf[5] != 0x02)
+                        if (B(5) != 0x02)
                         {
                             err |= eBadTerminator;
                         }
                         n = 0;
+                        resultbuf = ResultBuf(c);
                         if (err != eNone)
                         {
                             cnt = 0;
                         }
                         else
                         {
-                            if (cnt > sizeof(resultbuf) - 7)
+                            if (cnt > RESULTSIZE - 7)
                             {
-                                cnt = sizeof(resultbuf) - 7;
+                                cnt = RESULTSIZE - 7;
                                 err = eBufferOverRun;
                             }
                             if (!i2c_Read(I2CBUS, sla, resultbuf + 6, cnt, &n))
@@ -226,7 +383,7 @@ void CmdProcess(void* buf, int len)
                                 err = eI2C_SLA_NACK;
                             }
                         }
-                        Result(cmd, err, n);
+                        Result(c, cmd, err, n);
 #if LOGERR
                         if (err != eNone)
                         {
@@ -242,8 +399,8 @@ void CmdProcess(void* buf, int len)
                     if (idx >= 5)
                     {
                         err = eNone;
-                        sla = cmdbuf[2];
-                        cnt = cmdbuf[3] | (cmdbuf[4] << 8);
+                        sla = B(2);
+                        cnt = W(3);
                         if (sla > 127) err = eBadSlaveAddress;
                         if (sla == 0xFF) err = eBadFormat | eComErr; //Yes, the previous err might be overwritten. Intended
                         if (cnt == 0xFFFF) err = eMissingReadCount | eBadFormat;
@@ -259,18 +416,18 @@ void CmdProcess(void* buf, int len)
                         {
                             if (idx >= 6 + cnt)
                             {
-                                if (cmdbuf[5 + cnt] != 0x02)
+                                if (B(5 + cnt) != 0x02)
                                 {
                                     err |= eBadTerminator;
                                 }
                                 if (err == eNone)
                                 {
-                                    if (!i2c_Write(I2CBUS, sla, cmdbuf + 5, cnt))
+                                    if (!i2c_Write(I2CBUS, sla, cmd_data(c, off + st + 5, cnt), cnt))
                                     {
                                         err = eI2C_SLA_NACK;
                                     }
                                 }
-                                Result(cmd, err, 0);
+                                Result(c, cmd, err, 0);
 #if LOGERR
                                 if (err != eNone)
                                 {
@@ -288,8 +445,8 @@ void CmdProcess(void* buf, int len)
                     if (idx >= 5)
                     {
                         err = eNone;
-                        sla = cmdbuf[2];
-                        cnt = cmdbuf[3] | (cmdbuf[4] << 8);
+                        sla = B(2);
+                        cnt = W(3);
                         if (sla > 127) err = eBadSlaveAddress;
                         if (sla == 0xFF) err = eBadFormat | eComErr; //Yes, the previous err might be overwritten. Intended
                         if (cnt == 0xFFFF) err = eMissingReadCount | eBadFormat;
@@ -305,25 +462,26 @@ void CmdProcess(void* buf, int len)
                         {
                             if (idx >= 8 + cnt)
                             {
-                                if (cmdbuf[7 + cnt] != 0x02)
+                                if (B(7 + cnt) != 0x02)
                                 {
                                     err |= eBadTerminator;
                                 }
-                                cntR = cmdbuf[5 + cnt] | (cmdbuf[6 + cnt] << 8);
-                                if (cntR > sizeof(resultbuf) - 7)
+                                cntR = W(5 + cnt);
+                                if (cntR > RESULTSIZE - 7)
                                 {
-                                    cntR = sizeof(resultbuf) - 7;
+                                    cntR = RESULTSIZE - 7;
                                     err = eBufferOverRun;
                                 }
                                 nR = 0;
+                                resultbuf = ResultBuf(c);
                                 if (err == eNone)
                                 {
-                                    if (!i2c_WriteRead(I2CBUS, sla, cmdbuf + 5, cnt, &n, resultbuf + 6, cntR, &nR))
+                                    if (!i2c_WriteRead(I2CBUS, sla, cmd_data(c, off + st + 5, cnt), cnt, &n, resultbuf + 6, cntR, &nR))
                                     {
                                         err = eI2C_SLA_NACK;
                                     }
                                 }
-                                Result(cmd, err, nR);
+                                Result(c, cmd, err, nR);
 #if LOGERR
                                 if (err != eNone)
                                 {
@@ -336,17 +494,48 @@ void CmdProcess(void* buf, int len)
                     }
                     break;
 
+                case CMD('b', 't'): //batch of I2C commands
+                    //Format = 'bt'(16) + cnt(16) + 'r', 'w' and 'wr' commands(8 * cnt) + 0x02
+                    //the reply is 'bt'(16) + err(16) + cnt(16) + their replies(8 * cnt) + 0x02
+                    if (idx >= 4)
+                    {
+                        cnt = W(2);
+                        if (cnt > CMDRING - 5)
+                        {
+                            err = eBufferOverRun;
+                            Result(c, cmd, err, 0);
+#if LOGERR
+                            rprintf("BT:%d - 0x%04X\r\n", cnt, err);
+#endif
+                            processed = idx;
+                        }
+                        else if (idx >= 5 + cnt)
+                        {
+                            if (B(4 + cnt) != 0x02)
+                            {
+                                Result(c, cmd, eBadTerminator, 0);
+                            }
+                            else
+                            {
+                                cmd_batch(c, off + st + 4, cnt);
+                            }
+                            processed = 5 + cnt;
+                        }
+                    }
+                    break;
+
                 case CMD(0, 'v'):  //Version info
                     //format: 'v'(16) + 0x02
                     if (idx >= 3)
                     {
                         err = eNone;
-                        if (cmdbuf[2] != 0x02)
+                        if (B(2) != 0x02)
                         {
                             err = eBadTerminator;
                         }
+                        resultbuf = ResultBuf(c);
                         memcpy(resultbuf + 6, SCRIBO_VERSION_STRING, strlen(SCRIBO_VERSION_STRING) + 1);
-                        Result(cmd, err, strlen(SCRIBO_VERSION_STRING) + 1);
+                        Result(c, cmd, err, strlen(SCRIBO_VERSION_STRING) + 1);
 #if LOGERR
                         if (err != eNone)
                         {
@@ -363,9 +552,9 @@ void CmdProcess(void* buf, int len)
                     {
                         int speed;
                         int res;
-                        speed = cmdbuf[2] | (cmdbuf[3] << 8) | (cmdbuf[4] << 16) | (cmdbuf[5] << 24);
+                        speed = W(2) | (W(4) << 16);
                         err = eNone;
-                        if (cmdbuf[6] != 0x02)
+                        if (B(6) != 0x02)
                         {
                             err = eBadTerminator;
                         }
@@ -387,11 +576,12 @@ void CmdProcess(void* buf, int len)
                                 }
                             }
                             res = i2c_GetSpeed(I2CBUS);
+                            resultbuf = ResultBuf(c);
                             resultbuf[6] =  res         & 0xFF;
                             resultbuf[7] = (res  >>  8) & 0xFF;
                             resultbuf[8] = (res  >> 16) & 0xFF;
                             resultbuf[9] = (res  >> 24) & 0xFF;
-                            Result(cmd, err, 4);
+                            Result(c, cmd, err, 4);
 #if LOGERR
                             if (err != eNone)
                             {
@@ -408,14 +598,21 @@ void CmdProcess(void* buf, int len)
                     if (idx >= 3)
                     {
                         err = eNone;
-                        if (cmdbuf[2] != 0x02)
+                        if (B(2) != 0x02)
                         {
                             err = eBadTerminator;
                         }
 
-                        resultbuf[6] = (CMDSIZE - 16) & 0xFF;
-                        resultbuf[7] = (CMDSIZE - 16) >> 8;
-                        Result(cmd, err, 2);
+                        resultbuf = ResultBuf(c);
+                        cnt = CMDSIZE - 16;
+#ifndef LPCDEMO
+                        /* the transactions go to our own bus, it may take less */
+                        if (cnt > NXP_I2C_BufferSize())
+                            cnt = NXP_I2C_BufferSize();
+#endif
+                        resultbuf[6] = cnt & 0xFF;
+                        resultbuf[7] = cnt >> 8;
+                        Result(c, cmd, err, 2);
 #if LOGERR
                         if (err != eNone)
                         {
@@ -430,19 +627,19 @@ void CmdProcess(void* buf, int len)
                     //format = 'ps'(16) + id(8) + val(16) + 0x02
                     if (idx >= 6)
                     {
-                        if (cmdbuf[2] == 9)
+                        if (B(2) == 9)
                         {
-                            v = cmdbuf[3] + (cmdbuf[4] << 8);
+                            v = W(3);
                             if (v != 0)
                             {
                                 v = 1;
                             }
                             //gui_SetValue(ITEM_ID_STANDALONE, &v);
-                            Result(cmd, eNone, 0);
+                            Result(c, cmd, eNone, 0);
                         }
                         else
                         {
-                            Result(cmd, eInvalidPinNumber, 0);
+                            Result(c, cmd, eInvalidPinNumber, 0);
                         }
                         processed = 6;
                     }
@@ -452,23 +649,24 @@ void CmdProcess(void* buf, int len)
                     //format = 'pr'(16) + id(8) + 0x02
                     if (idx >= 4)
                     {
-                        if ((cmdbuf[2] >= 10) && (cmdbuf[2] <= 15))
+                        resultbuf = ResultBuf(c);
+                        if ((B(2) >= 10) && (B(2) <= 15))
                         {
                             resultbuf[6] = 0;
                             resultbuf[7] = 0;
-                            Result(cmd, eNone, 2);
+                            Result(c, cmd, eNone, 2);
                         }
-                        else if (cmdbuf[2] == 9)
+                        else if (B(2) == 9)
                         {
                             //if (!gui_GetValue(ITEM_ID_STANDALONE, &v))
                                 v = 1;
                             resultbuf[6] = ((v != 0) ? 1 : 0);
                             resultbuf[7] = 0;
-                            Result(cmd, eNone, 2);
+                            Result(c, cmd, eNone, 2);
                         }
                         else
                         {
-                            Result(cmd, eInvalidPinNumber, 0);
+                            Result(c, cmd, eInvalidPinNumber, 0);
                         }
                         processed = 4;
                     }
@@ -479,78 +677,149 @@ void CmdProcess(void* buf, int len)
 #if LOGERR
                     rprintf("RS - 0x%04X\r\n", eBadCmd);
 #endif
-                    Result(cmd, eBadCmd, 0);
+                    Result(c, cmd, eBadCmd, 0);
                     processed = 2;
                     break;
 
                 case CMD('t', 's'): // 'st' ascii command: start
-                    // start 'profile' 'vstep left' 'vstep right'": st 0 3 3 ; st 0 -1 -1
-                    cmd_start(buf, len);
-                    idx=0;processed=0;
-                    break;
                 case CMD('p', 'o'): // 'op' ascii command: stop
-                    cmd_stop(buf, len);
-                    idx=0;processed=0;
-                    break;
                 case CMD('d', 'l'): // 'ld' ascii command: (re)load container
-                    cmd_load(buf, len);
-                    idx=0;processed=0;
-                    break;
                 case CMD('x', 'e'): // 'ex' ascii command: exit
-                    idx=0;
-                    lxScriboSocketExit(0);
-                    break;
                 case CMD('o', 'd'): // 'do' ascii command
-                    {
-                    int c,argc=0;
-                    char *cmd=buf;
-                    char *args[]={"server", "-ddummy", "-r0"};
-                    climain(3, args);
-                  //  hostWrite(activeSocket, cmd, len );
-                    processed=0;
-//                    char **args,*arg, *srv="server";//, "-ddummy", "--dump"};
-//                    cmd[len]='\0'; //lf cr
-//                    arg=strchr(cmd,'\r');
-//                    if(arg) *arg='\0';
-//                    // skip do until
-//                    cmd+=3; //TODO search 1st non space
-//                    if(len>3)
-//                        argc=2;
-//                    for(c=0;c<len;c++) {
-//                        if (cmd[c] == ' ') {
-//                            cmd[c]='\0';
-//                            argc++;
-//                        }
-//                    }
-//                    args = malloc(argc*sizeof(arg));
-//                    args[0]=srv;
-//                    arg=cmd; //1
-//                    for(c=1;c<argc;c++) {
-//                        args[c] = arg;
-//                        arg += strlen(args[c])+1;
-//                    }
-//                    //cmd[len]='\0';
-//                    printf("cmd: %s\n", cmd);
-//                    climain(argc-1, args);
-//                    hostWrite(activeSocket, cmd, len );
-//                    processed=0;
-//                    free(*args);
-                    }
+                    processed = cmd_ascii(c, cmd, off + st, idx);
                     break;
                 default:   //Unsupported command
 #if LOGERR
-                    rprintf("%c%c: eBadCmd (%02X-%02X)\r\n", (cmd & 0xFF) == 0 ? ' ' : cmd & 0xFF, cmd >> 8, cmdbuf[1], cmdbuf[0]);
+                    rprintf("%c%c: eBadCmd (%02X-%02X)\r\n", (cmd & 0xFF) == 0 ? ' ' : cmd & 0xFF, cmd >> 8, B(1), B(0));
 #endif
-                    Result(cmd, eBadCmd, 0);
+                    Result(c, cmd, eBadCmd, 0);
                     processed = idx;
                     break;
                 }
             }
-            if ((processed != 0) & (processed < idx))
-            {
-                memmove(cmdbuf, cmdbuf + processed, idx - processed);
-            }
-            idx -= processed;
-        } while((idx > 0) && (processed > 0));
+        }
+        st += processed;
+    } while ((st < len) && (processed > 0));
+#undef B
+#undef W
+
+    return st;
+}
+
+/*
+ * execute all complete commands in the ring
+ */
+static void cmd_process(struct cmd_client *c)
+{
+    c->tail += cmd_run(c, 0, cmd_avail(c), 0);
+
+    if (cmd_avail(c) == CMDRING)
+    {
+        /* ring is full and nothing fits: drop it */
+#if LOGERR
+        rprintf("ring overrun - 0x%04X\r\n", eBufferOverRun);
+#endif
+        Result(c, CMD(cmd_byte(c, 1), cmd_byte(c, 0)), eBufferOverRun, 0);
+        c->tail = c->head;
+    }
+
+    cmd_flush(c);
+}
+
+void Cmd_Init(void)
+{
+    int i;
+
+    for (i = 0; i < CMD_MAX_CLIENTS; i++)
+        clients[i].inuse = 0;
+    legacy = NULL;
+}
+
+cmd_client_t *Cmd_Open(int fd)
+{
+    int i;
+
+    for (i = 0; i < CMD_MAX_CLIENTS; i++)
+    {
+        if (!clients[i].inuse)
+        {
+            clients[i].inuse = 1;
+            clients[i].fd = fd;
+            clients[i].head = clients[i].tail = 0;
+            clients[i].outlen = 0;
+            clients[i].batch = 0;
+            return &clients[i];
+        }
+    }
+    return NULL;
+}
+
+void Cmd_Close(cmd_client_t *c)
+{
+    if (c == legacy)
+        legacy = NULL;
+    c->inuse = 0;
+}
+
+int Cmd_Fd(cmd_client_t *c)
+{
+    return c->fd;
+}
+
+/*
+ * read what is available into the ring and process it
+ *  return the read() result, <=0 means the client is gone
+ */
+int Cmd_Read(cmd_client_t *c)
+{
+    unsigned int start = c->head & (CMDRING - 1);
+    int length, n, i;
+
+    n = CMDRING - cmd_avail(c);
+    if (n > (int)(CMDRING - start))
+        n = CMDRING - start; /* up to the end, the rest comes next time */
+
+    length = read(c->fd, &c->ring[start], n);
+    if (length <= 0)
+        return length;
+
+    if (socket_verbose) {
+        printf("recv: ");
+        for (i = 0; i < length; i++)
+            printf("0x%02x ", c->ring[start + i]);
+        printf("\n");
+    }
+
+    c->head += length;
+    cmd_process(c);
+
+    return length;
+}
+
+/*
+ * process commands that were received on activeSocket
+ */
+void CmdProcess(void* buf, int len)
+{
+    const uint8_t *data = buf;
+    int n;
+
+    if (legacy == NULL || legacy->fd != activeSocket)
+    {
+        if (legacy)
+            Cmd_Close(legacy);
+        legacy = Cmd_Open(activeSocket);
+        if (legacy == NULL)
+            return;
+    }
+
+    while (len > 0)
+    {
+        n = CMDRING - cmd_avail(legacy);
+        if (n > len)
+            n = len;
+        for (len -= n; n > 0; n--)
+            legacy->ring[legacy->head++ & (CMDRING - 1)] = *data++;
+        cmd_process(legacy);
     }
 }
@@ -250,6 +250,8 @@ int tfa98xxSetCalibrationImpedance( FIXEDPT re0, Tfa98xx_handle_t *handlesIn);
  *  the msb 0xM0000 , M is the DSP mem region
  */
 Tfa98xx_Error_t tfa98xx_DspRead( unsigned int offset, Tfa98xx_handle_t *handlesIn, int *value);
+/* read count words from offset on */
+Tfa98xx_Error_t tfa98xx_DspReadBlock( unsigned int offset, int count, Tfa98xx_handle_t *handlesIn, int *values);
 
 /*
  * save dedicated device files. Depends on the file extension
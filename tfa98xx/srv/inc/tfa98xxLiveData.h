@@ -198,19 +198,52 @@ int nxpTfa98xxGetAgcGainMaxDBfromPreset(  Tfa98xx_handle_t *handlesIn,
  */
 void dump_state_info(Tfa98xx_StateInfo_t * pState);
 
+/**
+ * speaker state sampler
+ *  a single thread gets the live data of the devices every msInterval and
+ *  publishes it in a ring, any nr of readers can follow the ring without
+ *  doing RPCs of their own
+ */
+#define NXPTFA_SAMPLER_RING 64  /* samples in the ring, a power of 2 */
+typedef struct nxpTfa98xx_LiveSample {
+        unsigned int seq;             /**  sample nr, counts all samples */
+        unsigned int tick;            /**  nr of the interval it was taken in */
+        int idx;                      /**  device index */
+        int error;                    /**  tfa_srv_api_error_t, record is only valid if Ok */
+        nxpTfa98xx_LiveData_t record;
+} nxpTfa98xx_LiveSample_t;
 
-// these functions are not yet implemented
-#if 0
 /**
- * return the structure with the required data record
- *  When Speaker Damage is detected  the error code will reflect this.
- *  @return last error code
+ * start the sampler or, if it runs already, add a user to it
+ *  a running sampler keeps its devices and interval, a user must ask
+ *  for the same ones
+ *  @return last error code, BadParam if the running sampler has other
+ *          devices or another interval
  */
-tfa_srv_api_error_t nxpTfa98xxGetLiveData(nxpTfa98xx_LiveData_t * record);
+tfa_srv_api_error_t nxpTfa98xxSamplerStart(Tfa98xx_handle_t *handlesIn, int ndev, int msInterval);
+/**
+ * remove a user, the last one stops the sampler
+ */
+void nxpTfa98xxSamplerStop(void);
+/**
+ * @return the cursor of a new reader, it will read the next sample
+ */
+unsigned int nxpTfa98xxSamplerCursor(void);
+/**
+ * copy the sample at the cursor and advance it
+ *  @return -1 if there is no new sample, else the nr of samples skipped
+ *          because the reader was too slow
+ */
+int nxpTfa98xxSamplerRead(unsigned int *cursor, nxpTfa98xx_LiveSample_t *sample);
+/**
+ * same as nxpTfa98xxSamplerRead, waits up to msTimeout for a sample
+ */
+int nxpTfa98xxSamplerWait(unsigned int *cursor, nxpTfa98xx_LiveSample_t *sample, int msTimeout);
 
 /**
  * run for the amount of specified intervals (in milliseconds) and return the recorded data.
  *   (block until ready: count*msInterval msecs)
+ *   record[idx] must hold count records for each device of nxpTfa98xxOpenLiveDataSlaves
  *   @return last error code
  */
 tfa_srv_api_error_t nxpTfa98xxLogSpeakerStateInfo(int msInterval, int count,
@@ -220,12 +253,24 @@ tfa_srv_api_error_t nxpTfa98xxLogSpeakerStateInfo(int msInterval, int count,
 /**
  * call the recordSpeakerStateInfoCallback function every msInterval with the recorded data
  *  (this will start a thread and will stop when the callback returns 0)
+ *  the records come from the sampler, for each device of nxpTfa98xxOpenLiveDataSlaves
  *  @return last error code
  */
 tfa_srv_api_error_t nxpTfa98xxSendSpeakerStateInfo(int msInterval, int
                                                    (*recordSpeakerStateInfoCallback)
                                                    (nxpTfa98xx_LiveData_t *
                                                     record));
+
+
+// these functions are not yet implemented
+#if 0
+/**
+ * return the structure with the required data record
+ *  When Speaker Damage is detected  the error code will reflect this.
+ *  @return last error code
+ */
+tfa_srv_api_error_t nxpTfa98xxGetLiveData(nxpTfa98xx_LiveData_t * record);
+
 #endif                          //0
 
 #endif                          /* TFA98XXLIFEDATA_H_ */
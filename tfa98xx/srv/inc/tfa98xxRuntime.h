@@ -70,6 +70,33 @@ Tfa98xx_Error_t tfa98xxRunWaitCalibration(Tfa98xx_handle_t handle, int *calibrat
  */
 void tfaRunVerbose(int level);
 
+/*
+ * cold start the devices concurrently in tfa98xx_start, one thread each
+ */
+void tfaRunParallelStart(int on);
+
+/*
+ * cold start the devices together in tfa98xx_start, the files they share
+ *  are uploaded once to the generic slave address
+ */
+void tfaRunBroadcastStart(int on);
+
+/*
+ * wait for the DSP RPC results on the interrupt pin given to NXP_I2C_SetIrq(),
+ *  the ACK interrupt is enabled at startup
+ */
+void tfaRunRpcIrq(int on);
+/*
+ * keep a shadow of the device registers, a read-modify-write only writes
+ *  see tfa98xx_set_shadow()
+ */
+void tfaRunShadow(int on);
+/*
+ * skip a speaker, config or preset upload when the DSP has the same content
+ *  from this process, off by default, see tfa98xx_set_param_cache()
+ */
+void tfaRunParamCache(int on);
+
 /*
  * set TimingVerbose level
  */
@@ -43,6 +43,8 @@ nxpTfa98xxParamsType_t cliParseFiletype(char *filename);
 int tfa98xx_cnt_max_device(void);
 /*
  * loads the container file
+ *  the file is mapped read only where possible, so it must not be changed
+ *  while it is loaded
  */
 int tfa98xx_cnt_loadfile(char *fname, int cnt_verbose);
 
@@ -88,6 +90,14 @@ Tfa98xx_Error_t tfaContWriteRegsProf(int device, int profile);
 Tfa98xx_Error_t tfaContWritePatch(int device);
 // write all  param files in the devicelist to the target
 Tfa98xx_Error_t tfaContWriteFiles(int device);
+/*
+ * same as tfaContWritePatch, tfaContWriteFiles and tfaContWriteFilesProf for
+ *  several devices at once: identical files are written with the multiple API
+ *  vstep[] has the volume step of each device
+ */
+Tfa98xx_Error_t tfaContWritePatchMultiple(int count, int devs[]);
+Tfa98xx_Error_t tfaContWriteFilesMultiple(int count, int devs[], int vstep[]);
+Tfa98xx_Error_t tfaContWriteFilesProfMultiple(int count, int devs[], int profile, int vstep[]);
 // write all  param files in the profilelist the target
 /**
  * Open the specified device after looking up the target address.
@@ -121,6 +131,45 @@ char  *tfaContProfileName(int idx, int ipx);
  *
  */
 Tfa98xx_Error_t tfaContWriteProfile(int device, int profile, int vstep);
+/*
+ * compiled profiles: the profile switches of the container recorded as
+ *  ready to send I2C bursts, see tfaContCompile.c for the file layout
+ */
+#define TFA_COMPILED_ID "TFAC"
+#define TFA_COMPILED_VERSION 1
+#define TFA_COMPILED_ANY_VSTEP 0xff /* the profile has no vstep file */
+enum tfaCompiledOp {
+    tfaCompiledMute = 1,    /* tfaRunMute */
+    tfaCompiledPowerdown,   /* Tfa98xx_Powerdown(1) */
+    tfaCompiledCfPowerup,   /* tfaRunCfPowerup */
+    tfaCompiledRegister,    /* u8 address, u16 value, u16 mask */
+    tfaCompiledBitfield,    /* u16 field, u16 value */
+    tfaCompiledMode,        /* u8 Tfa98xx_Mode */
+    tfaCompiledVolume,      /* u8 volume level */
+    tfaCompiledWrites,      /* u32 length, I2C writes in patch file format */
+    tfaCompiledRpc          /* wait for the DSP ack and check the RPC status */
+};
+/*
+ * switch the started devices through all profiles and vsteps and save
+ *  the I2C traffic to fname, the current profile is restored after
+ *  a switch that needs a read (other than the RPC result) or that does not
+ *  write the same as tfaContWriteProfile when replayed is not compiled
+ */
+int tfaContCompile(char *fname);
+/*
+ * load a compiled file for the loaded container, NULL unloads
+ *  return 0 if ok
+ */
+int tfaContLoadCompiled(char *fname);
+/*
+ * is the switch to profile at vstep compiled
+ */
+int tfaContHasCompiled(int device, int profile, int vstep);
+/*
+ * replay the compiled switch to profile at vstep, same result as
+ *  tfaContWriteProfile
+ */
+Tfa98xx_Error_t tfaContWriteCompiled(int device, int profile, int vstep);
 
 /* get/set current profile */
 int tfaContGetCurrentProfile(void);
@@ -163,6 +212,13 @@ Tfa98xx_Error_t tfaContWriteFile(int device,  nxpTfaFileDsc_t *file);
 char *tfaContBfName(uint16_t num);
 uint16_t tfaContBfEnum(char *name);
 Tfa98xx_Error_t tfaRunWriteBitfield(Tfa98xx_handle_t handle,  nxpTfaBitfield_t bf);//TODO move to run core
+Tfa98xx_Error_t tfaRunWriteRegister(Tfa98xx_handle_t handle, nxpTfaRegpatch_t *reg);
+nxpTfaBitfield_t tfaContDsc2Bf(nxpTfaDescPtr_t dsc);
+/*
+ * the register and bitfield items of the profilelist, merged per register
+ *  return the nr of registers in regs, -1 if there is no plan
+ */
+int tfaContGetRegPlan(int device, int profile, nxpTfaRegpatch_t **regs);
 /* */
 /*
  * show the contents of the local container
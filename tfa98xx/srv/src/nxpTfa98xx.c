@@ -501,53 +501,29 @@ Tfa98xx_Error_t tfa98xxWriteRegister( unsigned char offset, unsigned short value
 Tfa98xx_Error_t
 tfa98xx_DspRead( unsigned int offset, Tfa98xx_handle_t *handlesIn, int *value)
 {
-     Tfa98xx_handle_t handle; // TODO cleanup handle shuffle
+        return tfa98xx_DspReadBlock(offset, 1, handlesIn, value);
+}
+
+/*
+ * DSP mem block read of count words from offset on
+ *
+ *  the msb 0xM0000 , M is the DSP mem region
+ */
+Tfa98xx_Error_t
+tfa98xx_DspReadBlock( unsigned int offset, int count, Tfa98xx_handle_t *handlesIn, int *values)
+{
         Tfa98xx_Error_t error = Tfa98xx_Error_Ok;
-        unsigned short cf_ctrl; /* the value to sent to the CF_CONTROLS register */
-        unsigned char bytes[4];
         int idx=0; //TODO I2C
-        int dmem = (offset>>16) & 0xf;
-        int val = *value;
-        int nr_bytes = (dmem == Tfa98xx_DMEM_PMEM) ? 4 : 3;
-//        Tfa98xx_DMEM_PMEM=0,
-//        Tfa98xx_DMEM_XMEM=1,
-//        Tfa98xx_DMEM_YMEM=2,
-//        Tfa98xx_DMEM_IOMEM=3
+
         if( handlesIn[0] == -1) {
             error = Tfa98xx_Open(I2C(idx), &handlesIn[0] );
             assert( error==Tfa98xx_Error_Ok);
         }
 
-        handle = handlesIn[0];
-        /* first set DMEM and AIF, leaving other bits intact */
-        error = Tfa98xx_ReadRegister16(handle, TFA98XX_CF_CONTROLS, &cf_ctrl);
-        if (error != Tfa98xx_Error_Ok) {
-                return error;
-        }
-        cf_ctrl &= ~0x000E;     /* clear AIF & DMEM */
-        cf_ctrl |= (dmem << 1);    /* set DMEM, leave AIF cleared for autoincrement */
-        error = Tfa98xx_WriteRegister16(handle, TFA98XX_CF_CONTROLS, cf_ctrl);
-        if (error != Tfa98xx_Error_Ok) {
-                return error;
-        }
-
-        error = Tfa98xx_WriteRegister16(handle, TFA98XX_CF_MAD, offset & 0xffff);
-        if (error != Tfa98xx_Error_Ok) {
-                return error;
-        }
-
-        error = Tfa98xx_ReadData(handle, TFA98XX_CF_MEM, nr_bytes, bytes);
-        if (error != Tfa98xx_Error_Ok) {
+        error = Tfa98xx_DspStreamRead(handlesIn[0], (offset>>16) & 0xf,
+                        offset & 0xffff, count, values);
+        if (error != Tfa98xx_Error_Ok)
             PRINT("DSP mem read error\n");
-                return -1;
-        }
-
-        if (dmem == Tfa98xx_DMEM_PMEM) {
-            val = (bytes[0] << 24) + (bytes[1] << 16) + (bytes[2] << 8) + bytes[3];
-        } else {
-            Tfa98xx_ConvertBytes2Data(3, bytes, &val);
-        }
-        *value = val;
 
         return error;
 }
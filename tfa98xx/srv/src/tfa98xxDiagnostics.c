@@ -1190,7 +1190,6 @@ int tfa_diag_xmem_burst_write(int slave) {
     int result = 0;      // 1 is failure
     int i, ready;
     int worddata[XMEM_MAX + 4]; // test buffers
-    unsigned char bytedata[sizeof(worddata)*3];
     //unsigned short regval;
     TRACEIN;
 
@@ -1214,37 +1213,9 @@ int tfa_diag_xmem_burst_write(int slave) {
     for (i = 0; i < XMEM_MAX; i ++) {
         worddata[i]=i;
     }
-    tfa98xx_convert_data2bytes(XMEM_MAX, worddata, bytedata);
-//    lastApiError = Tfa98xx_DspWriteMemory(    handle, Tfa98xx_DMEM_XMEM, 0, XMEM_MAX,data);
-//    assert(lastApiError == Tfa98xx_Error_Ok);
-    // set mem ctl
-    lastApiError = tfa98xx_write_register16(handle, TFA98XX_CF_CONTROLS,
-             Tfa98xx_DMEM_XMEM << TFA98XX_CF_CONTROLS_DMEM_POS |  // xmem
-            /* TFA98XX_CF_CONTROLS_AIF_MSK | */TFA98XX_CF_CONTROLS_RST_MSK  );
+    //     * - one burst write, the DSP stays in reset
+    lastApiError = tfa98xx_dsp_stream_write(handle, Tfa98xx_DMEM_XMEM, 0, XMEM_MAX, worddata);
     assert(lastApiError == Tfa98xx_Error_Ok);
-    tfa98xx_write_register16(handle, TFA98XX_CF_MAD,0);
-    assert(lastApiError == Tfa98xx_Error_Ok);
-
-#define ROUND_DOWN(a,n) (((a)/(n))*(n))
-    if (lastApiError == Tfa98xx_Error_Ok) {
-        int offset = 0;
-        int chunk_size =
-            ROUND_DOWN(NXP_I2C_BufferSize(), 3);  /* XMEM word size */
-        int remaining_bytes = XMEM_MAX*3;
-
-        /* due to autoincrement in cf_ctrl, next write will happen at
-         * the next address */
-        while ((lastApiError == Tfa98xx_Error_Ok) && (remaining_bytes > 0)) {
-            if (remaining_bytes < chunk_size)
-                chunk_size = remaining_bytes;
-            /* else chunk_size remains at initialize value above */
-            lastApiError =
-                tfa98xx_write_data(handle, TFA98XX_CF_MEM,
-                          chunk_size, bytedata + offset);
-            remaining_bytes -= chunk_size;
-            offset += chunk_size;
-        }
-    }
     for (i = 0; i < XMEM_MAX; i ++) {
         worddata[i]=0xdeadbeef; // clean read buffer
     }
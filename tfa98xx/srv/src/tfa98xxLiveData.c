@@ -17,6 +17,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#if !(defined(WIN32) || defined(_X64))
+#include <time.h>
+#include <pthread.h>
+#define TFA_LIVE_THREADS
+#endif
 #include <math.h>
 #include <assert.h>
 #include <string.h>
@@ -33,6 +38,7 @@ int tfa98xxLiveData_trace = 1;
 int tfa98xxLiveData_verbose = 0;
 
 static int maxdev = 0;
+static Tfa98xx_handle_t liveHandles[4];  /* of nxpTfa98xxOpenLiveDataSlaves */
 static unsigned char tfa98xxI2cbase;    // global for i2c access
 static FILE *pFile;
 
@@ -74,6 +80,7 @@ tfa_srv_api_error_t nxpTfa98xxOpenLiveDataSlaves(Tfa98xx_handle_t *handlesIn, in
               err = Tfa98xx_Open(tfa98xxI2cSlave*2, &handlesIn[i]);
               PRINT_ASSERT( err);
            }
+           liveHandles[i] = handlesIn[i];
         }
 
         return err;
@@ -218,15 +225,286 @@ tfa_srv_api_error_t nxpTfa98xxGetDummyData(nxpTfa98xx_LiveData_t * record )
    return tfa_srv_api_error_Ok;
 }
 
+/*
+ * speaker state sampler
+ *  one thread reads the live data of the devices on a fixed time grid and
+ *  publishes it in a ring. The readers only copy from the ring, so the DSP
+ *  load is the same for one or for many of them.
+ *  Each ring slot carries the nr of the sample in it (+1, 0 while written).
+ *  A reader copies the slot and checks the tag again: if it changed the
+ *  writer lapped the reader and the sample is counted as skipped.
+ */
+#define SAMPLER_MAX_DEVS 4 /* same as the live data slaves */
+#ifdef TFA_LIVE_THREADS
+#define SAMPLER_SYNC() __sync_synchronize()
+
+struct tfaSamplerSlot {
+    volatile unsigned int tag;
+    nxpTfa98xx_LiveSample_t sample;
+};
+
+static struct {
+    pthread_mutex_t lock;       /* start/stop only, not the ring */
+    pthread_t thread;
+    int users;
+    volatile int run;
+    Tfa98xx_handle_t handles[SAMPLER_MAX_DEVS];
+    int ndev;
+    int msInterval;
+    volatile unsigned int head; /* free running, next sample */
+    struct tfaSamplerSlot ring[NXPTFA_SAMPLER_RING];
+} sampler = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static long long tfaSamplerTime(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void tfaSamplerPublish(nxpTfa98xx_LiveSample_t *sample)
+{
+    unsigned int n = sampler.head;
+    struct tfaSamplerSlot *slot = &sampler.ring[n & (NXPTFA_SAMPLER_RING-1)];
+
+    slot->tag = 0;
+    SAMPLER_SYNC();
+    sample->seq = n;
+    slot->sample = *sample;
+    SAMPLER_SYNC();
+    slot->tag = n + 1;
+    SAMPLER_SYNC();
+    sampler.head = n + 1;
+}
+
+static void *tfaSamplerThread(void *arg)
+{
+    nxpTfa98xx_LiveSample_t sample;
+    long long start, due, now, period = (long long)sampler.msInterval * 1000;
+    unsigned int tick = 0;
+    int idx;
+
+    (void)arg;
+    start = tfaSamplerTime();
+    while (sampler.run) {
+        for (idx = 0; idx < sampler.ndev; idx++) {
+            memset(&sample, 0, sizeof(sample));
+            sample.tick = tick;
+            sample.idx = idx;
+            sample.error = nxpTfa98xxGetLiveData(sampler.handles, idx, &sample.record);
+            tfaSamplerPublish(&sample);
+        }
+
+        /* next point of the grid, the time of the reads does not add up */
+        tick++;
+        due = start + tick * period;
+        now = tfaSamplerTime();
+        if (now >= due) {
+            /* too late, skip the points that were missed */
+            tick += (unsigned int)((now - due) / period) + 1;
+            due = start + tick * period;
+        }
+        /* in slices, so that a stop does not wait for a long interval */
+        while (sampler.run && (now = tfaSamplerTime()) < due)
+            tfaRun_Sleepus((int)((due - now) < 100000 ? (due - now) : 100000));
+    }
+
+    return NULL;
+}
+
+tfa_srv_api_error_t nxpTfa98xxSamplerStart(Tfa98xx_handle_t *handlesIn, int ndev, int msInterval)
+{
+    tfa_srv_api_error_t err = tfa_srv_api_error_Ok;
+    int i;
+
+    if ( ndev < 1 || ndev > SAMPLER_MAX_DEVS || msInterval < 1 )
+        return tfa_srv_api_error_BadParam;
+
+    pthread_mutex_lock(&sampler.lock);
+    if (sampler.users == 0) {
+        for (i = 0; i < ndev; i++)
+            sampler.handles[i] = handlesIn[i];
+        sampler.ndev = ndev;
+        sampler.msInterval = msInterval;
+        sampler.run = 1;
+        if (pthread_create(&sampler.thread, NULL, tfaSamplerThread, NULL)) {
+            sampler.run = 0;
+            err = tfa_srv_api_error_Fail;
+        }
+    } else if (ndev != sampler.ndev || msInterval != sampler.msInterval) {
+        err = tfa_srv_api_error_BadParam; /* it samples something else */
+    } else {
+        for (i = 0; i < ndev; i++)
+            if (handlesIn[i] != sampler.handles[i])
+                err = tfa_srv_api_error_BadParam;
+    }
+    if (err == tfa_srv_api_error_Ok)
+        sampler.users++;
+    pthread_mutex_unlock(&sampler.lock);
+
+    if (tfa98xxLiveData_verbose && err == tfa_srv_api_error_Ok)
+        PRINT("sampler: %d devices every %d ms, %d users\n",
+                sampler.ndev, sampler.msInterval, sampler.users);
+
+    return err;
+}
+
+void nxpTfa98xxSamplerStop(void)
+{
+    int join = 0;
+
+    pthread_mutex_lock(&sampler.lock);
+    if (sampler.users > 0 && --sampler.users == 0) {
+        sampler.run = 0;
+        join = 1;
+    }
+    /* join under the lock: a new start must wait for the old thread */
+    if (join)
+        pthread_join(sampler.thread, NULL);
+    pthread_mutex_unlock(&sampler.lock);
+}
+
+unsigned int nxpTfa98xxSamplerCursor(void)
+{
+    return sampler.head;
+}
+
+int nxpTfa98xxSamplerRead(unsigned int *cursor, nxpTfa98xx_LiveSample_t *sample)
+{
+    struct tfaSamplerSlot *slot;
+    unsigned int head, tag;
+    int skipped = 0;
+
+    for (;;) {
+        head = sampler.head;
+        SAMPLER_SYNC();
+        if ((int)(head - *cursor) <= 0) {
+            if (*cursor != head) /* cursor from the future */
+                *cursor = head;
+            return -1;
+        }
+        if (head - *cursor > NXPTFA_SAMPLER_RING - 1) {
+            /* overrun, the oldest slot may be in use by the writer */
+            skipped += head - *cursor - (NXPTFA_SAMPLER_RING - 1);
+            *cursor = head - (NXPTFA_SAMPLER_RING - 1);
+        }
+        slot = &sampler.ring[*cursor & (NXPTFA_SAMPLER_RING-1)];
+        tag = slot->tag;
+        SAMPLER_SYNC();
+        if (tag == *cursor + 1) {
+            *sample = slot->sample;
+            SAMPLER_SYNC();
+            if (slot->tag == tag) {
+                (*cursor)++;
+                return skipped;
+            }
+        }
+        /* overwritten while copying */
+        (*cursor)++;
+        skipped++;
+    }
+}
+
+int nxpTfa98xxSamplerWait(unsigned int *cursor, nxpTfa98xx_LiveSample_t *sample, int msTimeout)
+{
+    long long due = tfaSamplerTime() + (long long)msTimeout * 1000;
+    int skipped, slice = sampler.msInterval / 4;
+
+    if (slice < 1)
+        slice = 1;
+    while ((skipped = nxpTfa98xxSamplerRead(cursor, sample)) < 0) {
+        if (!sampler.run || tfaSamplerTime() >= due)
+            break;
+        tfaRun_Sleepus(slice * 1000);
+    }
+
+    return skipped;
+}
+
+struct tfaSamplerClient {
+    int (*callback)(nxpTfa98xx_LiveData_t *record);
+    unsigned int cursor;
+};
+
+static void *tfaSamplerClientThread(void *arg)
+{
+    struct tfaSamplerClient *client = (struct tfaSamplerClient *)arg;
+    nxpTfa98xx_LiveSample_t sample;
+
+    while (sampler.run) {
+        if (nxpTfa98xxSamplerWait(&client->cursor, &sample, 1000) < 0)
+            continue;
+        if (sample.error != tfa_srv_api_error_Ok)
+            continue;
+        if ( (*client->callback)(&sample.record) == 0 )
+            break;
+    }
+    nxpTfa98xxSamplerStop();
+    free(client);
+
+    return NULL;
+}
+#else
+tfa_srv_api_error_t nxpTfa98xxSamplerStart(Tfa98xx_handle_t *handlesIn, int ndev, int msInterval)
+{
+    return tfa_srv_api_error_Fail; /* no threads */
+}
+
+void nxpTfa98xxSamplerStop(void)
+{
+}
+
+unsigned int nxpTfa98xxSamplerCursor(void)
+{
+    return 0;
+}
+
+int nxpTfa98xxSamplerRead(unsigned int *cursor, nxpTfa98xx_LiveSample_t *sample)
+{
+    return -1;
+}
+
+int nxpTfa98xxSamplerWait(unsigned int *cursor, nxpTfa98xx_LiveSample_t *sample, int msTimeout)
+{
+    return -1;
+}
+#endif
+
 /*
  * run for the amount of specified intervals (in milliseconds) and return the recorded data.
  *   (block until ready: count*msInterval msecs)
+ *   record[idx] holds count records for each live data slave
  */
 tfa_srv_api_error_t nxpTfa98xxLogSpeakerStateInfo(int msInterval, int count,
                                                  nxpTfa98xx_LiveData_t **
                                                  record)
 {
-        return 1;
+        nxpTfa98xx_LiveSample_t sample;
+        int n[SAMPLER_MAX_DEVS] = {0};
+        int done = 0;
+        unsigned int cursor;
+        tfa_srv_api_error_t err;
+
+        err = nxpTfa98xxSamplerStart(liveHandles, maxdev, msInterval);
+        if (err != tfa_srv_api_error_Ok)
+                return err;
+
+        cursor = nxpTfa98xxSamplerCursor();
+        while (done < maxdev) {
+                if (nxpTfa98xxSamplerWait(&cursor, &sample, 2*msInterval + 1000) < 0) {
+                        err = tfa_srv_api_error_Fail; /* sampler stalled */
+                        break;
+                }
+                if (sample.error != tfa_srv_api_error_Ok || n[sample.idx] >= count)
+                        continue;
+                record[sample.idx][n[sample.idx]++] = sample.record;
+                if (n[sample.idx] == count)
+                        done++;
+        }
+        nxpTfa98xxSamplerStop();
+
+        return err;
 }
 
 /*
@@ -239,7 +517,32 @@ tfa_srv_api_error_t nxpTfa98xxSendSpeakerStateInfo(int msInterval,
                                                   (nxpTfa98xx_LiveData_t *
                                                    record))
 {
-        return 1;
+#ifdef TFA_LIVE_THREADS
+        struct tfaSamplerClient *client;
+        pthread_t thread;
+        tfa_srv_api_error_t err;
+
+        client = malloc(sizeof(*client));
+        if (client == NULL)
+                return tfa_srv_api_error_Fail;
+        err = nxpTfa98xxSamplerStart(liveHandles, maxdev, msInterval);
+        if (err != tfa_srv_api_error_Ok) {
+                free(client);
+                return err;
+        }
+        client->callback = recordSpeakerStateInfoCallback;
+        client->cursor = nxpTfa98xxSamplerCursor();
+        if (pthread_create(&thread, NULL, tfaSamplerClientThread, client)) {
+                nxpTfa98xxSamplerStop();
+                free(client);
+                return tfa_srv_api_error_Fail;
+        }
+        pthread_detach(thread);
+
+        return tfa_srv_api_error_Ok;
+#else
+        return tfa_srv_api_error_Fail;
+#endif
 }
 
 static char *stateFlagsStr(int stateFlags)
@@ -332,6 +635,7 @@ typedef enum
     tfaXmodel
 } model_t;
 #define MODELBUFSIZE (423+5) //32bits linenr + 0x55 + modeldata
+#define MAX_DEVS 1 //TODO use cmdline --speaker to specify more devs to log
 static void tfa98xxLogModel(Tfa98xx_handle_t *handlesIn, side_t idx,
             int currentLine, FILE *fp, model_t type)
 {
@@ -346,23 +650,10 @@ static void tfa98xxLogModel(Tfa98xx_handle_t *handlesIn, side_t idx,
     assert(actual==MODELBUFSIZE);
 
 }
-static int tfa98xxLogStateLine(Tfa98xx_handle_t *handlesIn, int devIdx, int currentline, unsigned char i2cAdr, char *csv)
+static void tfa98xxPrintStateLine(FILE *outfile, int currentline, unsigned char i2cAdr, nxpTfa98xx_LiveData_t *pRecord)
 {
-    Tfa98xx_Error_t err;
-    int DrcSupport;
-    nxpTfa98xx_LiveData_t record;
-    FILE *outfile;
+    nxpTfa98xx_LiveData_t record = *pRecord;
 
-    if (csv && csv[0] != '\0' && strcmp(csv,"stdout"))
-        outfile = fopen(csv, "a");
-    else
-        outfile = stdout;
-
-    err = nxpTfa98xxGetLiveData(handlesIn, devIdx, &record);
-    if (err!=Tfa98xx_Error_Ok) {
-        PRINT_ERROR("No live data! (is DSP running?)\n");
-        exit(1);
-    }
     PRINT_FILE(outfile, "%d,0x%02x,0x%04x,0x%04x,%f,%f,%f,%f,%d,%d,%f,%f,%f,%d",
             currentline,             //d
             i2cAdr,                     //d
@@ -380,12 +671,54 @@ static int tfa98xxLogStateLine(Tfa98xx_handle_t *handlesIn, int devIdx, int curr
             record.shortOnMips         //d MIPS problem detected
         );
     PRINT_FILE(outfile, "\n");
+}
+static int tfa98xxLogStateLine(Tfa98xx_handle_t *handlesIn, int devIdx, int currentline, unsigned char i2cAdr, char *csv)
+{
+    Tfa98xx_Error_t err;
+    nxpTfa98xx_LiveData_t record;
+    FILE *outfile;
+
+    if (csv && csv[0] != '\0' && strcmp(csv,"stdout"))
+        outfile = fopen(csv, "a");
+    else
+        outfile = stdout;
+
+    err = nxpTfa98xxGetLiveData(handlesIn, devIdx, &record);
+    if (err!=Tfa98xx_Error_Ok) {
+        PRINT_ERROR("No live data! (is DSP running?)\n");
+        exit(1);
+    }
+    tfa98xxPrintStateLine(outfile, currentline, i2cAdr, &record);
 
     if (csv && csv[0] != '\0' && strcmp(csv,"stdout"))
         fclose(outfile);
 
     return 0;
 }
+/*
+ * the state line of each device from the sampler
+ */
+static int tfa98xxLogSampledLines(int currentline, unsigned char i2cAdr, FILE *fp[], int interval)
+{
+    nxpTfa98xx_LiveSample_t sample;
+    static unsigned int cursor;
+    int idx, skipped;
+
+    if (currentline == 1)
+        cursor = nxpTfa98xxSamplerCursor();
+    for (idx = 0; idx < MAX_DEVS; idx++) {
+        skipped = nxpTfa98xxSamplerWait(&cursor, &sample, 2*interval*1000 + 1000);
+        if (skipped < 0 || sample.error != tfa_srv_api_error_Ok) {
+            PRINT_ERROR("No live data! (is DSP running?)\n");
+            exit(1);
+        }
+        if (skipped)
+            PRINT("line:%d, %d samples lost\n", currentline, skipped);
+        tfa98xxPrintStateLine(fp[3*sample.idx], currentline, (unsigned char)(i2cAdr+sample.idx), &sample.record);
+    }
+
+    return 0;
+}
 
 /*
  * stateinfo: 01L_0000.CSV 01R_0000.CSV
@@ -393,12 +726,12 @@ static int tfa98xxLogStateLine(Tfa98xx_handle_t *handlesIn, int devIdx, int curr
  * zmodels:      01L_ZMDL.BIN 01R_ZMDL.BIN
  */
 #define MODELLOGINTERVAL (30)
-#define MAX_DEVS 1 //TODO use cmdline --speaker to specify more devs to log
 int tfa98xxLogger( int interval, int loopcount)
 {
     Tfa98xx_handle_t handlesIn[] ={-1, -1};
     int modelinterval = interval*MODELLOGINTERVAL;
-    int currentline=1, modelcount=0, i, j;
+    int currentline=1, modelcount=0, i, j, sampled;
+    nxpTfa98xx_LiveData_t record;
 
     // logfiles
     FILE *out[2*MAX_DEVS], *fp[3*MAX_DEVS];
@@ -441,12 +774,21 @@ int tfa98xxLogger( int interval, int loopcount)
     fflush(out[1]);
     fclose(out[1]);
 
-    if (  tfa_srv_api_error_Ok == nxpTfa98xxOpenLiveDataSlaves(handlesIn, tfa98xxI2cSlave, MAX_DEVS))
+    if (  tfa_srv_api_error_Ok == nxpTfa98xxOpenLiveDataSlaves(handlesIn, tfa98xxI2cSlave, MAX_DEVS)) {
+        /* the state lines come from the sampler, it keeps the interval */
+        sampled = nxpTfa98xxSamplerStart(handlesIn, MAX_DEVS, interval*1000) == tfa_srv_api_error_Ok;
         do {
-            tfa98xxLogStateLine(handlesIn, tfaLeft, currentline, tfa98xxI2cSlave, (char *)fp[0]);// left
-#if MAX_DEVS>1
-            tfa98xxLogStateLine(handlesIn, tfaRight, currentline, fp[3]);// right
-#endif
+            if (sampled) {
+                tfa98xxLogSampledLines(currentline, tfa98xxI2cSlave, fp, interval); // left and right
+            } else {
+                for (i=0; i<MAX_DEVS; i++) {
+                    if (nxpTfa98xxGetLiveData(handlesIn, i, &record) != tfa_srv_api_error_Ok) {
+                        PRINT_ERROR("No live data! (is DSP running?)\n");
+                        exit(1);
+                    }
+                    tfa98xxPrintStateLine(fp[3*i], currentline, (unsigned char)(tfa98xxI2cSlave+i), &record);
+                }
+            }
             if (currentline > modelinterval*modelcount) {
                 //do model
                 modelcount++;
@@ -461,8 +803,12 @@ int tfa98xxLogger( int interval, int loopcount)
             } else PRINT("line:%d\n", currentline);
             currentline++;
             loopcount = ( loopcount == 0) ? 1 : loopcount-1 ;
-            tfaRun_Sleepus(interval*1000000); // is seconds interval
+            if (!sampled)
+                tfaRun_Sleepus(interval*1000000); // is seconds interval
         } while (loopcount>0) ;
+        if (sampled)
+            nxpTfa98xxSamplerStop();
+    }
 
     // close files
     for (i=0; i<3*MAX_DEVS; i++)
@@ -480,52 +826,6 @@ void tfa98xxPrintRecord(Tfa98xx_handle_t *handlesIn, int devIdx, char *csv, unsi
 
 
 typedef float fix;
-#define MIN(a,b) ((a)<(b)?(a):(b))
-static void convertData2Bytes(int num_data, const int data[],
-                              unsigned char bytes[])
-{
-        int i;                  /* index for data */
-        int k;                  /* index for bytes */
-        int d;
-
-        /* note: cannot just take the lowest 3 bytes from the 32 bit integer, because also need to take care of clipping any value > 2&23 */
-        for (i = 0, k = 0; i < num_data; ++i, k += 3) {
-                if (data[i] >= 0) {
-                        d = MIN(data[i], (1 << 23) - 1);
-                } else {
-                        d = (1 << 24) - MIN(-data[i], 1 << 23); /* 2's complement */
-                }
-                assert(d >= 0);
-                assert(d < (1 << 24));  /* max 24 bits in use */
-                bytes[k] = (d >> 16) & 0xFF;    /* MSB */
-                bytes[k + 1] = (d >> 8) & 0xFF;
-                bytes[k + 2] = (d) & 0xFF;      /* LSB */
-        }
-}
-
-/* convert DSP memory bytes to signed 24 bit integers
-   data contains "num_bytes/3" elements
-   bytes contains "num_bytes" elements */
-static void convertBytes2Data(int num_bytes, const unsigned char bytes[],
-                              int data[])
-{
-        int i;                  /* index for data */
-        int k;                  /* index for bytes */
-        int d;
-        int num_data = num_bytes / 3;
-
-        assert((num_bytes % 3) == 0);
-        for (i = 0, k = 0; i < num_data; ++i, k += 3) {
-                d = (bytes[k] << 16) | (bytes[k + 1] << 8) | (bytes[k + 2]);
-                assert(d >= 0);
-                assert(d < (1 << 24));  /* max 24 bits in use */
-                if (bytes[k] & 0x80) {  /* sign bit was set */
-                        d = -((1 << 24) - d);
-                }
-                data[i] = d;
-        }
-}
-
 /////////////////////////////////////////////////////////
 // Sorensen in-place split-radix FFT for real values
 // data: array of doubles:
@@ -734,7 +1034,7 @@ int nxpTfa98xxGetSpeakerModel(   Tfa98xx_handle_t *handlesIn,
                                PARAM_GET_LSMODEL, 423, bytes);
    assert(error == Tfa98xx_Error_Ok);
 
-   convertBytes2Data(sizeof(bytes), bytes, data);
+   Tfa98xx_ConvertBytes2Data(sizeof(bytes), bytes, data);
 
    for (i = 0; i < 128; i++)
    {
@@ -824,7 +1124,7 @@ int nxpTfa98xxSetSpeakerModel(   Tfa98xx_handle_t *handlesIn,
    data[i++] = (int)(record->tMax * (1 << (23 - 9))); /*Maximum Temperature of the speaker coil*/
    data[i++] = (int)(record->tCoefA * (1 << 23)); /*(can change) Temperature coefficient*/
 
-   convertData2Bytes(141, data, bytes);
+   Tfa98xx_ConvertData2Bytes(141, data, bytes);
 
    error = Tfa98xx_DspWriteSpeakerParameters(handlesIn[idx], TFA98XX_SPEAKERPARAMETER_LENGTH, (unsigned char*) bytes);
 
@@ -863,7 +1163,7 @@ int tfa98xxPrintSpeakerModel(Tfa98xx_handle_t *handlesIn, char *csv, int xmodel,
         if (error != Tfa98xx_Error_Ok)
             return error;
 
-        convertBytes2Data(sizeof(bytes), bytes, data);
+        Tfa98xx_ConvertBytes2Data(sizeof(bytes), bytes, data);
 
         for (i = 0; i < 128; i++) {
                 record.pFIR[i] = (double)data[i] / (1 << 22);
@@ -1030,7 +1330,7 @@ int nxpTfa98xxGetVICalfromConfig(   Tfa98xx_handle_t *handlesIn,
 
    err = Tfa98xx_DspReadConfig(handlesIn[idx], TFA98XX_CONFIG_LENGTH, bytes);
 
-   convertBytes2Data(sizeof(bytes), bytes, data);
+   Tfa98xx_ConvertBytes2Data(sizeof(bytes), bytes, data);
 
     *VIsCal = (float)data[0] / (1 << (23 - 7));
    *Vsense = (float)data[1] / (1 << (23 - 10));
@@ -1076,7 +1376,7 @@ int nxpTfa98xxGetAgcGainMaxDBfromPreset(  Tfa98xx_handle_t *handlesIn,
 
    err = Tfa98xx_DspReadPreset(handlesIn[idx], (TFA98XX_CONFIG_LENGTH+TFA98XX_PRESET_LENGTH), bytes);
 
-   convertBytes2Data(sizeof(bytes), bytes, data);
+   Tfa98xx_ConvertBytes2Data(sizeof(bytes), bytes, data);
 
     *agcGainMaxDB = (float)data[68] / (1 << (23 - 8));
 
@@ -23,6 +23,9 @@
 #else
 #include <unistd.h>
 #include <libgen.h>
+#include <stdint.h>
+#include <pthread.h>
+#define TFA_RUN_THREADS
 #endif
 #include <stdlib.h>
 #include <assert.h>
@@ -33,6 +36,7 @@
 #include "tfa98xxRuntime.h"
 #include "Tfa98xx_Registers.h"
 #include "tfaContainer.h"
+#include "tfaFieldnames.h"
 #include "tfaOsal.h"
 
 // retry values
@@ -135,6 +139,24 @@ void tfaRun_Sleepus(int us)
 
 static int nxpTfaCurrentVolstep=0;
 static int nxpTfaCurrentProfile=-1;
+static int tfa98xx_parallel_start=0;
+static int tfa98xx_broadcast_start=0;
+static int tfa98xx_rpc_irq=0;
+
+/* irq helpers, from tfa98xxDiagnostics.c */
+enum Tfa98xx_Error tfa98xx_irq_clear(Tfa98xx_handle_t handle, enum tfa_irq bit);
+enum Tfa98xx_Error tfa98xx_irq_ena(Tfa98xx_handle_t handle, enum tfa_irq bit, int state);
+int tfa98xx_irq_pol(Tfa98xx_handle_t handle, enum tfa_irq bit, int state);
+#ifdef TFA_RUN_THREADS
+/* vstep+1 of a cold start worker thread, see tfaRunColdStartParallel() */
+static pthread_key_t workerVstepKey;
+static pthread_once_t workerVstepOnce = PTHREAD_ONCE_INIT;
+
+static void workerVstepInit(void)
+{
+    pthread_key_create(&workerVstepKey, NULL);
+}
+#endif
 void TfaCurrentProfile(int level) {
     nxpTfaCurrentProfile = level;
 }
@@ -155,6 +177,16 @@ int tfa98xx_set_vstep(int level) {
     return old;
 }
 int tfa98xx_get_vstep(void) {
+#ifdef TFA_RUN_THREADS
+    if (tfa98xx_parallel_start) {
+        intptr_t worker;
+
+        pthread_once(&workerVstepOnce, workerVstepInit);
+        worker = (intptr_t)pthread_getspecific(workerVstepKey);
+        if (worker)
+            return (int)worker - 1;
+    }
+#endif
     return nxpTfaCurrentVolstep;
 }
 
@@ -300,6 +332,38 @@ Tfa98xx_Error_t tfaRunSpeakerBoost(Tfa98xx_handle_t handle, int force)
 void tfaRunVerbose(int level) {
     tfa98xx_runtime_verbose = level;
 }
+/*
+ * cold start the devices concurrently
+ */
+void tfaRunParallelStart(int on) {
+    tfa98xx_parallel_start = on;
+}
+/*
+ * cold start the devices together, with the shared uploads broadcasted
+ */
+void tfaRunBroadcastStart(int on) {
+    tfa98xx_broadcast_start = on;
+    tfa98xx_set_broadcast(on);
+}
+/*
+ * wait for the DSP RPC results on the interrupt pin
+ */
+void tfaRunRpcIrq(int on) {
+    tfa98xx_rpc_irq = on;
+    tfa98xx_set_rpc_irq(on);
+}
+/*
+ * shadow the registers of the devices opened after this
+ */
+void tfaRunShadow(int on) {
+    tfa98xx_set_shadow(on);
+}
+/*
+ * skip the parameter uploads that the DSP has already
+ */
+void tfaRunParamCache(int on) {
+    tfa98xx_set_param_cache(on);
+}
 
 /*
  * verbose enable
@@ -518,6 +582,14 @@ Tfa98xx_Error_t tfaRunStartup(Tfa98xx_handle_t handle)
     err = tfaContWriteRegsProf(handle, tfa98xx_get_profile());
     PRINT_ASSERT(err);
 
+    if (tfa98xx_rpc_irq) {
+        /* only the ACK of the DSP drives the interrupt pin */
+        tfa98xx_irq_ena(handle, tfa_irq_all, 0);
+        tfa98xx_irq_pol(handle, tfa_irq_cfma_ack, 1);
+        tfa98xx_irq_clear(handle, tfa_irq_all);
+        tfa98xx_irq_ena(handle, tfa_irq_cfma_ack, 1);
+    }
+
     /* power on the sub system */
     err = Tfa98xx_Powerdown(handle, 0);
     PRINT_ASSERT(err);
@@ -789,6 +861,9 @@ Tfa98xx_Error_t tfaRunResolveIncident(Tfa98xx_handle_t handle, int incidentlevel
     Tfa98xx_Error_t err = Tfa98xx_Error_Ok;
 
     TRACEIN
+    /* whatever went wrong, the device may not have the shadowed values */
+    if (incidentlevel)
+        tfa98xx_shadow_invalidate(handle);
     switch(incidentlevel) {//idx=0
     case 1:
         err = Tfa98xx_ResolveIncident(handle, incidentlevel);
@@ -1032,6 +1107,159 @@ void tfaRunShowParameters( nxpTfa98xxParameters_t *parms)
     }
 }
 
+#ifdef TFA_RUN_THREADS
+struct tfa_start_worker {
+    pthread_t thread;
+    int threaded;
+    int dev;
+    int vstep;
+    Tfa98xx_Error_t err;
+};
+
+static void *tfaRunColdStartWorker(void *arg)
+{
+    struct tfa_start_worker *worker = (struct tfa_start_worker *)arg;
+
+    pthread_once(&workerVstepOnce, workerVstepInit);
+    pthread_setspecific(workerVstepKey, (void *)(intptr_t)(worker->vstep + 1));
+
+    tfa98xx_lock(worker->dev);
+    if (tfa98xx_runtime_verbose)
+        PRINT("Starting device [%s] in parallel\n", tfaContDeviceName(worker->dev));
+    /* cold start up without unmute */
+    worker->err = tfaRunSpeakerBoost(worker->dev, 0);
+    tfa98xx_unlock(worker->dev);
+
+    pthread_setspecific(workerVstepKey, NULL);
+    return NULL;
+}
+
+/*
+ * cold start all cold devices at the same time, one thread each
+ *  the devices share the bus, but the waits of one device (clocks, DSP,
+ *  calibration) now overlap the uploads to the others
+ *  started[dev] is set for each device that was cold started
+ */
+static Tfa98xx_Error_t tfaRunColdStartParallel(int devcount, int *vstep, int started[])
+{
+    struct tfa_start_worker workers[TFACONT_MAXDEVS];
+    Tfa98xx_Error_t err = Tfa98xx_Error_Ok;
+    int dev, i, n = 0;
+
+    for (dev = 0; dev < devcount && dev < TFACONT_MAXDEVS; dev++) {
+        struct tfa_start_worker *worker = &workers[n];
+
+        if (!tfaRunIsCold(dev))
+            continue;
+        worker->dev = dev;
+        worker->vstep = vstep[dev];
+        worker->err = Tfa98xx_Error_Ok;
+        worker->threaded = pthread_create(&worker->thread, NULL,
+                                tfaRunColdStartWorker, worker) == 0;
+        if (!worker->threaded)
+            tfaRunColdStartWorker(worker); /* no thread: do it here */
+        n++;
+    }
+
+    for (i = 0; i < n; i++) {
+        if (workers[i].threaded)
+            pthread_join(workers[i].thread, NULL);
+        if (workers[i].err == Tfa98xx_Error_Ok)
+            started[workers[i].dev] = 1;
+        else if (err == Tfa98xx_Error_Ok)
+            err = workers[i].err;
+    }
+
+    return err;
+}
+#endif
+
+/*
+ * cold start all cold devices in lock step
+ *  this is the sequence of tfaRunSpeakerBoost() done for all devices at once
+ *  so that the patch and the files that are the same for all devices are
+ *  uploaded only once via the generic slave address
+ *  started[dev] is set for each device that was cold started
+ */
+static Tfa98xx_Error_t tfaRunColdStartBroadcast(int devcount, int *vstep, int started[])
+{
+    int devs[TFACONT_MAXDEVS], vsteps[TFACONT_MAXDEVS];
+    Tfa98xx_Error_t err = Tfa98xx_Error_Ok;
+    int dev, d, calibrateDone, n = 0;
+
+    for (dev = 0; dev < devcount && dev < TFACONT_MAXDEVS; dev++) {
+        if (!tfaRunIsCold(dev))
+            continue;
+        devs[n] = dev;
+        vsteps[n] = vstep[dev];
+        n++;
+    }
+    if (n < 2)
+        return Tfa98xx_Error_Ok; /* nothing to share, start them one by one */
+
+    for (d = 0; d < n; d++)
+        tfa98xx_lock(devs[d]);
+
+    for (d = 0; d < n && err == Tfa98xx_Error_Ok; d++) {
+        PRINT_ERROR("coldstart\n");
+        if (tfa98xx_runtime_verbose)
+            PRINT("Starting device [%s] with broadcast\n", tfaContDeviceName(devs[d]));
+        err = tfaRunStartup(devs[d]);
+        PRINT_ASSERT(err);
+    }
+    if (err)
+        goto unlock;
+
+    err = tfaContWritePatchMultiple(n, devs);
+    PRINT_ASSERT(err);
+    for (d = 0; d < n && err == Tfa98xx_Error_Ok; d++) {
+        err = tfa98xx_dsp_write_tables(devs[d]);
+        PRINT_ASSERT(err);
+    }
+    // DSP is running now
+
+    // soft mute
+    for (d = 0; d < n && err == Tfa98xx_Error_Ok; d++) {
+        err = Tfa98xx_SetMute(devs[d], Tfa98xx_Mute_Digital);
+        PRINT_ASSERT(err);
+    }
+    if (err)
+        goto unlock;
+
+    // write all the files from the device lists and from the profile lists
+    err = tfaContWriteFilesMultiple(n, devs, vsteps);
+    if (err)
+        goto unlock;
+    err = tfaContWriteFilesProfMultiple(n, devs, tfa98xx_get_profile(), vsteps);
+    PRINT_ASSERT(err);
+    if (err)
+        goto unlock;
+
+    // tell DSP it's loaded
+    for (d = 0; d < n && err == Tfa98xx_Error_Ok; d++) {
+        err = Tfa98xx_SetConfigured(devs[d]);
+        PRINT_ASSERT(err);
+    }
+    if (err)
+        goto unlock;
+
+    // await calibration, this should return ok
+    for (d = 0; d < n; d++) {
+        tfa98xxRunWaitCalibration(devs[d], &calibrateDone);
+        if (!calibrateDone) {
+            PRINT("Calibration not done!\n");
+            err = Tfa98xx_Error_StateTimedOut;
+            break;
+        }
+        started[devs[d]] = 1;
+    }
+
+unlock:
+    for (d = n-1; d >= 0; d--)
+        tfa98xx_unlock(devs[d]);
+
+    return err;
+}
 
 enum Tfa98xx_Error tfa98xx_start(int next_profile, int *vstep, int channels)
 {
@@ -1039,6 +1267,9 @@ enum Tfa98xx_Error tfa98xx_start(int next_profile, int *vstep, int channels)
     int dev, devcount = tfa98xx_cnt_max_device();
     int active_profile;
     int active_vstep;
+    int locked = -1; /* device locked for its start sequence */
+    int opened = 0; /* devices opened for the parallel or broadcast cold start */
+    int started[TFACONT_MAXDEVS] = {0}; /* cold started in parallel or broadcast */
 
     if ( devcount < 1 ) {
         PRINT_ERROR("No or wrong container file loaded\n");
@@ -1050,14 +1281,48 @@ enum Tfa98xx_Error tfa98xx_start(int next_profile, int *vstep, int channels)
      */
     active_profile = tfa98xx_set_profile(next_profile);
 
-    for( dev=0; dev < devcount; dev++) {
-        err = tfaContOpen(dev);
+    if (tfa98xx_broadcast_start && devcount > 1) {
+        for( opened=0; opened < devcount; opened++) {
+            err = tfaContOpen(opened);
+            if ( err != Tfa98xx_Error_Ok)
+                goto error_exit;
+        }
+        err = tfaRunColdStartBroadcast(devcount, vstep, started);
         if ( err != Tfa98xx_Error_Ok)
             goto error_exit;
+    }
+#ifdef TFA_RUN_THREADS
+    else if (tfa98xx_parallel_start && devcount > 1) {
+        for( opened=0; opened < devcount; opened++) {
+            err = tfaContOpen(opened);
+            if ( err != Tfa98xx_Error_Ok)
+                goto error_exit;
+        }
+        err = tfaRunColdStartParallel(devcount, vstep, started);
+        if ( err != Tfa98xx_Error_Ok)
+            goto error_exit;
+    }
+#endif
+
+    for( dev=0; dev < devcount; dev++) {
+        if ( dev >= opened ) {
+            err = tfaContOpen(dev);
+            if ( err != Tfa98xx_Error_Ok)
+                goto error_exit;
+        }
+        /* keep other threads off the device during its start sequence */
+        tfa98xx_lock(dev);
+        locked = dev;
 
         if (tfa98xx_runtime_verbose)
             PRINT("Starting device [%s]\n", tfaContDeviceName(dev));
-        if ( tfaRunIsCold(dev))
+        if ( started[dev] )
+        {
+            /* already cold started by tfaRunColdStartParallel() or tfaRunColdStartBroadcast() */
+            active_vstep = tfa98xx_set_vstep(vstep[dev]);
+            err = Tfa98xx_Error_Ok;
+        }
+        else if ( tfaRunIsCold(dev))
         {
             active_vstep = tfa98xx_set_vstep(vstep[dev]);
             /* cold start up without unmute*/
@@ -1098,16 +1363,22 @@ enum Tfa98xx_Error tfa98xx_start(int next_profile, int *vstep, int channels)
                 }
             }
         }
+        tfa98xx_unlock(dev);
+        locked = -1;
     }
     if ( err == Tfa98xx_Error_Ok)
     {
         for( dev=0; dev < devcount; dev++) {
+            tfa98xx_lock(dev);
             err = Tfa98xx_EnableAECOutput(dev);
             err = tfaRunUnmute(dev);
+            tfa98xx_unlock(dev);
         }
     }
 
 error_exit:
+    if ( locked >= 0 )
+        tfa98xx_unlock(locked);
     for( dev=0; dev < devcount; dev++)
         tfaContClose(dev); /* close all of them */
     return err;
@@ -1130,25 +1401,28 @@ enum Tfa98xx_Error tfa98xx_stop(void) {
         }
         if (tfa98xx_runtime_verbose)
             PRINT("Stopping device [%s]\n", tfaContDeviceName(dev));
+        tfa98xx_lock(dev);
         /* tfaRunSpeakerBoost (called by start) implies unmute */
         /* mute + SWS wait */
         err = tfaRunMuteAmplifier( dev );
         if ( err != Tfa98xx_Error_Ok) {
             PRINT("tfaRunMuteAmplifier [%s] failed\n", tfaContDeviceName(dev));
+            tfa98xx_unlock(dev);
             continue;
         }
         /* powerdown CF */
         err = Tfa98xx_Powerdown(dev, 1 );
         if ( err != Tfa98xx_Error_Ok) {
             PRINT("Tfa98xx_Powerdown [%s] failed\n", tfaContDeviceName(dev));
+            tfa98xx_unlock(dev);
             continue;
         }
 
         err = Tfa98xx_DisableAECOutput(dev);
         if ( err != Tfa98xx_Error_Ok) {
             PRINT("Tfa98xx_DisableAECOutput [%s] failed\n", tfaContDeviceName(dev));
-            continue;
         }
+        tfa98xx_unlock(dev);
     }
 
 error_exit:
@@ -0,0 +1,682 @@
+/*
+ *Copyright 2014 NXP Semiconductors
+ *
+ *Licensed under the Apache License, Version 2.0 (the "License");
+ *you may not use this file except in compliance with the License.
+ *You may obtain a copy of the License at
+ *
+ *http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *Unless required by applicable law or agreed to in writing, software
+ *distributed under the License is distributed on an "AS IS" BASIS,
+ *WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *See the License for the specific language governing permissions and
+ *limitations under the License.
+ */
+
+/*
+ * compiled profiles
+ *
+ *  A profile switch (tfaContWriteProfile) walks the container, parses the
+ *  parameter files and builds every RPC message again each time.
+ *  The compiler records the I2C traffic of the switch once, on a running
+ *  device, and saves it per device/profile/vstep. The executor replays the
+ *  recorded bursts and only keeps the steps that depend on the device
+ *  state (e.g. waiting for SWS or the DSP ack).
+ *  Each recorded switch is replayed once and kept only when it writes the
+ *  same as tfaContWriteProfile, the compiler runs without the register
+ *  shadow and the parameter cache.
+ *
+ *  file layout, all little endian:
+ *   header  : "TFAC", u16 version, u16 entries, u32 container CRC, u32 file size
+ *   entries : u8 device, u8 profile, u8 vstep, u8 reserved, u32 offset, u32 length
+ *   ops     : u8 opcode followed by its operands, see enum tfaCompiledOp
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "dbgprint.h"
+#include "NXP_I2C.h"
+#include "Tfa98xx.h"
+#include "Tfa98xx_genregs.h"
+#include "tfaContainer.h"
+#include "tfa98xxRuntime.h"
+#include "tfaFieldnames.h"
+
+#define TFA_COMPILED_HEADER_SIZE 16
+#define TFA_COMPILED_ENTRY_SIZE  12
+
+/* the recording of a profile switch */
+struct tfaCompileBuffer {
+    uint8_t *data;
+    int length;
+    int size;
+    int writes;     /* offset of the length of the open write op, 0 if none */
+    int rpc;        /* in an RPC result check, skip its traffic */
+    int bus;        /* the device that is compiled, the traffic of */
+    int sla;        /*  other devices is not recorded */
+    int error;      /* the traffic can't be replayed */
+};
+
+/* the loaded compiled file */
+static uint8_t *gCompiled = NULL;
+static int gCompiledLength = 0;
+
+static void put16(uint8_t *p, uint16_t value)
+{
+    p[0] = (uint8_t)(value & 0xff);
+    p[1] = (uint8_t)(value >> 8);
+}
+
+static void put32(uint8_t *p, uint32_t value)
+{
+    put16(p, (uint16_t)(value & 0xffff));
+    put16(p + 2, (uint16_t)(value >> 16));
+}
+
+static uint16_t get16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return get16(p) | ((uint32_t)get16(p + 2) << 16);
+}
+
+/*
+ * make room for n more bytes and return a pointer to them
+ */
+static uint8_t *tfaCompileGrow(struct tfaCompileBuffer *buf, int n)
+{
+    uint8_t *p;
+
+    if (buf->length + n > buf->size) {
+        int size = buf->size ? buf->size : 4096;
+
+        while (buf->length + n > size)
+            size *= 2;
+        p = realloc(buf->data, size);
+        if (p == NULL) {
+            buf->error = 1;
+            return NULL;
+        }
+        buf->data = p;
+        buf->size = size;
+    }
+    p = buf->data + buf->length;
+    buf->length += n;
+
+    return p;
+}
+
+/*
+ * append an opcode with room for its operands
+ *  this ends the open write op
+ */
+static uint8_t *tfaCompileOp(struct tfaCompileBuffer *buf, enum tfaCompiledOp op, int operands)
+{
+    uint8_t *p;
+
+    buf->writes = 0;
+    p = tfaCompileGrow(buf, 1 + operands);
+    if (p == NULL)
+        return NULL;
+    p[0] = (uint8_t)op;
+
+    return p + 1;
+}
+
+/*
+ * NXP_I2C capture function
+ *  only the traffic of the device that is compiled is recorded
+ *  writes are appended in patch file format to the open write op
+ *  a read of CF_STATUS is the DSP result wait of an RPC, that is replayed
+ *  by tfaCompiledRpc and the status readout that follows it is skipped
+ */
+static void tfaCompileCapture(void *context, int bus, unsigned char sla,
+                int num_write_bytes, const unsigned char write_data[],
+                int num_read_bytes)
+{
+    struct tfaCompileBuffer *buf = (struct tfaCompileBuffer *)context;
+    uint8_t *p;
+
+    if (bus != buf->bus || sla != buf->sla)
+        return;
+
+    if (num_read_bytes == 0) {
+        if (buf->rpc)
+            return; /* CF_CONTROLS and CF_MAD of the status readout */
+        if (buf->writes == 0) {
+            p = tfaCompileOp(buf, tfaCompiledWrites, 4);
+            if (p == NULL)
+                return;
+            put32(p, 0);
+            buf->writes = (int)(p - buf->data);
+        }
+        p = tfaCompileGrow(buf, 2 + num_write_bytes);
+        if (p == NULL)
+            return;
+        put16(p, (uint16_t)num_write_bytes);
+        memcpy(p + 2, write_data, num_write_bytes);
+        put32(buf->data + buf->writes, get32(buf->data + buf->writes) + 2 + num_write_bytes);
+    } else if (write_data[0] == TFA98XX_CF_STATUS) {
+        if (!buf->rpc)
+            tfaCompileOp(buf, tfaCompiledRpc, 0);
+        buf->rpc = 1;
+    } else if (buf->rpc && write_data[0] == TFA98XX_CF_MEM) {
+        buf->rpc = 0; /* the RPC status, end of the RPC */
+    } else {
+        /* the result of this read may change what is written next */
+        buf->error = 1;
+    }
+}
+
+/*
+ * write a parameter file and record its traffic
+ */
+static Tfa98xx_Error_t tfaCompileFile(struct tfaCompileBuffer *buf, int device, nxpTfaFileDsc_t *file)
+{
+    nxpTfaHeader_t *hdr = (nxpTfaHeader_t *)file->data;
+    nxpTfaVolumeStep2File_t *vp;
+    Tfa98xx_Error_t err;
+    int vstep;
+    unsigned short vol;
+    uint8_t *p;
+
+    /* record the whole upload, not the difference with what the DSP has */
+    tfa98xx_dsp_params_invalidate(device);
+
+    switch (hdr->id) {
+    case msgHdr:
+        /* the msg status is only printed, a replay would make it fatal */
+        buf->error = 1;
+        return Tfa98xx_Error_Ok;
+    case volstepHdr:
+        /* same as tfaContWriteVstep, the volume is an op of its own */
+        vp = (nxpTfaVolumeStep2File_t *)hdr;
+        vstep = tfa98xx_get_vstep();
+        if (vstep >= vp->vsteps)
+            return Tfa98xx_Error_Bad_Parameter;
+        vol = (unsigned short)(vp->vstep[vstep].attenuation / (-0.5f));
+        if (vol > 255)    /* restricted to 8 bits */
+            vol = 255;
+        p = tfaCompileOp(buf, tfaCompiledVolume, 1);
+        if (p)
+            p[0] = (uint8_t)vol;
+        Tfa98xx_SetVolumeLevel(device, vol);
+
+        NXP_I2C_Capture(tfaCompileCapture, buf);
+        err = Tfa98xx_DspWritePreset(device, sizeof(vp->vstep[0].preset), vp->vstep[vstep].preset);
+        if (err == Tfa98xx_Error_Ok)
+            err = tfaContWriteFilterbank(device, vp->vstep[vstep].filter);
+        NXP_I2C_Capture(NULL, NULL);
+        break;
+    default:
+        NXP_I2C_Capture(tfaCompileCapture, buf);
+        err = tfaContWriteFile(device, file);
+        NXP_I2C_Capture(NULL, NULL);
+        break;
+    }
+
+    if (buf->rpc) {
+        /* the RPC status was not read */
+        buf->rpc = 0;
+        buf->error = 1;
+    }
+    buf->writes = 0;
+
+    return err;
+}
+
+/*
+ * the profile switch of tfaContWriteProfile, recorded
+ */
+static Tfa98xx_Error_t tfaCompileProfile(struct tfaCompileBuffer *buf, int device, int profile)
+{
+    nxpTfaContainer_t *cont = tfa98xx_get_cnt();
+    nxpTfaProfileList_t *prof = tfaContProfile(device, profile);
+    nxpTfaRegpatch_t *reg;
+    nxpTfaBitfield_t bf;
+    nxpTfaFileDsc_t *file;
+    nxpTfaMode_t *cas;
+    Tfa98xx_Error_t err;
+    unsigned int i;
+    int n;
+    uint8_t *p;
+
+    if ( !prof ) {
+        return Tfa98xx_Error_Bad_Parameter;
+    }
+
+    tfaCompileOp(buf, tfaCompiledMute, 0);
+    tfaRunMute(device);
+    tfaCompileOp(buf, tfaCompiledPowerdown, 0);
+    Tfa98xx_Powerdown(device, 1);
+
+    n = tfaContGetRegPlan(device, profile, &reg);
+    for(i=0;(int)i<n;i++,reg++) {
+        p = tfaCompileOp(buf, tfaCompiledRegister, 5);
+        if (p) {
+            p[0] = reg->address;
+            put16(p + 1, reg->value);
+            put16(p + 3, reg->mask);
+        }
+        if ( tfaRunWriteRegister(device, reg) != Tfa98xx_Error_Ok )
+            return Tfa98xx_Error_Bad_Parameter;
+    }
+
+    /* no plan, item by item */
+    for(i=0;n<0 && i<prof->length;i++) {
+        if ( prof->list[i].type == dscRegister ) {
+            reg = (nxpTfaRegpatch_t *)(prof->list[i].offset+(uint8_t *)cont);
+            p = tfaCompileOp(buf, tfaCompiledRegister, 5);
+            if (p) {
+                p[0] = reg->address;
+                put16(p + 1, reg->value);
+                put16(p + 3, reg->mask);
+            }
+            err = tfaRunWriteRegister(device, reg);
+        } else if ( prof->list[i].type >= dscBitfieldBase ) {
+            bf = tfaContDsc2Bf(prof->list[i]);
+            p = tfaCompileOp(buf, tfaCompiledBitfield, 4);
+            if (p) {
+                put16(p, bf.field);
+                put16(p + 2, bf.value);
+            }
+            err = tfaRunWriteBitfield(device, bf);
+        } else {
+            continue;
+        }
+        if ( err != Tfa98xx_Error_Ok )
+            return Tfa98xx_Error_Bad_Parameter;
+    }
+
+    tfaCompileOp(buf, tfaCompiledCfPowerup, 0);
+    tfaRunCfPowerup(device);
+
+    for(i=0;i<prof->length;i++) {
+        if ( prof->list[i].type == dscFile ) {
+            file = (nxpTfaFileDsc_t *)(prof->list[i].offset+(uint8_t *)cont);
+            if ( tfaCompileFile(buf, device, file) )
+                return Tfa98xx_Error_Bad_Parameter;
+        } else if ( prof->list[i].type == dscMode ) {
+            cas = (nxpTfaMode_t *)(prof->list[i].offset+(uint8_t *)cont);
+            p = tfaCompileOp(buf, tfaCompiledMode, 1);
+            if (p)
+                p[0] = (uint8_t)cas->value;
+            tfa98xx_select_mode(device, cas->value == Tfa98xx_Mode_RCV ?
+                        Tfa98xx_Mode_RCV : Tfa98xx_Mode_Normal);
+        }
+    }
+
+    return Tfa98xx_Error_Ok;
+}
+
+/*
+ * the nr of volume steps of the profile, 0 if it has no vstep file
+ */
+static int tfaCompileVsteps(int device, int profile)
+{
+    nxpTfaContainer_t *cont = tfa98xx_get_cnt();
+    nxpTfaProfileList_t *prof = tfaContProfile(device, profile);
+    nxpTfaFileDsc_t *file;
+    unsigned int i;
+
+    for(i=0;prof && i<prof->length;i++) {
+        if ( prof->list[i].type == dscFile ) {
+            file = (nxpTfaFileDsc_t *)(prof->list[i].offset+(uint8_t *)cont);
+            if ( ((nxpTfaHeader_t *)file->data)->id == volstepHdr )
+                return ((nxpTfaVolumeStep2File_t *)file->data)->vsteps;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * replay the ops of a compiled switch
+ */
+static Tfa98xx_Error_t tfaCompiledReplay(int device, const uint8_t *p, int length)
+{
+    const uint8_t *end = p + length;
+    nxpTfaRegpatch_t reg;
+    nxpTfaBitfield_t bf;
+    Tfa98xx_Error_t err = Tfa98xx_Error_Ok;
+    int rpcStatus;
+    uint32_t size;
+
+    /* the raw RPC calls below expect the handle to be locked */
+    tfa98xx_lock(device);
+    while (p < end && err == Tfa98xx_Error_Ok) {
+        switch (*p++) {
+        case tfaCompiledMute:
+            tfaRunMute(device); // this will wait for SWS
+            break;
+        case tfaCompiledPowerdown:
+            Tfa98xx_Powerdown(device, 1);
+            break;
+        case tfaCompiledCfPowerup:
+            tfaRunCfPowerup(device);
+            break;
+        case tfaCompiledRegister:
+            reg.address = p[0];
+            reg.value = get16(p + 1);
+            reg.mask = get16(p + 3);
+            p += 5;
+            if ( tfaRunWriteRegister(device, &reg) != Tfa98xx_Error_Ok )
+                err = Tfa98xx_Error_Bad_Parameter;
+            break;
+        case tfaCompiledBitfield:
+            bf.field = get16(p);
+            bf.value = get16(p + 2);
+            p += 4;
+            if ( tfaRunWriteBitfield(device, bf) != Tfa98xx_Error_Ok )
+                err = Tfa98xx_Error_Bad_Parameter;
+            break;
+        case tfaCompiledMode:
+            tfa98xx_select_mode(device, p[0] == Tfa98xx_Mode_RCV ?
+                        Tfa98xx_Mode_RCV : Tfa98xx_Mode_Normal);
+            p += 1;
+            break;
+        case tfaCompiledVolume:
+            Tfa98xx_SetVolumeLevel(device, p[0]);
+            p += 1;
+            break;
+        case tfaCompiledWrites:
+            size = get32(p);
+            p += 4;
+            if (size > (uint32_t)(end - p)) {
+                err = Tfa98xx_Error_Bad_Parameter;
+                break;
+            }
+            err = tfa98xx_process_patch_file(device, (int)size, p);
+            p += size;
+            break;
+        case tfaCompiledRpc:
+            err = tfa98xx_wait_result(device, TFA98XX_WAITRESULT_NTRIES_LONG);
+            if (err == Tfa98xx_Error_Ok)
+                err = tfa98xx_check_rpc_status(device, &rpcStatus);
+            if (err == Tfa98xx_Error_Ok && rpcStatus != 0) /* STATUS_OK */
+                err = (Tfa98xx_Error_t)(rpcStatus + Tfa98xx_Error_RpcBase);
+            break;
+        default:
+            err = Tfa98xx_Error_Bad_Parameter;
+            break;
+        }
+    }
+    tfa98xx_unlock(device);
+
+    return err;
+}
+/*
+ * NXP_I2C capture function of tfaCompileCheck
+ *  the writes to the compiled device in patch file format, reads may differ
+ */
+static void tfaCompileCheckCapture(void *context, int bus, unsigned char sla,
+                int num_write_bytes, const unsigned char write_data[],
+                int num_read_bytes)
+{
+    struct tfaCompileBuffer *buf = (struct tfaCompileBuffer *)context;
+    uint8_t *p;
+
+    if (bus != buf->bus || sla != buf->sla || num_read_bytes)
+        return;
+    p = tfaCompileGrow(buf, 2 + num_write_bytes);
+    if (p == NULL)
+        return;
+    put16(p, (uint16_t)num_write_bytes);
+    memcpy(p + 2, write_data, num_write_bytes);
+}
+
+/*
+ * switch with the container and with the compiled ops, both must write
+ *  the same, return 0 if they do
+ */
+static int tfaCompileCheck(struct tfaCompileBuffer *buf, int device, int profile,
+                const uint8_t *ops, int length)
+{
+    struct tfaCompileBuffer ref = {0}, replay = {0};
+    Tfa98xx_Error_t err;
+    int differ;
+
+    ref.bus = replay.bus = buf->bus;
+    ref.sla = replay.sla = buf->sla;
+
+    tfa98xx_dsp_params_invalidate(device);
+    NXP_I2C_Capture(tfaCompileCheckCapture, &ref);
+    err = tfaContWriteProfile(device, profile, tfa98xx_get_vstep());
+    tfa98xx_dsp_params_invalidate(device);
+    NXP_I2C_Capture(tfaCompileCheckCapture, &replay);
+    if (err == Tfa98xx_Error_Ok)
+        err = tfaCompiledReplay(device, ops, length);
+    NXP_I2C_Capture(NULL, NULL);
+
+    differ = err != Tfa98xx_Error_Ok || ref.error || replay.error ||
+        ref.length != replay.length ||
+        (ref.length && memcmp(ref.data, replay.data, ref.length) != 0);
+    free(ref.data);
+    free(replay.data);
+
+    return differ;
+}
+
+int tfaContCompile(char *fname)
+{
+    nxpTfaContainer_t *cont = tfa98xx_get_cnt();
+    struct tfaCompileBuffer buf = {0};
+    uint8_t *entries = NULL, *p;
+    int nentries = 0, headerlength;
+    int dev, devcount = tfa98xx_cnt_max_device();
+    int profile, active_profile = tfa98xx_get_profile();
+    int vstep, vsteps, active_vstep = tfa98xx_get_vstep();
+    int start, skipped = 0, shadow, paramCache;
+    uint8_t slave;
+    Tfa98xx_Error_t err = Tfa98xx_Error_Ok;
+    FILE *f;
+
+    if ( devcount < 1 ) {
+        PRINT_ERROR("No or wrong container file loaded\n");
+        return Tfa98xx_Error_Bad_Parameter;
+    }
+    /* record the real traffic, not a replay */
+    tfaContLoadCompiled(NULL);
+    /* nor what the caches leave out, the devices are opened below */
+    shadow = tfa98xx_set_shadow(0);
+    paramCache = tfa98xx_set_param_cache(0);
+
+    for( dev=0; dev < devcount && err == Tfa98xx_Error_Ok; dev++) {
+        err = tfaContOpen(dev);
+        if ( err != Tfa98xx_Error_Ok)
+            break;
+        tfaContGetSlave(dev, &slave);
+        buf.bus = tfa98xx_get_bus(dev);
+        buf.sla = slave << 1;
+        if ( tfaRunIsCold(dev) ) {
+            PRINT_ERROR("device [%s] is not started\n", tfaContDeviceName(dev));
+            err = Tfa98xx_Error_DSP_not_running;
+        }
+        tfa98xx_lock(dev);
+        for (profile=0; err == Tfa98xx_Error_Ok && profile < tfaContMaxProfile(dev); profile++) {
+            vsteps = tfaCompileVsteps(dev, profile);
+            for (vstep=0; vstep < (vsteps ? vsteps : 1); vstep++) {
+                if (vsteps)
+                    tfa98xx_set_vstep(vstep);
+                start = buf.length;
+                buf.error = 0;
+                err = tfaCompileProfile(&buf, dev, profile);
+                if (err != Tfa98xx_Error_Ok) {
+                    PRINT_ERROR("compiling [%s] profile %s failed\n",
+                            tfaContDeviceName(dev), tfaContProfileName(dev, profile));
+                    break;
+                }
+                if (!buf.error && tfaCompileCheck(&buf, dev, profile, buf.data + start, buf.length - start)) {
+                    PRINT_ERROR("the compiled [%s] profile %s does not write the same, not compiled\n",
+                            tfaContDeviceName(dev), tfaContProfileName(dev, profile));
+                    buf.error = 1;
+                }
+                if (buf.error) {
+                    /* tfaContWriteProfile will be used for this one */
+                    buf.length = start;
+                    skipped++;
+                    continue;
+                }
+                p = realloc(entries, (nentries+1) * TFA_COMPILED_ENTRY_SIZE);
+                if (p == NULL) {
+                    err = Tfa98xx_Error_Other;
+                    break;
+                }
+                entries = p;
+                p += nentries++ * TFA_COMPILED_ENTRY_SIZE;
+                p[0] = (uint8_t)dev;
+                p[1] = (uint8_t)profile;
+                p[2] = vsteps ? (uint8_t)vstep : TFA_COMPILED_ANY_VSTEP;
+                p[3] = 0;
+                put32(p + 4, start);
+                put32(p + 8, buf.length - start);
+            }
+        }
+        /* back to where it was */
+        tfa98xx_set_vstep(active_vstep);
+        if (err == Tfa98xx_Error_Ok)
+            err = tfaContWriteProfile(dev, active_profile, active_vstep);
+        tfa98xx_unlock(dev);
+        tfaContClose(dev);
+    }
+    tfa98xx_set_shadow(shadow);
+    tfa98xx_set_param_cache(paramCache);
+
+    if (err == Tfa98xx_Error_Ok) {
+        uint8_t header[TFA_COMPILED_HEADER_SIZE];
+        int i;
+
+        headerlength = TFA_COMPILED_HEADER_SIZE + nentries * TFA_COMPILED_ENTRY_SIZE;
+        memcpy(header, TFA_COMPILED_ID, 4);
+        put16(header + 4, TFA_COMPILED_VERSION);
+        put16(header + 6, (uint16_t)nentries);
+        put32(header + 8, cont->CRC);
+        put32(header + 12, headerlength + buf.length);
+        for (i = 0; i < nentries; i++) {
+            p = entries + i * TFA_COMPILED_ENTRY_SIZE;
+            put32(p + 4, get32(p + 4) + headerlength);
+        }
+
+        f = fopen(fname, "wb");
+        if (f == NULL) {
+            PRINT_ERROR("Can't open %s\n", fname);
+            err = Tfa98xx_Error_Other;
+        } else {
+            if ( fwrite(header, sizeof(header), 1, f) != 1 ||
+                (nentries && fwrite(entries, nentries * TFA_COMPILED_ENTRY_SIZE, 1, f) != 1) ||
+                (buf.length && fwrite(buf.data, buf.length, 1, f) != 1) )
+                err = Tfa98xx_Error_Other;
+            fclose(f);
+        }
+        if (err == Tfa98xx_Error_Ok)
+            PRINT("compiled %d profile switches into %s (%d bytes), %d left to the container\n",
+                    nentries, fname, headerlength + buf.length, skipped);
+    }
+
+    free(entries);
+    free(buf.data);
+
+    return err;
+}
+
+int tfaContLoadCompiled(char *fname)
+{
+    nxpTfaContainer_t *cont = tfa98xx_get_cnt();
+    uint8_t *data = NULL, *p;
+    int length, i, nentries;
+
+    free(gCompiled);
+    gCompiled = NULL;
+    gCompiledLength = 0;
+    if (fname == NULL)
+        return 0;
+
+    if (cont == NULL) {
+        PRINT_ERROR("load the container before the compiled file\n");
+        return -1;
+    }
+    length = tfaReadFile(fname, (void **)&data);
+    if (length < TFA_COMPILED_HEADER_SIZE || data == NULL) {
+        PRINT_ERROR("Can't read %s\n", fname);
+        free(data);
+        return -1;
+    }
+    nentries = get16(data + 6);
+    if ( memcmp(data, TFA_COMPILED_ID, 4) || get16(data + 4) != TFA_COMPILED_VERSION ||
+        (int)get32(data + 12) != length ||
+        TFA_COMPILED_HEADER_SIZE + nentries * TFA_COMPILED_ENTRY_SIZE > length ) {
+        PRINT_ERROR("%s is not a compiled profile file\n", fname);
+        free(data);
+        return -1;
+    }
+    if ( get32(data + 8) != cont->CRC ) {
+        PRINT_ERROR("%s was compiled from another container\n", fname);
+        free(data);
+        return -1;
+    }
+    for (i = 0; i < nentries; i++) {
+        p = data + TFA_COMPILED_HEADER_SIZE + i * TFA_COMPILED_ENTRY_SIZE;
+        if ( get32(p + 4) > (uint32_t)length || get32(p + 8) > length - get32(p + 4) ) {
+            PRINT_ERROR("%s is corrupt\n", fname);
+            free(data);
+            return -1;
+        }
+    }
+
+    gCompiled = data;
+    gCompiledLength = length;
+
+    return 0;
+}
+
+/*
+ * lookup the ops, return NULL if not compiled
+ */
+static const uint8_t *tfaCompiledFind(int device, int profile, int vstep, int *length)
+{
+    const uint8_t *p;
+    int i, nentries;
+
+    if (gCompiled == NULL)
+        return NULL;
+
+    nentries = get16(gCompiled + 6);
+    for (i = 0; i < nentries; i++) {
+        p = gCompiled + TFA_COMPILED_HEADER_SIZE + i * TFA_COMPILED_ENTRY_SIZE;
+        if ( p[0] == device && p[1] == profile &&
+            (p[2] == TFA_COMPILED_ANY_VSTEP || p[2] == vstep) ) {
+            *length = (int)get32(p + 8);
+            return gCompiled + get32(p + 4);
+        }
+    }
+
+    return NULL;
+}
+
+int tfaContHasCompiled(int device, int profile, int vstep)
+{
+    int length;
+
+    return tfaCompiledFind(device, profile, vstep, &length) != NULL;
+}
+
+Tfa98xx_Error_t tfaContWriteCompiled(int device, int profile, int vstep)
+{
+    const uint8_t *p;
+    int length;
+
+    p = tfaCompiledFind(device, profile, vstep, &length);
+    if (p == NULL)
+        return Tfa98xx_Error_Bad_Parameter;
+
+    if ( tfa98xx_cnt_verbose )
+        PRINT("compiled profile %s [%s], %d bytes\n",
+                tfaContProfileName(device, profile), tfaContDeviceName(device), length);
+
+    return tfaCompiledReplay(device, p, length);
+}
@@ -27,9 +27,16 @@
 #if !defined(__REDLIB__)
 #include <sys/stat.h>
 #endif
+#if !(defined(WIN32) || defined(_X64) || defined(__REDLIB__))
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define TFA_CONT_MMAP
+#endif
 #include <math.h> //TODO move to tfa api
 #include "dbgprint.h"
 #include "tfaFieldnames.h"
+#include "Tfa98xx_genregs.h"
 #include "tfaContainer.h"
 #include "tfa98xxRuntime.h"
 #include "nxpTfa98xx.h" /* error codes */
@@ -37,6 +44,7 @@
 
 /* module globals */
 static nxpTfaContainer_t *gCont=NULL; /* container file */
+static int gContMapped=0; /* size of the mapping if gCont is mapped, else it is malloced */
 static int gDevs=-1; // nr of devices
 static nxpTfaDeviceList_t *gDev[TFACONT_MAXDEVS];
 static int gProfs[TFACONT_MAXDEVS];
@@ -221,6 +229,7 @@ nxpTfaFileDsc_t *tfacont_getfiledata(int devIdx, int profIdx, enum nxpTfaHeaderT
  * static functions
  */
 static int tfaContLoadContainer(char *fname);
+static void tfaContPlanAll(void);
 /*
  * fill globals
  */
@@ -245,6 +254,8 @@ static void contGetDevs(nxpTfaContainer_t *cont) {
         }
         gProfs[i] = count;    // count the nr of profiles per device
     }
+
+    tfaContPlanAll();
 }
 
 static int fsize(const char *name) //TODO no file IO allowed in here , this needs to go to osal
@@ -260,23 +271,27 @@ static int fsize(const char *name) //TODO no file IO allowed in here , this need
 
 static char nostring[]="Undefined string";
 
+/*
+ * write the 10 biquads of the filterbank
+ *  only the biquads that changed since the last filterbank are sent, in one message
+ */
 Tfa98xx_Error_t tfaContWriteFilterbank(int device, nxpTfaFilter_t *filter) {
+    unsigned char bank[TFA98XX_MAX_EQ*sizeof(filter[0].biquad.bytes)];
+    unsigned char *bytes;
     unsigned char biquad_index;
-    Tfa98xx_Error_t error = Tfa98xx_Error_Ok;
 
-    for(biquad_index=0;biquad_index<10;biquad_index++) {
+    for(biquad_index=0;biquad_index<TFA98XX_MAX_EQ;biquad_index++) {
+        bytes = bank + biquad_index*sizeof(filter[0].biquad.bytes);
         if (filter[biquad_index].enabled ) {
-            error = Tfa98xx_DspSetParam(device, MODULE_BIQUADFILTERBANK,
-                    biquad_index+1, //start @1
-                    sizeof(filter[biquad_index].biquad.bytes),
-                        filter[biquad_index].biquad.bytes);
+            memcpy(bytes, filter[biquad_index].biquad.bytes, sizeof(filter[0].biquad.bytes));
         } else {
-            error = Tfa98xx_DspBiquad_Disable(device, biquad_index+1);
+            /* same as Tfa98xx_DspBiquad_Disable: b0=-1.0, the rest 0 */
+            memset(bytes, 0, sizeof(filter[0].biquad.bytes));
+            bytes[0] = 0x80;
         }
-        if (error) return error;
-
     }
-    return error;
+
+    return tfa98xx_dsp_biquad_set_bank(device, bank);
 }
 //TODO add to API
 #define MODULE_BIQUADFILTERBANK 2
@@ -524,8 +539,12 @@ Tfa98xx_Error_t tfaRunWriteRegister(Tfa98xx_handle_t handle, nxpTfaRegpatch_t *r
     if ( tfa98xx_cnt_verbose )
         PRINT("register: 0x%02x=0x%04x (msk=0x%04x)\n", reg->address, reg->value, reg->mask);
 
-    error = Tfa98xx_ReadRegister16(handle, reg->address, &value);
-    if (error) return error;
+    if (reg->mask == 0xffff) {
+        value = 0; /* all bits are written, no need to read */
+    } else {
+        error = Tfa98xx_ReadRegister16(handle, reg->address, &value);
+        if (error) return error;
+    }
 
     value &= ~reg->mask;
     newvalue = reg->value & reg->mask;
@@ -550,6 +569,166 @@ nxpTfaBitfield_t tfaContDsc2Bf(nxpTfaDescPtr_t dsc) {
 
     return num_bf.bf;
 }
+
+/*
+ * register plans
+ *  The register and bitfield items of a list are merged per register when the
+ *  container is loaded, so that a register is written once with the combined
+ *  value and mask instead of a read-modify-write for every item.
+ *  The writes to registers with side effects (power, reset, keys, interrupt
+ *  clear, CoolFlux access) are kept in the order of the list; the registers in
+ *  between are written in address order.
+ */
+struct tfaContRegPlan {
+    int count;
+    nxpTfaRegpatch_t *regs;
+};
+static struct tfaContRegPlan gDevPlan[TFACONT_MAXDEVS];   /* devicelist up to the first file */
+static struct tfaContRegPlan gProfPlan[TFACONT_MAXDEVS][TFACONT_MAXPROFS]; /* idem, profilelist */
+static struct tfaContRegPlan gProfRegs[TFACONT_MAXDEVS][TFACONT_MAXPROFS]; /* all of the profilelist */
+
+/* the volatile registers and SYS_CTRL (power, reset) */
+static int tfaContOrderedReg(uint8_t address)
+{
+    return address == TFA98XX_SYS_CTRL || tfa98xx_reg_volatile(address);
+}
+
+/* sort regs[from..count-1] on address, there are only a few */
+static void tfaContPlanSort(struct tfaContRegPlan *plan, int from)
+{
+    nxpTfaRegpatch_t tmp;
+    int i, j;
+
+    for (i = from + 1; i < plan->count; i++) {
+        tmp = plan->regs[i];
+        for (j = i; j > from && plan->regs[j-1].address > tmp.address; j--)
+            plan->regs[j] = plan->regs[j-1];
+        plan->regs[j] = tmp;
+    }
+}
+
+/*
+ * merge the register and bitfield items of a list into plan
+ *  if all is 0 the list is processed until a patch, file or profile
+ */
+static void tfaContPlanList(struct tfaContRegPlan *plan, nxpTfaDescPtr_t *list, int length, int all)
+{
+    nxpTfaRegpatch_t *reg;
+    union {
+        uint16_t field;
+        nxpTfaBfEnum_t Enum;
+    } bfUni;
+    nxpTfaBitfield_t bf;
+    uint8_t address;
+    uint16_t msk, value;
+    int i, j, from = 0;
+
+    plan->count = 0;
+    if (length <= 0)
+        return;
+    plan->regs = malloc(length * sizeof(nxpTfaRegpatch_t));
+    if (plan->regs == NULL) {
+        plan->count = -1; /* no plan, the items are written one by one */
+        return;
+    }
+
+    for (i = 0; i < length; i++) {
+        if ( !all && ( list[i].type == dscPatch ||
+              list[i].type == dscFile ||
+              list[i].type == dscProfile ) ) break;
+
+        if ( list[i].type == dscRegister ) {
+            reg = (nxpTfaRegpatch_t *)(list[i].offset+(uint8_t *)gCont);
+            address = reg->address;
+            msk = reg->mask;
+            value = reg->value & reg->mask;
+        } else if ( list[i].type & dscBitfieldBase ) {
+            bf = tfaContDsc2Bf(list[i]);
+            bfUni.field = bf.field;
+            address = (uint8_t)bfUni.Enum.address;
+            /* same as tfaRunWriteBitfield, value is not clipped to the field */
+            value = (uint16_t)(bf.value << bfUni.Enum.pos);
+            msk = (uint16_t)((((1<<(bfUni.Enum.len+1))-1)<<bfUni.Enum.pos) | value);
+        } else {
+            continue;
+        }
+
+        if ( tfaContOrderedReg(address) ) {
+            /* the registers so far go first, nothing merges with this one */
+            tfaContPlanSort(plan, from);
+            j = plan->count;
+            from = j + 1;
+        } else {
+            for (j = from; j < plan->count; j++)
+                if (plan->regs[j].address == address)
+                    break;
+        }
+        if (j == plan->count) {
+            plan->count++;
+            plan->regs[j].address = address;
+            plan->regs[j].value = 0;
+            plan->regs[j].mask = 0;
+        }
+        plan->regs[j].value = (plan->regs[j].value & ~msk) | value;
+        plan->regs[j].mask |= msk;
+    }
+    tfaContPlanSort(plan, from);
+}
+
+static void tfaContPlanFree(struct tfaContRegPlan *plan)
+{
+    free(plan->regs);
+    plan->regs = NULL;
+    plan->count = 0;
+}
+
+/*
+ * make the plans of all lists of the container
+ */
+static void tfaContPlanAll(void)
+{
+    int dev, prof;
+
+    for (dev = 0; dev < TFACONT_MAXDEVS; dev++) {
+        tfaContPlanFree(&gDevPlan[dev]);
+        for (prof = 0; prof < TFACONT_MAXPROFS; prof++) {
+            tfaContPlanFree(&gProfPlan[dev][prof]);
+            tfaContPlanFree(&gProfRegs[dev][prof]);
+        }
+    }
+
+    for (dev = 0; dev < gDevs; dev++) {
+        tfaContPlanList(&gDevPlan[dev], gDev[dev]->list, gDev[dev]->length, 0);
+        for (prof = 0; prof < gProfs[dev]; prof++) {
+            tfaContPlanList(&gProfPlan[dev][prof], gProf[dev][prof]->list, gProf[dev][prof]->length, 0);
+            tfaContPlanList(&gProfRegs[dev][prof], gProf[dev][prof]->list, gProf[dev][prof]->length, 1);
+        }
+    }
+}
+
+static Tfa98xx_Error_t tfaContWritePlan(int device, struct tfaContRegPlan *plan)
+{
+    Tfa98xx_Error_t err = Tfa98xx_Error_Ok;
+    int i;
+
+    for (i = 0; i < plan->count && err == Tfa98xx_Error_Ok; i++) {
+        if ( plan->regs[i].address & 0x80 )
+            PRINT("WARNING:not a persistant write of MTP\n");
+        err = tfaRunWriteRegister(device, &plan->regs[i]);
+    }
+
+    return err;
+}
+
+int tfaContGetRegPlan(int device, int profile, nxpTfaRegpatch_t **regs)
+{
+    if ( device < 0 || device >= gDevs || profile < 0 || profile >= gProfs[device] )
+        return -1;
+    *regs = gProfRegs[device][profile].regs;
+
+    return gProfRegs[device][profile].count;
+}
+
 // write  reg  and bitfield items in the devicelist to the target
 Tfa98xx_Error_t tfaContWriteRegsDev(int device) {
     nxpTfaDeviceList_t *dev = tfaContDevice (device);
@@ -559,6 +738,8 @@ Tfa98xx_Error_t tfaContWriteRegsDev(int device) {
     if ( !dev ) {
         return Tfa98xx_Error_Bad_Parameter;
     }
+    if ( gDevPlan[device].count >= 0 )
+        return tfaContWritePlan(device, &gDevPlan[device]);
 
     /* process the list until a patch, file of profile is encountered */
     for(i=0;i<dev->length;i++) {
@@ -585,6 +766,9 @@ Tfa98xx_Error_t tfaContWriteRegsProf(int device, int profile) {
     if ( !prof ) {
         return Tfa98xx_Error_Bad_Parameter;
     }
+    if ( gProfPlan[device][profile].count >= 0 )
+        return tfaContWritePlan(device, &gProfPlan[device][profile]);
+
     /* process the list until a patch, file of profile is encountered */
     for(i=0;i<prof->length;i++) {
         if ( prof->list[i].type == dscPatch ||
@@ -594,8 +778,8 @@ Tfa98xx_Error_t tfaContWriteRegsProf(int device, int profile) {
         if  ( prof->list[i].type & dscBitfieldBase) {
             err = tfaRunWriteBitfield( device , tfaContDsc2Bf(prof->list[i])); /*  */
         }
-        if  ( !prof->list[i].type == dscRegister ) {
-            err = tfaRunWriteRegister( device, (nxpTfaRegpatch_t *)( !prof->list[i].offset+gCont));
+        if  ( prof->list[i].type == dscRegister ) {
+            err = tfaRunWriteRegister( device, (nxpTfaRegpatch_t *)( prof->list[i].offset+(char*)gCont));
         }
         if ( err ) break;
     }
@@ -685,6 +869,188 @@ Tfa98xx_Error_t tfaContWriteFilesProf(int device, int profile, int vstep) {
     return Tfa98xx_Error_Ok;
 }
 
+/*
+ * writing the same files to several devices at once
+ *  a file that is byte identical for a group of devices, at the same position
+ *  in their lists, is written with the multiple API which can broadcast it
+ *  all the others are written to each device on its own
+ */
+static int tfaContSameFile(nxpTfaFileDsc_t *a, nxpTfaFileDsc_t *b)
+{
+    return a == b || (a->size == b->size && memcmp(a->data, b->data, a->size) == 0);
+}
+
+/*
+ * write a file to a group of devices, return -1 if the type
+ *  has no multiple API
+ */
+static Tfa98xx_Error_t tfaContWriteFileMultiple(int count, int devs[], nxpTfaFileDsc_t *file)
+{
+    nxpTfaHeader_t *hdr = (nxpTfaHeader_t *)file->data;
+    int size;
+
+    switch ((nxpTfaHeaderType_t) hdr->id) {
+    case speakerHdr:
+        size = hdr->size - sizeof(nxpTfaSpeakerFile_t);
+        return Tfa98xx_DspWriteSpeakerParametersMultiple(count, devs, size,
+                            (const unsigned char *)((nxpTfaSpeakerFile_t *)hdr)->data);
+    case presetHdr:
+        size = hdr->size - sizeof(nxpTfaPreset_t);
+        return Tfa98xx_DspWritePresetMultiple(count, devs, size,
+                            (const unsigned char *)((nxpTfaPreset_t *)hdr)->data);
+    case configHdr:
+        size = hdr->size - sizeof(nxpTfaConfig_t);
+        return Tfa98xx_DspWriteConfigMultiple(count, devs, size,
+                            (const unsigned char *)((nxpTfaConfig_t *)hdr)->data);
+    case patchHdr:
+        size = hdr->size - sizeof(nxpTfaPatch_t);
+        return Tfa98xx_DspPatchMultiple(count, devs, size,
+                            (const unsigned char *)((nxpTfaPatch_t *)hdr)->data);
+    default:
+        return -1;
+    }
+}
+
+/*
+ * write the items of the given type in the lists of all devices
+ *  vstep[] is the volume step of each device for the volume step files
+ */
+static Tfa98xx_Error_t tfaContWriteListsMultiple(int count, int devs[],
+        nxpTfaDescPtr_t *lists[], int lengths[], nxpTfaDescriptorType_t type, int vstep[])
+{
+    nxpTfaFileDsc_t *files[TFACONT_MAXDEVS], *first;
+    int group[TFACONT_MAXDEVS];
+    Tfa98xx_Error_t err = Tfa98xx_Error_Ok;
+    int i, d, n, maxlength = 0;
+
+    for (d = 0; d < count; d++)
+        if (lengths[d] > maxlength)
+            maxlength = lengths[d];
+
+    for (i = 0; i < maxlength && err == Tfa98xx_Error_Ok; i++) {
+        first = NULL;
+        n = 0;
+        for (d = 0; d < count; d++) {
+            files[d] = NULL;
+            if (i < lengths[d] && lists[d][i].type == type)
+                files[d] = (nxpTfaFileDsc_t *)(lists[d][i].offset+(uint8_t *)gCont);
+            if (files[d] == NULL)
+                continue;
+            if (first == NULL)
+                first = files[d];
+            if (tfaContSameFile(first, files[d]))
+                group[n++] = devs[d];
+        }
+
+        if (n > 1) {
+            err = tfaContWriteFileMultiple(n, group, first);
+            if (err == (Tfa98xx_Error_t)-1) {
+                err = Tfa98xx_Error_Ok; /* do them one by one */
+            } else {
+                for (d = 0; d < count; d++)
+                    if (files[d] && tfaContSameFile(first, files[d]))
+                        files[d] = NULL; /* done */
+            }
+        }
+
+        for (d = 0; d < count && err == Tfa98xx_Error_Ok; d++) {
+            if (files[d] == NULL)
+                continue;
+            if (vstep)
+                tfa98xx_set_vstep(vstep[d]);
+            if ( tfaContWriteFile(devs[d], files[d]) )
+                err = Tfa98xx_Error_Bad_Parameter;
+        }
+    }
+
+    return err;
+}
+
+Tfa98xx_Error_t tfaContWritePatchMultiple(int count, int devs[]) {
+    nxpTfaPatch_t *patches[TFACONT_MAXDEVS];
+    int group[TFACONT_MAXDEVS];
+    Tfa98xx_Error_t err = Tfa98xx_Error_Ok;
+    int d, i, n, size;
+
+    if ( count > TFACONT_MAXDEVS )
+        return Tfa98xx_Error_Bad_Parameter;
+
+    /* the first patch in each devicelist */
+    for (d = 0; d < count; d++) {
+        nxpTfaDeviceList_t *dev = tfaContDevice(devs[d]);
+
+        if ( !dev )
+            return Tfa98xx_Error_Bad_Parameter;
+        patches[d] = NULL;
+        for(i=0;i<dev->length;i++) {
+            if ( dev->list[i].type == dscPatch ) {
+                nxpTfaFileDsc_t *file = (nxpTfaFileDsc_t *)(dev->list[i].offset+(uint8_t *)gCont);
+                patches[d] = (nxpTfaPatch_t *)&file->data;
+                break;
+            }
+        }
+        if ( !patches[d] )
+            return Tfa98xx_Error_Bad_Parameter; // patch not in the list
+    }
+
+    /* one upload for each distinct patch */
+    for (d = 0; d < count && err == Tfa98xx_Error_Ok; d++) {
+        nxpTfaPatch_t *patchfile = patches[d];
+
+        if ( !patchfile )
+            continue; /* done */
+        if ( tfa98xx_cnt_verbose ) tfaContShowFile(&patchfile->hdr);
+        size = patchfile->hdr.size - sizeof(nxpTfaPatch_t ); // size is total length
+        n = 0;
+        for (i = d; i < count; i++) {
+            if ( patches[i] == patchfile || (patches[i] &&
+                    patches[i]->hdr.size == patchfile->hdr.size &&
+                    memcmp(patches[i], patchfile, patchfile->hdr.size) == 0) ) {
+                group[n++] = devs[i];
+                patches[i] = NULL;
+            }
+        }
+        if ( n > 1 )
+            err = Tfa98xx_DspPatchMultiple(n, group, size, (const unsigned char *) patchfile->data);
+        else
+            err = Tfa98xx_DspPatch(group[0], size, (const unsigned char *) patchfile->data);
+    }
+
+    return err;
+}
+
+Tfa98xx_Error_t tfaContWriteFilesMultiple(int count, int devs[], int vstep[]) {
+    nxpTfaDescPtr_t *lists[TFACONT_MAXDEVS];
+    int lengths[TFACONT_MAXDEVS];
+    int d;
+
+    for (d = 0; d < count && d < TFACONT_MAXDEVS; d++) {
+        nxpTfaDeviceList_t *dev = tfaContDevice(devs[d]);
+        if ( !dev )
+            return Tfa98xx_Error_Bad_Parameter;
+        lists[d] = dev->list;
+        lengths[d] = dev->length;
+    }
+
+    return tfaContWriteListsMultiple(d, devs, lists, lengths, dscFile, vstep);
+}
+
+Tfa98xx_Error_t tfaContWriteFilesProfMultiple(int count, int devs[], int profile, int vstep[]) {
+    nxpTfaDescPtr_t *lists[TFACONT_MAXDEVS];
+    int lengths[TFACONT_MAXDEVS];
+    int d;
+
+    for (d = 0; d < count && d < TFACONT_MAXDEVS; d++) {
+        nxpTfaProfileList_t *prof = tfaContProfile(devs[d], profile);
+        if ( !prof )
+            return Tfa98xx_Error_Bad_Parameter;
+        lists[d] = prof->list;
+        lengths[d] = prof->length;
+    }
+
+    return tfaContWriteListsMultiple(d, devs, lists, lengths, dscFile, vstep);
+}
+
 Tfa98xx_Error_t  tfaContWriteItem(int device, nxpTfaDescPtr_t * dsc) {
     nxpTfaFileDsc_t *file;
     nxpTfaRegpatch_t *reg;
@@ -739,11 +1105,17 @@ Tfa98xx_Error_t tfaContWriteProfile(int device, int profile, int vstep)
         return Tfa98xx_Error_Bad_Parameter;
     }
 
+    if ( tfaContHasCompiled(device, profile, vstep) )
+        return tfaContWriteCompiled(device, profile, vstep);
+
     tfaRunMute(device); // this will wait for SWS
     Tfa98xx_Powerdown(device, 1);
 
     /*  process and write all non-file items (e.g. registers) first */
-    for(i=0;i<prof->length;i++) {
+    if ( tfaContWritePlan(device, &gProfRegs[device][profile]) != Tfa98xx_Error_Ok )
+        return Tfa98xx_Error_Bad_Parameter;
+    /* no plan, item by item */
+    for(i=0;gProfRegs[device][profile].count<0 && i<prof->length;i++) {
         if ( ( prof->list[i].type == dscRegister ) ||
             ( prof->list[i].type >= dscBitfieldBase ) )
         {
@@ -1202,7 +1574,8 @@ enum Tfa98xx_Error tfaContOpen(int device) {
         return err;
 
     for(i=0;i<Tfa98xx_MaxDevices();i++) {
-        err = Tfa98xx_Open( slave<<1, &handle );
+        /* the device list tells on which bus the device is */
+        err = Tfa98xx_OpenBus( tfaContDevice(device)->bus, slave<<1, &handle );
         if ( err != Tfa98xx_Error_Ok )
             return err;
         if ( handle==device)
@@ -1471,27 +1844,89 @@ stop:
     if(NULL != f) fclose(f);
     return size;
 }
+/*
+ * map a file copy-on-write
+ *  the pages are shared with all other users of the file, so several
+ *  processes with the same container have one copy in the page cache
+ *  a page that is written, e.g. a header size fixed by tfa98xx_header_check(),
+ *  becomes private and the file is not changed
+ *  the file must not be truncated while it is mapped
+ * return size or 0 on failure, then the file is read in with tfaReadFile()
+ */
+static int tfaMapFile(char *fname, void **buffer) {
+#ifdef TFA_CONT_MMAP
+    struct stat st;
+    void *map;
+    int fd;
+
+    fd = open(fname, O_RDONLY);
+    if ( fd < 0 )
+        return 0;
+    if ( fstat(fd, &st) || st.st_size < (off_t)sizeof(nxpTfaHeader_t) ) {
+        close(fd);
+        return 0;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd); /* the mapping stays */
+    if ( map == MAP_FAILED )
+        return 0;
+    *buffer = map;
+
+    return (int)st.st_size;
+#else
+    return 0;
+#endif
+}
+
+/*
+ * release a buffer of tfaMapFile() or tfaReadFile()
+ */
+static void tfaUnmapFile(void *buffer, int mapped) {
+#ifdef TFA_CONT_MMAP
+    if ( mapped ) {
+        munmap(buffer, mapped);
+        return;
+    }
+#endif
+    free(buffer);
+}
+
 /*
  *   load the file depending on its type
  *   normally the container will be loaded
  *   any other valid type will by send to the target device(s)
  */
 int tfa98xx_cnt_loadfile(char *fname, int cnt_verbose) {
-    int length, size = 0;
+    int length, size = 0, mapped;
     nxpTfaHeader_t *buf = 0;
     nxpTfaHeaderType_t type;
     tfa_srv_api_error_t error = tfa_srv_api_error_Ok;
     char buffer[4*1024];    //,byte TODO check size or use malloc
 
-    size = tfaReadFile(fname, (void**) &buf); //mallocs file buffer
+    mapped = size = tfaMapFile(fname, (void**) &buf);
+    if (size == 0)
+        size = tfaReadFile(fname, (void**) &buf); //mallocs file buffer
 
     if (size == 0)
                 return 0; // tfaReadFile reported error already
 
     type = (nxpTfaHeaderType_t) buf->id;
     if (type == paramsHdr) { /* Load container file */
+        nxpTfaContainer_t *old = gCont;
+        int oldMapped = gContMapped;
+
         gCont = (nxpTfaContainer_t*) buf;
+        gContMapped = mapped;
         size = tfaContLoadContainer(fname);
+        if (size == 0) {
+            /* rejected, keep the container that was loaded before */
+            tfaUnmapFile(buf, mapped);
+            gCont = old;
+            gContMapped = oldMapped;
+            return 0;
+        }
+        if (old)
+            tfaUnmapFile(old, oldMapped); /* loaded before, no longer referenced */
         if (cnt_verbose) {
             error = tfaContShowContainer(buffer, sizeof(buffer));
             length = (int)(strlen(buffer));
@@ -1506,7 +1941,7 @@ int tfa98xx_cnt_loadfile(char *fname, int cnt_verbose) {
                 }
         }
 
-    free(buf);
+    tfaUnmapFile(buf, mapped);
     return size;
 }
 
@@ -64,6 +64,16 @@ typedef unsigned char
  */
 Tfa98xx_Error_t Tfa98xx_Open(unsigned char slave_address,
                  Tfa98xx_handle_t *pHandle);
+/**
+ * Open an instance to a TFA98XX IC on a specific I2C bus.
+ * Devices on different busses can have the same slave address.
+ * @param bus the HAL bus id as registered with lxScriboRegisterBus()
+ * @param slave_address can be 0x68, 0x6A, 0x6C, 0x6E
+ * @param *pHandle:
+ * @return instance handle when successful
+ */
+Tfa98xx_Error_t Tfa98xx_OpenBus(int bus, unsigned char slave_address,
+                 Tfa98xx_handle_t *pHandle);
 /**
  * Check if device is opened.
  */
@@ -323,6 +333,20 @@ Tfa98xx_Error_t Tfa98xx_DspPatch(Tfa98xx_handle_t handle,
                  int patchLength,
                  const unsigned char *patchBytes);
 
+/**
+ * Load the same patch into several devices.
+ * The ROM version is checked on each device, the patch itself is written
+ * once via the generic slave address when broadcast is enabled.
+ * @param handle_cnt the number of devices
+ * @param handles[] the opened instances
+ * @param patchLength: size of the patch file
+ * @param *patchBytes: Pointer to Array of bytes, the contents of the patch file
+ */
+Tfa98xx_Error_t Tfa98xx_DspPatchMultiple(int handle_cnt,
+                 Tfa98xx_handle_t handles[],
+                 int patchLength,
+                 const unsigned char *patchBytes);
+
 /**
  * Check whether the DSP expects tCoef or tCoefA as last parameter in the speaker parameters.
  * @param handle to opened instance
@@ -669,6 +693,25 @@ Tfa98xx_Error_t Tfa98xx_DspReadMemory(Tfa98xx_handle_t handle,
                       unsigned short start_offset,
                       int num_words, int *pValues);
 
+/**
+ * Read or write any number of DSP memory words directly over I2C.
+ * The memory address is set once, the words follow in the largest bursts the bus allows.
+ * @param handle to opened instance
+ * @param which_mem: the DSP memory
+ * @param start_offset: word address of the first word
+ * @param num_words: number of words
+ * @param pValues: the words, 32 bit for PMEM, 24 bit signed for the other memories
+ */
+Tfa98xx_Error_t Tfa98xx_DspStreamRead(Tfa98xx_handle_t handle,
+                      enum Tfa98xx_DMEM which_mem,
+                      unsigned short start_offset,
+                      int num_words, int *pValues);
+
+Tfa98xx_Error_t Tfa98xx_DspStreamWrite(Tfa98xx_handle_t handle,
+                      enum Tfa98xx_DMEM which_mem,
+                      unsigned short start_offset,
+                      int num_words, const int *pValues);
+
 Tfa98xx_Error_t Tfa98xx_CheckDeviceFeatures(Tfa98xx_handle_t handle);
 
 /**
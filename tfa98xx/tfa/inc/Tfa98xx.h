@@ -56,6 +56,15 @@ extern "C" {
  */
 #define TFA98XX_WAITRESULT_NTRIES          40
 #define TFA98XX_WAITRESULT_NTRIES_LONG   2000
+/* When polling for the result the first reads are back to back, after
+ * that the delay between the reads doubles up to the maximum.
+ * With the RPC interrupt the wait is on the interrupt, for at most
+ * TFA98XX_WAITRESULT_IRQ_US, before it falls back to polling.
+ */
+#define TFA98XX_WAITRESULT_SPIN             2
+#define TFA98XX_WAITRESULT_BACKOFF_US      20
+#define TFA98XX_WAITRESULT_BACKOFF_MAX_US 640
+#define TFA98XX_WAITRESULT_IRQ_US        2000
 
 /* following lengths are in bytes */
 #define TFA98XX_PRESET_LENGTH              87
@@ -225,6 +234,67 @@ struct regdef {
  */
 enum Tfa98xx_Error tfa98xx_open(unsigned char slave_address,
                  Tfa98xx_handle_t *pHandle);
+/**
+ * Same as tfa98xx_open() for a device on another HAL bus
+ */
+enum Tfa98xx_Error tfa98xx_open_bus(int bus, unsigned char slave_address,
+                 Tfa98xx_handle_t *pHandle);
+/**
+ * Return the HAL bus of the device, -1 if not open
+ */
+int tfa98xx_get_bus(Tfa98xx_handle_t handle);
+/**
+ * Lock/unlock the device for exclusive use by the calling thread.
+ * The DSP memory and RPC functions take this lock themselves, use it to make
+ * a longer sequence atomic. The lock is recursive.
+ */
+void tfa98xx_lock(Tfa98xx_handle_t handle);
+void tfa98xx_unlock(Tfa98xx_handle_t handle);
+/**
+ * Allow the multiple device functions to write data that is the same for
+ * all devices once, via the generic slave address. This is only done when
+ * all open devices on the bus are in the call. Each device is checked
+ * afterwards and a device that missed it gets its own write.
+ */
+void tfa98xx_set_broadcast(int on);
+/**
+ * Wait for the DSP result on the interrupt of NXP_I2C_SetIrq() instead of
+ * polling CF_STATUS. The ACK interrupt of the devices must be enabled.
+ * Without an interrupt fd CF_STATUS is polled.
+ */
+void tfa98xx_set_rpc_irq(int on);
+/**
+ * Keep a shadow of the registers of the handles opened after this.
+ * A register that was written or read before is read from the shadow, so
+ * a read-modify-write costs only the write. The registers the device
+ * changes itself (status, interrupts, CoolFlux, MTP) are always read.
+ * The last CF_CONTROLS value is kept too, a DSP memory access does not
+ * write it again when it has that value already.
+ * Only use it when all access to the device goes through this API.
+ * Return the previous setting.
+ */
+int tfa98xx_set_shadow(int on);
+/**
+ * Return 1 if the device changes the register itself or a read of it has
+ * side effects: status, interrupts, keys, CoolFlux access and MTP.
+ */
+int tfa98xx_reg_volatile(unsigned char subaddress);
+/**
+ * Forget the shadowed registers, e.g. after a reset that was not done
+ * with the I2CR bit.
+ */
+void tfa98xx_shadow_invalidate(Tfa98xx_handle_t handle);
+/**
+ * Skip a speaker, config or preset upload when the DSP of the handle has the
+ * same content from the last upload of this process, also the unchanged
+ * biquads of tfa98xx_dsp_biquad_set_bank(). Off by default.
+ * A DSP reset, patch or I2CR makes all uploads go to the DSP again.
+ * Only use it when all access to the device goes through this API, it
+ * cannot see a reset or upload by someone else, nor the DSP adapting the
+ * speaker model.
+ * Return the previous setting.
+ */
+int tfa98xx_set_param_cache(int on);
 /**
  * Check if device is opened.
  */
@@ -420,6 +490,10 @@ enum Tfa98xx_Error _tfa98xx_dsp_system_stable(Tfa98xx_handle_t handle,
 enum Tfa98xx_Error tfa98xx_dsp_patch(Tfa98xx_handle_t handle,
                  int patchLength,
                  const unsigned char *patchBytes);
+enum Tfa98xx_Error tfa98xx_dsp_patch_multiple(int handle_cnt,
+                 Tfa98xx_handle_t handles[],
+                 int patchLength,
+                 const unsigned char *patchBytes);
 
 /* Check whether the DSP expects tCoef or tCoefA as last parameter in
  * the speaker parameters
@@ -484,6 +558,17 @@ enum Tfa98xx_Error
 tfa98xx_dsp_biquad_set_coeff_bytes(Tfa98xx_handle_t handle,
                 int biquad_index,
                 const unsigned char *pBiquadBytes);
+/* set all TFA98XX_BIQUAD_NUM biquads, bytes[] has them in order
+ *  The biquads that are the same as in the last call are skipped, the
+ *  changed ones go in one message. Any other write of the filterbank,
+ *  a DSP reset or a patch makes it send them all again.
+ */
+enum Tfa98xx_Error tfa98xx_dsp_biquad_set_bank(Tfa98xx_handle_t handle,
+                const unsigned char *bytes);
+/* forget the filterbank and the resident parameters, the next uploads all
+ * go to the DSP, see tfa98xx_set_param_cache()
+ */
+void tfa98xx_dsp_params_invalidate(Tfa98xx_handle_t handle);
 
 enum Tfa98xx_Error tfa98xx_dsp_biquad_set_coeff_multiple_bytes(
                 int handle_cnt,
@@ -584,6 +669,8 @@ enum Tfa98xx_Error tfa98xx_dsp_execute_rpc(Tfa98xx_handle_t handle,
 enum Tfa98xx_Error tfa98xx_read_data(Tfa98xx_handle_t handle,
                  unsigned char subaddress,
                  int num_bytes, unsigned char data[]);
+/* the largest num_bytes of tfa98xx_write_data(), the bus may take less */
+#define TFA98XX_MAX_WRITE_DATA 1024
 enum Tfa98xx_Error tfa98xx_write_data(Tfa98xx_handle_t handle,
                   unsigned char subaddress,
                   int num_bytes,
@@ -598,6 +685,16 @@ enum Tfa98xx_Error tfa98xx_dsp_read_memory(Tfa98xx_handle_t handle,
                       enum Tfa98xx_DMEM which_mem,
                       unsigned short start_offset,
                       int num_words, int *pValues);
+/* direct access to any number of DSP words, in the largest I2C bursts the
+ * bus allows; PMEM words are 32 bit, the other memories 24 bit signed */
+enum Tfa98xx_Error tfa98xx_dsp_stream_read(Tfa98xx_handle_t handle,
+                      enum Tfa98xx_DMEM which_mem,
+                      unsigned short start_offset,
+                      int num_words, int *pValues);
+enum Tfa98xx_Error tfa98xx_dsp_stream_write(Tfa98xx_handle_t handle,
+                      enum Tfa98xx_DMEM which_mem,
+                      unsigned short start_offset,
+                      int num_words, const int *pValues);
 
 /* support for converting error codes into text */
 const char *tfa98xx_get_error_string(enum Tfa98xx_Error error);
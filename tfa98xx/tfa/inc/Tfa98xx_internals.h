@@ -70,6 +70,8 @@
 
 /* the maximum message length in the communication with the DSP */
 #define MAX_PARAM_SIZE (145*3)
+/* CF_CONTROLS, CF_MAD and the module/param id word in front of a parameter */
+#define RPC_HEADER_SIZE 7
 
 #define MIN(a,b) ((a)<(b)?(a):(b))
 #define ROUND_DOWN(a,n) (((a)/(n))*(n))
@@ -87,10 +89,28 @@ typedef enum featureSupport featureSupport_t;
 struct Tfa98xx_handle_private {
     int in_use;
     unsigned char slave_address;
+    int bus;    /* HAL bus the device is on */
     unsigned char rev;
     unsigned char subrev;
     enum featureSupport supportDrc;
     enum featureSupport supportFramework;
+    /* register shadow, see tfa98xx_set_shadow() */
+    int shadow;
+    unsigned char shadowValid[256/8];   /* bit per register, set if shadowRegs[] has it */
+    unsigned short shadowRegs[256];
+    /* CF_CONTROLS is written by the host only, the last value written or
+     * read is kept for the DSP memory accessors with the shadow on,
+     * -1 if not known */
+    int cfCtrl;
+    /* the filterbank the DSP has, see tfa98xx_dsp_biquad_set_bank() */
+    int biquadValid;                    /* bit per biquad, set if biquadBank[] has it */
+    unsigned char biquadBank[TFA98XX_BIQUAD_NUM*6*3]; /* 6 coefficients of 3 bytes */
+    /* the speakerboost parameters the DSP has, see tfa98xx_set_param_cache() */
+    struct {
+        int valid;
+        int length;
+        unsigned char data[MAX_PARAM_SIZE];
+    } resident[3];                      /* speaker, config, preset */
 };
 
 #define TFA98XX_CF_RESET  1
@@ -70,6 +70,12 @@ Tfa98xx_Open(unsigned char slave_address, Tfa98xx_handle_t *pHandle)
     return tfa98xx_open(slave_address, pHandle);
 }
 
+Tfa98xx_Error_t
+Tfa98xx_OpenBus(int bus, unsigned char slave_address, Tfa98xx_handle_t *pHandle)
+{
+    return tfa98xx_open_bus(bus, slave_address, pHandle);
+}
+
 Tfa98xx_Error_t Tfa98xx_Close(Tfa98xx_handle_t handle)
 {
     return tfa98xx_close(handle);
@@ -658,6 +664,13 @@ Tfa98xx_DspPatch(Tfa98xx_handle_t handle, int patchLength,
     return tfa98xx_dsp_patch(handle, patchLength, patchBytes);
 }
 
+Tfa98xx_Error_t
+Tfa98xx_DspPatchMultiple(int handle_cnt, Tfa98xx_handle_t handles[],
+         int patchLength, const unsigned char *patchBytes)
+{
+    return tfa98xx_dsp_patch_multiple(handle_cnt, handles, patchLength, patchBytes);
+}
+
 /* Execute RPC protocol to write something to the DSP */
 Tfa98xx_Error_t
 Tfa98xx_DspSetParamVarWait(Tfa98xx_handle_t handle,
@@ -810,6 +823,22 @@ Tfa98xx_Error_t Tfa98xx_DspWriteMemory(Tfa98xx_handle_t handle,
                        num_words, pValues);
 }
 
+Tfa98xx_Error_t
+Tfa98xx_DspStreamRead(Tfa98xx_handle_t handle, Tfa98xx_DMEM_e which_mem,
+              unsigned short start_offset, int num_words, int *pValues)
+{
+    return tfa98xx_dsp_stream_read(handle, which_mem,
+              start_offset, num_words, pValues);
+}
+
+Tfa98xx_Error_t
+Tfa98xx_DspStreamWrite(Tfa98xx_handle_t handle, Tfa98xx_DMEM_e which_mem,
+              unsigned short start_offset, int num_words, const int *pValues)
+{
+    return tfa98xx_dsp_stream_write(handle, which_mem,
+              start_offset, num_words, pValues);
+}
+
 
 
 Tfa98xx_Error_t Tfa98xx_SetToneDetectionOff(Tfa98xx_handle_t handle)
@@ -27,6 +27,10 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#if !defined(__KERNEL__) && !(defined(WIN32) || defined(_X64))
+#include <pthread.h>
+#define TFA98XX_LOCKING
+#endif
 #include "Tfa98xx_internals.h"
 #include "Tfa98xx_Registers.h"
 #include "NXP_I2C.h"
@@ -46,7 +50,58 @@
 /* 4 possible I2C addresses
  */
 #define MAX_HANDLES 4
-static struct Tfa98xx_handle_private handlesLocal[MAX_HANDLES];
+/* an extra handle for the writes to the generic slave address */
+#define BROADCAST_HANDLE MAX_HANDLES
+static struct Tfa98xx_handle_private handlesLocal[MAX_HANDLES+1];
+static int broadcastEnabled;
+static int rpcIrqEnabled;
+static int shadowEnabled;
+static int paramCacheEnabled;
+
+/*
+ * locking
+ *  handlesMutex protects the handle table (open/close)
+ *  each handle has a recursive lock that serializes the multi-transaction
+ *  sequences (DSP memory and RPC access) on that device only, so devices
+ *  can be used from different threads
+ *  single register accesses are made atomic by the bus lock in the HAL
+ */
+#ifdef TFA98XX_LOCKING
+static pthread_mutex_t handlesMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t handlesLock[MAX_HANDLES+1];
+static pthread_once_t handlesLockOnce = PTHREAD_ONCE_INIT;
+
+static void tfa98xx_lock_init(void)
+{
+    pthread_mutexattr_t attr;
+    int i;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    for (i = 0; i <= BROADCAST_HANDLE; i++)
+        pthread_mutex_init(&handlesLock[i], &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+#endif
+
+void tfa98xx_lock(Tfa98xx_handle_t handle)
+{
+#ifdef TFA98XX_LOCKING
+    if (handle < 0 || handle > BROADCAST_HANDLE)
+        return;
+    pthread_once(&handlesLockOnce, tfa98xx_lock_init);
+    pthread_mutex_lock(&handlesLock[handle]);
+#endif
+}
+
+void tfa98xx_unlock(Tfa98xx_handle_t handle)
+{
+#ifdef TFA98XX_LOCKING
+    if (handle < 0 || handle > BROADCAST_HANDLE)
+        return;
+    pthread_mutex_unlock(&handlesLock[handle]);
+#endif
+}
 
 /**
  * return revision
@@ -73,12 +128,266 @@ int tfa98xx_handle_is_open(Tfa98xx_handle_t h)
 {
     int retval = 0;
 
-    if ((h >= 0) && (h < MAX_HANDLES))
+    if ((h >= 0) && (h <= BROADCAST_HANDLE))
         retval = handlesLocal[h].in_use != 0;
 
     return retval;
 }
 
+/* the handles are locked in index order so 2 callers with the same
+ * devices in a different order can't deadlock */
+static void tfa98xx_lock_multiple(int handle_cnt, Tfa98xx_handle_t handles[])
+{
+    int h, i;
+
+    for (h = 0; h < MAX_HANDLES; h++)
+        for (i = 0; i < handle_cnt; i++)
+            if (handles[i] == h) {
+                tfa98xx_lock(h);
+                break;
+            }
+}
+
+static void tfa98xx_unlock_multiple(int handle_cnt, Tfa98xx_handle_t handles[])
+{
+    int h, i;
+
+    for (h = MAX_HANDLES-1; h >= 0; h--)
+        for (i = 0; i < handle_cnt; i++)
+            if (handles[i] == h) {
+                tfa98xx_unlock(h);
+                break;
+            }
+}
+
+void tfa98xx_set_broadcast(int on)
+{
+    broadcastEnabled = on;
+}
+
+void tfa98xx_set_rpc_irq(int on)
+{
+    rpcIrqEnabled = on;
+}
+
+int tfa98xx_set_shadow(int on)
+{
+    int was = shadowEnabled;
+
+    shadowEnabled = on;
+    return was;
+}
+
+/*
+ * volatile registers
+ *  the registers below are changed by the device or have side effects on
+ *  a read, they are never shadowed
+ */
+static const struct {
+    unsigned char first, last;
+} tfa98xx_volatile_regs[] = {
+    { TFA98XX_STATUSREG, TFA98XX_TEMPERATURE },          /* status, battery, temperature */
+    { TFA98XX_MTPKEY2_REG, TFA98XX_MTPKEY2_REG },
+    { TFA98XX_INTERRUPT_REG, TFA98XX_INTERRUPT_REG },
+    { TFA98XX_INTERRUPT_OUT_REG1, TFA98XX_INTERRUPT_IN_REG3 }, /* interrupt status and clear */
+    { TFA98XX_KEY1_PROTECTED_MTP_CTRL_REG3, TFA98XX_KEY1_PROTECTED_MTP_CTRL_REG3 },
+    { TFA98XX_CF_CONTROLS, 0xff },                       /* CoolFlux access, MTP */
+};
+
+int tfa98xx_reg_volatile(unsigned char subaddress)
+{
+    unsigned int i;
+
+    for (i = 0; i < sizeof(tfa98xx_volatile_regs)/sizeof(tfa98xx_volatile_regs[0]); i++)
+        if (subaddress >= tfa98xx_volatile_regs[i].first &&
+                subaddress <= tfa98xx_volatile_regs[i].last)
+            return 1;
+    return 0;
+}
+
+static void tfa98xx_shadow_set(Tfa98xx_handle_t handle, unsigned char subaddress,
+            unsigned short value)
+{
+    struct Tfa98xx_handle_private *h = &handlesLocal[handle];
+
+    if (!h->shadow || tfa98xx_reg_volatile(subaddress))
+        return;
+    h->shadowRegs[subaddress] = value;
+    h->shadowValid[subaddress >> 3] |= 1 << (subaddress & 7);
+}
+
+/*
+ * forget count registers from subaddress on
+ *  a write to the generic slave reaches all devices on the bus
+ */
+static void tfa98xx_shadow_clear(Tfa98xx_handle_t handle, int subaddress, int count)
+{
+    int h, reg;
+
+    for (h = 0; h < MAX_HANDLES; h++) {
+        if (h != handle && !(handlesLocal[handle].slave_address == TFA98XX_GENERIC_SLAVE_ADDRESS
+                && handlesLocal[h].in_use && handlesLocal[h].bus == handlesLocal[handle].bus))
+            continue;
+        for (reg = subaddress; reg < subaddress + count && reg < 256; reg++)
+            handlesLocal[h].shadowValid[reg >> 3] &= ~(1 << (reg & 7));
+        if (subaddress <= TFA98XX_CF_CONTROLS && TFA98XX_CF_CONTROLS < subaddress + count)
+            handlesLocal[h].cfCtrl = -1;
+    }
+}
+
+/*
+ * remember CF_CONTROLS after a successful access of the device itself
+ *  only with the shadow on, otherwise cfCtrl stays unknown and is not used
+ */
+static void tfa98xx_cf_ctrl_set(Tfa98xx_handle_t handle, unsigned short value)
+{
+    if (handlesLocal[handle].shadow
+            && handlesLocal[handle].slave_address != TFA98XX_GENERIC_SLAVE_ADDRESS)
+        handlesLocal[handle].cfCtrl = value;
+}
+
+/*
+ * forget the filterbank and the resident parameters after the DSP memory
+ * was reset or written otherwise
+ *  a write to the generic slave reaches all devices on the bus
+ */
+static void tfa98xx_dsp_forget(Tfa98xx_handle_t handle)
+{
+    int h;
+
+    for (h = 0; h < MAX_HANDLES; h++) {
+        if (h != handle && !(handlesLocal[handle].slave_address == TFA98XX_GENERIC_SLAVE_ADDRESS
+                && handlesLocal[h].in_use && handlesLocal[h].bus == handlesLocal[handle].bus))
+            continue;
+        handlesLocal[h].biquadValid = 0;
+        memset(handlesLocal[h].resident, 0, sizeof(handlesLocal[h].resident));
+    }
+}
+
+int tfa98xx_set_param_cache(int on)
+{
+    int was = paramCacheEnabled;
+
+    paramCacheEnabled = on;
+    return was;
+}
+
+/*
+ * resident parameters
+ *  a copy of the speaker, config and preset uploads is kept, an upload of
+ *  the same content again is skipped
+ */
+static int tfa98xx_param_slot(unsigned char module_id, unsigned char param_id)
+{
+    if (module_id != MODULE_SPEAKERBOOST)
+        return -1;
+    switch (param_id) {
+    case SB_PARAM_SET_LSMODEL:
+        return 0;
+    case SB_PARAM_SET_CONFIG:
+        return 1;
+    case SB_PARAM_SET_PRESET:
+        return 2;
+    default:
+        return -1;
+    }
+}
+
+static int tfa98xx_param_resident(Tfa98xx_handle_t handle, int slot,
+            int num_bytes, const unsigned char data[])
+{
+    struct Tfa98xx_handle_private *h = &handlesLocal[handle];
+
+    return paramCacheEnabled && slot >= 0 && data && h->resident[slot].valid &&
+        h->resident[slot].length == num_bytes &&
+        memcmp(h->resident[slot].data, data, num_bytes) == 0;
+}
+
+/*
+ * called before a parameter write, forget what it may change
+ *  a speakerboost parameter may change the others, e.g. a config the preset
+ *  a write to the generic slave reaches all devices on the bus
+ */
+static void tfa98xx_param_forget(Tfa98xx_handle_t handle, unsigned char module_id)
+{
+    int h;
+
+    for (h = 0; h < MAX_HANDLES; h++) {
+        if (h != handle && !(handlesLocal[handle].slave_address == TFA98XX_GENERIC_SLAVE_ADDRESS
+                && handlesLocal[h].in_use && handlesLocal[h].bus == handlesLocal[handle].bus))
+            continue;
+        if (module_id == MODULE_BIQUADFILTERBANK)
+            handlesLocal[h].biquadValid = 0;
+        else if (module_id == MODULE_SPEAKERBOOST)
+            memset(handlesLocal[h].resident, 0, sizeof(handlesLocal[h].resident));
+    }
+}
+
+static void tfa98xx_param_loaded(Tfa98xx_handle_t handle, int slot,
+            int num_bytes, const unsigned char data[])
+{
+    struct Tfa98xx_handle_private *h = &handlesLocal[handle];
+
+    if (slot < 0 || !data || num_bytes > MAX_PARAM_SIZE ||
+            h->slave_address == TFA98XX_GENERIC_SLAVE_ADDRESS)
+        return;
+    h->resident[slot].valid = 1;
+    h->resident[slot].length = num_bytes;
+    memcpy(h->resident[slot].data, data, num_bytes);
+}
+
+void tfa98xx_shadow_invalidate(Tfa98xx_handle_t handle)
+{
+    if (tfa98xx_handle_is_open(handle)) {
+        tfa98xx_shadow_clear(handle, 0, 256);
+        tfa98xx_dsp_forget(handle);
+    }
+}
+
+/*
+ * open the broadcast handle for writing the same data to all handles
+ *  only when all open devices on the bus are in handles[] and they are
+ *  the same type, else the generic slave would write to a device that
+ *  was not asked for
+ *  return -1 when not possible, the caller writes to each device then
+ */
+static Tfa98xx_handle_t tfa98xx_broadcast_open(int handle_cnt, Tfa98xx_handle_t handles[])
+{
+    struct Tfa98xx_handle_private *first;
+    int h, i;
+
+    if (!broadcastEnabled || handle_cnt < 2 || !tfa98xx_handle_is_open(handles[0]))
+        return -1;
+    first = &handlesLocal[handles[0]];
+    /* the generic slave only reaches the devices on one bus */
+    for (i = 1; i < handle_cnt; i++)
+        if (!tfa98xx_handle_is_open(handles[i]) || handlesLocal[handles[i]].bus != first->bus)
+            return -1;
+    for (h = 0; h < MAX_HANDLES; h++) {
+        if (!handlesLocal[h].in_use || handlesLocal[h].bus != first->bus)
+            continue;
+        for (i = 0; i < handle_cnt; i++)
+            if (handles[i] == h)
+                break;
+        if (i == handle_cnt || handlesLocal[h].rev != first->rev
+                || handlesLocal[h].slave_address == TFA98XX_GENERIC_SLAVE_ADDRESS)
+            return -1;
+    }
+
+    tfa98xx_lock(BROADCAST_HANDLE);
+    handlesLocal[BROADCAST_HANDLE] = *first;
+    handlesLocal[BROADCAST_HANDLE].slave_address = TFA98XX_GENERIC_SLAVE_ADDRESS;
+    handlesLocal[BROADCAST_HANDLE].shadow = 0; /* can't read back */
+
+    return BROADCAST_HANDLE;
+}
+
+static void tfa98xx_broadcast_close(Tfa98xx_handle_t handle)
+{
+    handlesLocal[handle].in_use = 0;
+    tfa98xx_unlock(handle);
+}
+
 /* translate a I2C driver error into an error for Tfa9887 API */
 static enum Tfa98xx_Error tfa98xx_classify_i2c_error(enum NXP_I2C_Error i2c_error)
 {
@@ -166,6 +475,12 @@ tfa98xx_dsp_get_state_info_size(Tfa98xx_handle_t handle, int *pSize)
 
 enum Tfa98xx_Error
 tfa98xx_open(unsigned char slave_address, Tfa98xx_handle_t *pHandle)
+{
+    return tfa98xx_open_bus(0, slave_address, pHandle);
+}
+
+enum Tfa98xx_Error
+tfa98xx_open_bus(int bus, unsigned char slave_address, Tfa98xx_handle_t *pHandle)
 {
     enum Tfa98xx_Error error = Tfa98xx_Error_OutOfHandles;
     unsigned short rev, status;
@@ -174,37 +489,68 @@ tfa98xx_open(unsigned char slave_address, Tfa98xx_handle_t *pHandle)
     *pHandle = -1;
     /* find free handle */
 
+#ifdef TFA98XX_LOCKING
+    pthread_mutex_lock(&handlesMutex);
+#endif
     for (i = 0; i < MAX_HANDLES; ++i) {
         if (!handlesLocal[i].in_use) {
             handlesLocal[i].in_use = 1;
             handlesLocal[i].slave_address = slave_address;
+            /* a bus that is not registered is bus 0, the bus wide
+             * (generic slave) writes must see that */
+            handlesLocal[i].bus = NXP_I2C_ResolveBus(bus);
             handlesLocal[i].supportDrc = supportNotSet;
             handlesLocal[i].supportFramework = supportNotSet;
-            error = tfa98xx_read_register16(i,
-                            TFA98XX_REVISIONNUMBER,
-                            &rev);
-            if (Tfa98xx_Error_Ok != error) {
-                handlesLocal[i].in_use = 0;
-                break; /* error, exit the for-loop */
-            }
-            handlesLocal[i].rev = rev & 0xff;
-            handlesLocal[i].subrev = (rev>>8) & 0xff;
-            *pHandle = i;
-            error = Tfa98xx_Error_Ok;
-            break;    /* handle is assigned, exit the for-loop */
+            handlesLocal[i].shadow = shadowEnabled;
+            memset(handlesLocal[i].shadowValid, 0, sizeof(handlesLocal[i].shadowValid));
+            handlesLocal[i].cfCtrl = -1;
+            handlesLocal[i].biquadValid = 0;
+            memset(handlesLocal[i].resident, 0, sizeof(handlesLocal[i].resident));
+            break;
         }
     }
+#ifdef TFA98XX_LOCKING
+    pthread_mutex_unlock(&handlesMutex);
+#endif
+
+    /* the handle is claimed, the table lock is not needed for the i2c access */
+    if (i < MAX_HANDLES) {
+        error = tfa98xx_read_register16(i,
+                        TFA98XX_REVISIONNUMBER,
+                        &rev);
+        if (Tfa98xx_Error_Ok != error) {
+            handlesLocal[i].in_use = 0;
+            return error;
+        }
+        handlesLocal[i].rev = rev & 0xff;
+        handlesLocal[i].subrev = (rev>>8) & 0xff;
+        *pHandle = i;
+    }
     return error;
 }
 
+int tfa98xx_get_bus(Tfa98xx_handle_t handle)
+{
+    if (tfa98xx_handle_is_open(handle))
+        return handlesLocal[handle].bus;
+    return -1;
+}
+
 enum Tfa98xx_Error tfa98xx_close(Tfa98xx_handle_t handle)
 {
+    enum Tfa98xx_Error error = Tfa98xx_Error_NotOpen;
+
+#ifdef TFA98XX_LOCKING
+    pthread_mutex_lock(&handlesMutex);
+#endif
     if (tfa98xx_handle_is_open(handle)) {
         handlesLocal[handle].in_use = 0;
-        return Tfa98xx_Error_Ok;
-    } else {
-        return Tfa98xx_Error_NotOpen;
+        error = Tfa98xx_Error_Ok;
     }
+#ifdef TFA98XX_LOCKING
+    pthread_mutex_unlock(&handlesMutex);
+#endif
+    return error;
 }
 
 /* Tfa98xx_DspConfigParameterCount
@@ -297,19 +643,52 @@ enum Tfa98xx_Error tfa98xx_init(Tfa98xx_handle_t handle)
     return error;
 }
 
+/* nr of patch transactions that are handed to the HAL in 1 batch */
+#define PATCH_BATCH_MSGS 16
+/* consecutive patch memory writes are merged up to this size */
+#define PATCH_MERGE_SIZE 4096
+
+/*
+ * return 1 if the patch transaction in next continues the memory write
+ *  in cur, both are a CF_MAD write followed by the data for CF_MEM
+ *  the next one continues if it starts at the address where the
+ *  autoincrement of cur ended
+ */
+static int tfa98xx_patch_continues(const unsigned char *cur, int cur_size,
+        const unsigned char *next, int next_size, int word_size)
+{
+    int address;
+
+    if (cur[0] != TFA98XX_CF_MAD || next[0] != TFA98XX_CF_MAD)
+        return 0;
+    if (cur_size <= 3 || next_size <= 3 || (cur_size - 3) % word_size)
+        return 0;
+    address = (cur[1] << 8 | cur[2]) + (cur_size - 3) / word_size;
+    return (next[1] << 8 | next[2]) == address;
+}
+
 enum Tfa98xx_Error
 tfa98xx_process_patch_file(Tfa98xx_handle_t handle, int length,
          const unsigned char *bytes)
 {
-    unsigned short size;
-    int index;
+    unsigned short size, next_size, cf_ctrl;
+    int index, next, num_msgs = 0, merged_size, max_size, word_size = 0;
     enum NXP_I2C_Error i2c_error = NXP_I2C_Ok;
+    NXP_I2C_Msg_t msgs[PATCH_BATCH_MSGS];
+    unsigned char merged[PATCH_MERGE_SIZE];
+    const unsigned char *data;
     /* expect following format in patchBytes:
      * 2 bytes length of I2C transaction in little endian, then the bytes,
      * excluding the slave address which is added from the handle
      * This repeats for the whole file
+     * the transactions are sent in batches, so that a pipelining
+     * transport does not wait for every single write to complete
+     * a bus that takes more than the patch was split for gets the
+     * consecutive memory writes merged into one transaction
      */
 
+    tfa98xx_dsp_forget(handle); /* DSP memory may be written */
+    max_size = MIN(NXP_I2C_BufferSizeBus(handlesLocal[handle].bus), PATCH_MERGE_SIZE);
     index = 0;
     while (index < length) {
         /* extract little endian length */
@@ -319,16 +698,64 @@ tfa98xx_process_patch_file(Tfa98xx_handle_t handle, int length,
             /* outside the buffer, error in the input data */
             return Tfa98xx_Error_Bad_Parameter;
         }
-        if (size > NXP_I2C_BufferSize()) {
+        if (size > NXP_I2C_BufferSizeBus(handlesLocal[handle].bus)) {
             /* too big, must fit buffer */
             return Tfa98xx_Error_Bad_Parameter;
         }
-        i2c_error =
-            NXP_I2C_Write(handlesLocal[handle].slave_address, size,
-                  bytes + index);
-        if (i2c_error != NXP_I2C_Ok)
-            break;
-        index += size;
+        data = bytes + index;
+        next = index + size;
+
+        /* the memory type in CF_CONTROLS sets the autoincrement step */
+        if (size >= 3 && data[0] == TFA98XX_CF_CONTROLS) {
+            cf_ctrl = data[1] << 8 | data[2];
+            if (cf_ctrl & TFA98XX_CF_CONTROLS_AIF_MSK)
+                word_size = 0; /* no autoincrement */
+            else
+                word_size = ((cf_ctrl >> 1) & 3) == Tfa98xx_DMEM_PMEM ? 4 : 3;
+        }
+
+        /* append the transactions that continue this memory write */
+        merged_size = 0;
+        while (word_size && next + 2 <= length) {
+            next_size = bytes[next] + bytes[next + 1] * 256;
+            if (next + 2 + next_size > length)
+                break;
+            if ((merged_size ? merged_size : size) + next_size - 3 > max_size)
+                break;
+            if (!tfa98xx_patch_continues(merged_size ? merged : data,
+                    merged_size ? merged_size : size,
+                    bytes + next + 2, next_size, word_size))
+                break;
+            if (merged_size == 0) {
+                memcpy(merged, data, size);
+                merged_size = size;
+            }
+            memcpy(merged + merged_size, bytes + next + 2 + 3, next_size - 3);
+            merged_size += next_size - 3;
+            next += 2 + next_size;
+        }
+        if (merged_size) {
+            data = merged;
+            size = merged_size;
+        }
+
+        msgs[num_msgs].sla = handlesLocal[handle].slave_address;
+        msgs[num_msgs].num_write_bytes = size;
+        msgs[num_msgs].write_data = data;
+        msgs[num_msgs].num_read_bytes = 0;
+        msgs[num_msgs].read_buffer = NULL;
+        num_msgs++;
+        if (size > 0)
+            tfa98xx_shadow_clear(handle, data[0], size / 2);
+        index = next;
+
+        /* merged is reused for the next merge, so it goes out now */
+        if (num_msgs == PATCH_BATCH_MSGS || index >= length || merged_size) {
+            i2c_error = NXP_I2C_BatchBus(handlesLocal[handle].bus, num_msgs, msgs);
+            if (i2c_error != NXP_I2C_Ok)
+                break;
+            num_msgs = 0;
+        }
     }
     return tfa98xx_classify_i2c_error(i2c_error);
 }
@@ -350,7 +777,20 @@ tfa98xx_write_register16(Tfa98xx_handle_t handle,
     write_data[1] = (value >> 8) & 0xFF;
     write_data[2] = value & 0xFF;
 
-    i2c_error = NXP_I2C_Write(handlesLocal[handle].slave_address, bytes2write, write_data);
+    i2c_error = NXP_I2C_WriteBus(handlesLocal[handle].bus, handlesLocal[handle].slave_address, bytes2write, write_data);
+
+    if (subaddress == TFA98XX_SYS_CTRL && (value & TFA98XX_SYS_CTRL_I2CR)) {
+        tfa98xx_shadow_clear(handle, 0, 256); /* reset to the defaults */
+        tfa98xx_dsp_forget(handle);
+    } else if (subaddress == TFA98XX_CF_CONTROLS && (value & TFA98XX_CF_CONTROLS_RST)) {
+        tfa98xx_shadow_clear(handle, subaddress, 1);
+        tfa98xx_dsp_forget(handle);
+    } else if (i2c_error == NXP_I2C_Ok && handlesLocal[handle].slave_address != TFA98XX_GENERIC_SLAVE_ADDRESS)
+        tfa98xx_shadow_set(handle, subaddress, value);
+    else
+        tfa98xx_shadow_clear(handle, subaddress, 1);
+    if (subaddress == TFA98XX_CF_CONTROLS && i2c_error == NXP_I2C_Ok)
+        tfa98xx_cf_ctrl_set(handle, value);
 
     return tfa98xx_classify_i2c_error(i2c_error);
 }
@@ -396,19 +836,22 @@ tfa98xx_write_data(Tfa98xx_handle_t handle,
     /* subaddress followed by data */
     int bytes2write = num_bytes + 1;
 
-    unsigned char write_data[MAX_PARAM_SIZE];
+    unsigned char write_data[1 + TFA98XX_MAX_WRITE_DATA];
     if (!tfa98xx_handle_is_open(handle))
         return Tfa98xx_Error_NotOpen;
-    if (bytes2write > MAX_PARAM_SIZE)
+    if (bytes2write > (int)sizeof(write_data))
         return Tfa98xx_Error_Bad_Parameter;
-    if (bytes2write > NXP_I2C_BufferSize())
+    if (bytes2write > NXP_I2C_BufferSizeBus(handlesLocal[handle].bus))
         return Tfa98xx_Error_Bad_Parameter;
 
     write_data[0] = subaddress;
     memcpy(write_data + 1, data, num_bytes);
     i2c_error =
-        NXP_I2C_Write(handlesLocal[handle].slave_address, bytes2write,
+        NXP_I2C_WriteBus(handlesLocal[handle].bus, handlesLocal[handle].slave_address, bytes2write,
               write_data);
+    tfa98xx_shadow_clear(handle, subaddress, (num_bytes + 1) / 2);
+    if (subaddress == TFA98XX_CF_CONTROLS && num_bytes >= 2 && i2c_error == NXP_I2C_Ok)
+        tfa98xx_cf_ctrl_set(handle, data[0] << 8 | data[1]);
     return tfa98xx_classify_i2c_error(i2c_error);
 }
 
@@ -425,15 +868,27 @@ tfa98xx_read_register16(Tfa98xx_handle_t handle,
     _ASSERT(pValue != (unsigned short *)0);
     if (!tfa98xx_handle_is_open(handle))
         return Tfa98xx_Error_NotOpen;
+    if (handlesLocal[handle].shadow &&
+            (handlesLocal[handle].shadowValid[subaddress >> 3] & (1 << (subaddress & 7)))) {
+        *pValue = handlesLocal[handle].shadowRegs[subaddress];
+        return Tfa98xx_Error_Ok;
+    }
+    if (subaddress == TFA98XX_CF_CONTROLS && handlesLocal[handle].cfCtrl >= 0) {
+        *pValue = (unsigned short)handlesLocal[handle].cfCtrl;
+        return Tfa98xx_Error_Ok;
+    }
     write_data[0] = subaddress;
     read_buffer[0] = read_buffer[1] = 0;
     i2c_error =
-        NXP_I2C_WriteRead(handlesLocal[handle].slave_address, bytes2write,
+        NXP_I2C_WriteReadBus(handlesLocal[handle].bus, handlesLocal[handle].slave_address, bytes2write,
                   write_data, bytes2read, read_buffer);
     if (tfa98xx_classify_i2c_error(i2c_error) != Tfa98xx_Error_Ok) {
         return tfa98xx_classify_i2c_error(i2c_error);
     } else {
         *pValue = (read_buffer[0] << 8) + read_buffer[1];
+        tfa98xx_shadow_set(handle, subaddress, *pValue);
+        if (subaddress == TFA98XX_CF_CONTROLS)
+            tfa98xx_cf_ctrl_set(handle, *pValue);
         return Tfa98xx_Error_Ok;
     }
 }
@@ -456,11 +911,11 @@ tfa98xx_read_data(Tfa98xx_handle_t handle,
     unsigned char write_data[1];
     if (!tfa98xx_handle_is_open(handle))
         return Tfa98xx_Error_NotOpen;
-    if (num_bytes > NXP_I2C_BufferSize())
+    if (num_bytes > NXP_I2C_BufferSizeBus(handlesLocal[handle].bus))
         return Tfa98xx_Error_Bad_Parameter;
     write_data[0] = subaddress;
     i2c_error =
-        NXP_I2C_WriteRead(handlesLocal[handle].slave_address, bytes2write,
+        NXP_I2C_WriteReadBus(handlesLocal[handle].bus, handlesLocal[handle].slave_address, bytes2write,
                   write_data, num_bytes, data);
     if (tfa98xx_classify_i2c_error(i2c_error) != Tfa98xx_Error_Ok)
         return tfa98xx_classify_i2c_error(i2c_error);
@@ -1392,36 +1847,6 @@ tfa98xx_get_mute(Tfa98xx_handle_t handle, enum Tfa98xx_Mute *pMute)
     return Tfa98xx_Error_Ok;
 }
 
-/**
- convert signed 24 bit integers to 32bit aligned bytes
-   input:   data contains "num_bytes/3" int24 elements
-   output:  bytes contains "num_bytes" byte elements
-*/
-
-void tfa98xx_convert_data2bytes(int num_data, const int data[],
-                   unsigned char bytes[])
-{
-    int i;            /* index for data */
-    int k;            /* index for bytes */
-    int d;
-    /* note: cannot just take the lowest 3 bytes from the 32 bit
-     * integer, because also need to take care of clipping any
-     * value > 2&23 */
-    for (i = 0, k = 0; i < num_data; ++i, k += 3) {
-        if (data[i] >= 0)
-            d = MIN(data[i], (1 << 23) - 1);
-        else {
-            /* 2's complement */
-            d = (1 << 24) - MIN(-data[i], 1 << 23);
-        }
-        _ASSERT(d >= 0);
-        _ASSERT(d < (1 << 24));    /* max 24 bits in use */
-        bytes[k] = (d >> 16) & 0xFF;    /* MSB */
-        bytes[k + 1] = (d >> 8) & 0xFF;
-        bytes[k + 2] = (d) & 0xFF;    /* LSB */
-    }
-}
-
 enum Tfa98xx_Error
 tfa98xx_dsp_biquad_set_coeff(Tfa98xx_handle_t handle,
                int biquad_index, const unsigned char *bytes)
@@ -1455,6 +1880,49 @@ tfa98xx_dsp_biquad_set_all_coeff_multiple(int handle_cnt, Tfa98xx_handle_t handl
                         bytes);
 }
 
+enum Tfa98xx_Error
+tfa98xx_dsp_biquad_set_bank(Tfa98xx_handle_t handle, const unsigned char *bytes)
+{
+    struct Tfa98xx_handle_private *h;
+    enum Tfa98xx_Error error = Tfa98xx_Error_Ok;
+    const int size = BIQUAD_COEFF_SIZE * 3;
+    int i, changed = 0, last = 0;
+
+    if (!tfa98xx_handle_is_open(handle))
+        return Tfa98xx_Error_NotOpen;
+    h = &handlesLocal[handle];
+
+    tfa98xx_lock(handle);
+    for (i = 0; i < TFA98XX_BIQUAD_NUM; i++) {
+        if (!paramCacheEnabled || !(h->biquadValid & (1 << i)) ||
+                memcmp(h->biquadBank + i * size, bytes + i * size, size)) {
+            changed++;
+            last = i;
+        }
+    }
+    if (changed == 1)
+        error = tfa98xx_dsp_set_param(handle, MODULE_BIQUADFILTERBANK,
+                        (unsigned char)(last + 1), size, bytes + last * size);
+    else if (changed > 1)
+        error = tfa98xx_dsp_set_param(handle, MODULE_BIQUADFILTERBANK,
+                        0 /* program all at once */ ,
+                        size * TFA98XX_BIQUAD_NUM, bytes);
+    /* the generic slave has no ack, so it is not known what the DSPs have */
+    if (error == Tfa98xx_Error_Ok && h->slave_address != TFA98XX_GENERIC_SLAVE_ADDRESS) {
+        memcpy(h->biquadBank, bytes, size * TFA98XX_BIQUAD_NUM);
+        h->biquadValid = (1 << TFA98XX_BIQUAD_NUM) - 1;
+    }
+    tfa98xx_unlock(handle);
+
+    return error;
+}
+
+void tfa98xx_dsp_params_invalidate(Tfa98xx_handle_t handle)
+{
+    if (tfa98xx_handle_is_open(handle))
+        tfa98xx_dsp_forget(handle);
+}
+
 enum Tfa98xx_Error
 tfa98xx_dsp_biquad_set_coeff_bytes(Tfa98xx_handle_t handle,
                 int biquad_index,
@@ -1525,8 +1993,8 @@ tfa98xx_dsp_biquad_disable_multiple(int handle_cnt,
 }
 
 #define PATCH_HEADER_LENGTH 6
-enum Tfa98xx_Error
-tfa98xx_dsp_patch(Tfa98xx_handle_t handle, int patchLength,
+static enum Tfa98xx_Error
+tfa98xx_dsp_patch_unlocked(Tfa98xx_handle_t handle, int patchLength,
          const unsigned char *patchBytes)
 {
     enum Tfa98xx_Error error;
@@ -1543,6 +2011,62 @@ tfa98xx_dsp_patch(Tfa98xx_handle_t handle, int patchLength,
     return error;
 }
 
+enum Tfa98xx_Error
+tfa98xx_dsp_patch(Tfa98xx_handle_t handle, int patchLength,
+         const unsigned char *patchBytes)
+{
+    enum Tfa98xx_Error error;
+
+    tfa98xx_lock(handle);
+    error = tfa98xx_dsp_patch_unlocked(handle, patchLength, patchBytes);
+    tfa98xx_unlock(handle);
+
+    return error;
+}
+
+/* the same patch for all devices, written once via the generic slave
+ * address if possible */
+enum Tfa98xx_Error
+tfa98xx_dsp_patch_multiple(int handle_cnt, Tfa98xx_handle_t handles[],
+         int patchLength, const unsigned char *patchBytes)
+{
+    enum Tfa98xx_Error error = Tfa98xx_Error_Ok;
+    Tfa98xx_handle_t broadcast;
+    int i;
+
+    if (patchLength < PATCH_HEADER_LENGTH)
+        return Tfa98xx_Error_Bad_Parameter;
+
+    tfa98xx_lock_multiple(handle_cnt, handles);
+    /* the ROM check reads, so it is done on each device */
+    for (i = 0; (i < handle_cnt) && (error == Tfa98xx_Error_Ok); ++i) {
+        if (!tfa98xx_handle_is_open(handles[i]))
+            error = Tfa98xx_Error_NotOpen;
+        else
+            error = tfa98xx_check_ic_rom_version(handles[i], patchBytes);
+    }
+    if (error == Tfa98xx_Error_Ok) {
+        broadcast = tfa98xx_broadcast_open(handle_cnt, handles);
+        if (broadcast >= 0) {
+            error = tfa98xx_process_patch_file(broadcast,
+                    patchLength - PATCH_HEADER_LENGTH,
+                    patchBytes + PATCH_HEADER_LENGTH);
+            tfa98xx_broadcast_close(broadcast);
+        }
+        if (broadcast < 0 || error != Tfa98xx_Error_Ok) {
+            /* no broadcast or nobody answered it */
+            error = Tfa98xx_Error_Ok;
+            for (i = 0; (i < handle_cnt) && (error == Tfa98xx_Error_Ok); ++i)
+                error = tfa98xx_process_patch_file(handles[i],
+                        patchLength - PATCH_HEADER_LENGTH,
+                        patchBytes + PATCH_HEADER_LENGTH);
+        }
+    }
+    tfa98xx_unlock_multiple(handle_cnt, handles);
+
+    return error;
+}
+
 /* read the return code for the RPC call */
 enum Tfa98xx_Error
 tfa98xx_check_rpc_status(Tfa98xx_handle_t handle, int *pRpcStatus)
@@ -1627,6 +2151,18 @@ tfa98xx_check_size(enum Tfa98xx_DMEM which_mem, int num_bytes)
     return error;
 }
 
+/* the data bytes in the first write of a parameter, after the header,
+ * and in the writes after it: the subaddress and whole XMEM words
+ */
+static void tfa98xx_param_chunks(Tfa98xx_handle_t handle, int *first, int *next)
+{
+    int max_size = MIN(NXP_I2C_BufferSizeBus(handlesLocal[handle].bus),
+                1 + RPC_HEADER_SIZE + MAX_PARAM_SIZE);
+
+    *first = ROUND_DOWN(max_size - 1 - RPC_HEADER_SIZE, 3);
+    *next = ROUND_DOWN(max_size - 1, 3);  /* XMEM word size */
+}
+
 enum Tfa98xx_Error
 tfa98xx_write_parameter(Tfa98xx_handle_t handle,
            unsigned char module_id,
@@ -1634,7 +2170,9 @@ tfa98xx_write_parameter(Tfa98xx_handle_t handle,
            int num_bytes, const unsigned char data[])
 {
     enum Tfa98xx_Error error;
-    unsigned char buffer[7];
+    unsigned char buffer[RPC_HEADER_SIZE + MAX_PARAM_SIZE];
+    int first, next;
+    int offset, chunk_size;
 
     /* the value to be sent to the CF_CONTROLS register: cf_req=00000000,
      * cf_int=0, cf_aif=0, cf_dmem=XMEM=01, cf_rst_dsp=0 */
@@ -1642,51 +2180,94 @@ tfa98xx_write_parameter(Tfa98xx_handle_t handle,
     /* memory address to be accessed (0 : Status, 1 : ID, 2 : parameters)*/
     unsigned short cf_mad = 0x0001;
 
+    if (!tfa98xx_handle_is_open(handle))
+        return Tfa98xx_Error_NotOpen;
     error = tfa98xx_check_size(Tfa98xx_DMEM_XMEM, num_bytes);
     if (error == Tfa98xx_Error_Ok) {
         if ((num_bytes <= 0) || (num_bytes > MAX_PARAM_SIZE))
             error = Tfa98xx_Error_Bad_Parameter;
     }
+    if (error != Tfa98xx_Error_Ok)
+        return error;
 
+    tfa98xx_param_chunks(handle, &first, &next);
+
+    /* minimize the number of I2C transactions by making use of
+     * the autoincrement in I2C: the header and as much of the data
+     * as fits go in one write */
+
+    /* first the data for CF_CONTROLS */
+    buffer[0] = (unsigned char)((cf_ctrl >> 8) & 0xFF);
+    buffer[1] = (unsigned char)(cf_ctrl & 0xFF);
+    /* write the contents of CF_MAD which is the subaddress
+     * following CF_CONTROLS */
+    buffer[2] = (unsigned char)((cf_mad >> 8) & 0xFF);
+    buffer[3] = (unsigned char)(cf_mad & 0xFF);
+    /* write the module and RPC id into CF_MEM, which
+     * follows CF_MAD */
+    buffer[4] = 0;
+    buffer[5] = module_id + 128;
+    buffer[6] = param_id;
+    chunk_size = MIN(num_bytes, first);
+    memcpy(buffer + RPC_HEADER_SIZE, data, chunk_size);
+    error =
+        tfa98xx_write_data(handle, TFA98XX_CF_CONTROLS,
+                  RPC_HEADER_SIZE + chunk_size, buffer);
+    offset = chunk_size;
 
-        /* minimize the number of I2C transactions by making use of
-         * the autoincrement in I2C */
-
-        /* first the data for CF_CONTROLS */
-        buffer[0] = (unsigned char)((cf_ctrl >> 8) & 0xFF);
-        buffer[1] = (unsigned char)(cf_ctrl & 0xFF);
-        /* write the contents of CF_MAD which is the subaddress
-         * following CF_CONTROLS */
-        buffer[2] = (unsigned char)((cf_mad >> 8) & 0xFF);
-        buffer[3] = (unsigned char)(cf_mad & 0xFF);
-        /* write the module and RPC id into CF_MEM, which
-         * follows CF_MAD */
-        buffer[4] = 0;
-        buffer[5] = module_id + 128;
-        buffer[6] = param_id;
+    /* due to autoincrement in cf_ctrl, next write will happen at
+     * the next address */
+    chunk_size = next;
+    while ((error == Tfa98xx_Error_Ok) && (offset < num_bytes)) {
+        if (num_bytes - offset < chunk_size)
+            chunk_size = num_bytes - offset;
+        /* else chunk_size remains at initialize value above */
         error =
-            tfa98xx_write_data(handle, TFA98XX_CF_CONTROLS,
-                      sizeof(buffer), buffer);
+            tfa98xx_write_data(handle, TFA98XX_CF_MEM,
+                      chunk_size, data + offset);
+        offset += chunk_size;
+    }
+    return error;
+}
 
+/* check that the parameter written by a broadcast is in this DSP:
+ *  read back the id and the last data word of every write of the broadcast,
+ *  cheap compared to the data
+ *  a write that this device missed is only seen when the word it left
+ *  there differs, e.g. an earlier message of the same parameter with the
+ *  same words at those places passes
+ */
+static enum Tfa98xx_Error
+tfa98xx_verify_parameter(Tfa98xx_handle_t handle,
+           unsigned char module_id,
+           unsigned char param_id,
+           int num_bytes, const unsigned char data[])
+{
+    enum Tfa98xx_Error error;
+    int first, next, offset, chunk_size, word;
+    int id, value, expect;
 
-    if (error == Tfa98xx_Error_Ok) {
-        int offset = 0;
-        int chunk_size =
-            ROUND_DOWN(NXP_I2C_BufferSize(), 3);  /* XMEM word size */
-        int remaining_bytes = num_bytes;
-        /* due to autoincrement in cf_ctrl, next write will happen at
-         * the next address */
-        while ((error == Tfa98xx_Error_Ok) && (remaining_bytes > 0)) {
-            if (remaining_bytes < chunk_size)
-                chunk_size = remaining_bytes;
-            /* else chunk_size remains at initialize value above */
-            error =
-                tfa98xx_write_data(handle, TFA98XX_CF_MEM,
-                          chunk_size, data + offset);
-            remaining_bytes -= chunk_size;
-            offset += chunk_size;
-        }
+    error = tfa98xx_dsp_read_mem(handle, 1, 1, &id);
+    if (error == Tfa98xx_Error_Ok && id != (((module_id + 128) << 8) | param_id))
+        error = Tfa98xx_Error_DSP_not_running;
+
+    /* the same writes as tfa98xx_write_parameter() on this bus */
+    tfa98xx_param_chunks(handle, &first, &next);
+    chunk_size = first;
+    for (offset = 0; error == Tfa98xx_Error_Ok && offset < num_bytes; offset += chunk_size) {
+        if (offset)
+            chunk_size = next;
+        if (num_bytes - offset < chunk_size)
+            chunk_size = num_bytes - offset;
+        word = (offset + chunk_size) / 3 - 1; /* the last one of the write */
+        if (word < 0)
+            break;
+        error = tfa98xx_dsp_read_mem(handle, 2 + word, 1, &value);
+        tfa98xx_convert_bytes2data(3, data + word * 3, &expect);
+        if (error == Tfa98xx_Error_Ok && value != expect)
+            error = Tfa98xx_Error_DSP_not_running;
     }
+
     return error;
 }
 
@@ -1707,7 +2288,29 @@ tfa98xx_wait_result(Tfa98xx_handle_t handle, int waitRetryCount)
     enum Tfa98xx_Error error;
     unsigned short cf_status; /* the contents of the CF_STATUS register */
     int tries = 0;
+    int irq = rpcIrqEnabled && NXP_I2C_GetIrq() >= 0;
+    int delay = 0;
+    if (irq) {
+        /* clear the ACK interrupt of the previous RPC, an ACK that is
+         * already there is seen by the first status read */
+        error = tfa98xx_write_register16(handle, TFA98XX_INTERRUPT_IN_REG3,
+                       1 << TFA98XX_INTERRUPT_IN_REG3_INTIACK_POS); /* ack, not err */
+        if (error != Tfa98xx_Error_Ok)
+            return error;
+    }
     do {
+        if (tries) {
+            /* don't hammer the bus with status reads */
+            if (irq) {
+                if (NXP_I2C_WaitIrq(TFA98XX_WAITRESULT_IRQ_US) != 1)
+                    irq = 0; /* no interrupt, poll from now on */
+            } else if (tries >= TFA98XX_WAITRESULT_SPIN) {
+                delay = delay ? 2*delay : TFA98XX_WAITRESULT_BACKOFF_US;
+                if (delay > TFA98XX_WAITRESULT_BACKOFF_MAX_US)
+                    delay = TFA98XX_WAITRESULT_BACKOFF_MAX_US;
+                NXP_I2C_WaitIrq(delay);
+            }
+        }
         error =
             tfa98xx_read_register16(handle, TFA98XX_CF_STATUS,
                        &cf_status);
@@ -1724,16 +2327,20 @@ tfa98xx_wait_result(Tfa98xx_handle_t handle, int waitRetryCount)
 }
 
 /* Execute RPC protocol to write something to the DSP */
-enum Tfa98xx_Error
-tfa98xx_dsp_set_param_var_wait(Tfa98xx_handle_t handle,
+static enum Tfa98xx_Error
+tfa98xx_dsp_set_param_var_wait_unlocked(Tfa98xx_handle_t handle,
                unsigned char module_id,
                unsigned char param_id, int num_bytes,
                const unsigned char data[], int waitRetryCount)
 {
     enum Tfa98xx_Error error;
     int rpcStatus = STATUS_OK;
+    int slot = tfa98xx_param_slot(module_id, param_id);
     if (!tfa98xx_handle_is_open(handle))
         return Tfa98xx_Error_NotOpen;
+    if (tfa98xx_param_resident(handle, slot, num_bytes, data))
+        return Tfa98xx_Error_Ok; /* the DSP has it already */
+    tfa98xx_param_forget(handle, module_id);
     /* 1) write the id and data to the DSP XMEM */
     error = tfa98xx_write_parameter(handle, module_id, param_id, num_bytes, data);
     /* 2) wake up the DSP and let it process the data */
@@ -1756,10 +2363,27 @@ tfa98xx_dsp_set_param_var_wait(Tfa98xx_handle_t handle,
                                Tfa98xx_Error_RpcBase);
             }
         }
+        if (error == Tfa98xx_Error_Ok)
+            tfa98xx_param_loaded(handle, slot, num_bytes, data);
     }
     return error;
 }
 
+enum Tfa98xx_Error
+tfa98xx_dsp_set_param_var_wait(Tfa98xx_handle_t handle,
+               unsigned char module_id,
+               unsigned char param_id, int num_bytes,
+               const unsigned char data[], int waitRetryCount)
+{
+    enum Tfa98xx_Error error;
+
+    tfa98xx_lock(handle);
+    error = tfa98xx_dsp_set_param_var_wait_unlocked(handle, module_id, param_id, num_bytes, data, waitRetryCount);
+    tfa98xx_unlock(handle);
+
+    return error;
+}
+
 /* Execute RPC protocol to write something to the DSP */
 enum Tfa98xx_Error
 tfa98xx_dsp_set_param(Tfa98xx_handle_t handle,
@@ -1776,8 +2400,8 @@ tfa98xx_dsp_set_param(Tfa98xx_handle_t handle,
 /* Execute RPC protocol to write something to all the DSPs interleaved,
  * stop at the first error. optimized to minimize the latency between the
  * execution point on the various DSPs */
-enum Tfa98xx_Error
-tfa98xx_dsp_set_param_multiple_var_wait(int handle_cnt,
+static enum Tfa98xx_Error
+tfa98xx_dsp_set_param_multiple_var_wait_unlocked(int handle_cnt,
                    Tfa98xx_handle_t handles[],
                    unsigned char module_id,
                    unsigned char param_id,
@@ -1785,16 +2409,35 @@ tfa98xx_dsp_set_param_multiple_var_wait(int handle_cnt,
                    int waitRetryCount)
 {
     enum Tfa98xx_Error error = Tfa98xx_Error_Ok;
-    int i;
+    Tfa98xx_handle_t broadcast;
+    int i, resident = 0;
     int rpcStatus = STATUS_OK;
+    int slot = tfa98xx_param_slot(module_id, param_id);
     for (i = 0; i < handle_cnt; ++i) {
         if (!tfa98xx_handle_is_open(handles[i]))
             return Tfa98xx_Error_NotOpen;
+        resident += tfa98xx_param_resident(handles[i], slot, num_bytes, data);
     }
+    if (resident == handle_cnt)
+        return Tfa98xx_Error_Ok; /* all DSPs have it already */
+    for (i = 0; i < handle_cnt; ++i)
+        tfa98xx_param_forget(handles[i], module_id);
     /* from here onward, any error will fall through without executing the
      * following for loops */
-    /* 1) write the id and data to the DSP XMEM */
+    /* 1) write the id and data to the DSP XMEM
+     *  once for all via the generic slave address if possible, then only
+     *  to the devices that don't have it */
+    broadcast = tfa98xx_broadcast_open(handle_cnt, handles);
+    if (broadcast >= 0) {
+        if (tfa98xx_write_parameter(broadcast, module_id, param_id, num_bytes,
+                   data) != Tfa98xx_Error_Ok)
+            broadcast = -1; /* nobody answered, write them one by one */
+        tfa98xx_broadcast_close(BROADCAST_HANDLE);
+    }
     for (i = 0; (i < handle_cnt) && (error == Tfa98xx_Error_Ok); ++i) {
+        if (broadcast >= 0 && tfa98xx_verify_parameter(handles[i], module_id,
+                   param_id, num_bytes, data) == Tfa98xx_Error_Ok)
+            continue;
         error =
             tfa98xx_write_parameter(handles[i], module_id, param_id, num_bytes,
                    data);
@@ -1818,10 +2461,30 @@ tfa98xx_dsp_set_param_multiple_var_wait(int handle_cnt,
             /* stop at first error */
             return error;
         }
+        if (error == Tfa98xx_Error_Ok)
+            tfa98xx_param_loaded(handles[i], slot, num_bytes, data);
     }
     return error;
 }
 
+enum Tfa98xx_Error
+tfa98xx_dsp_set_param_multiple_var_wait(int handle_cnt,
+                   Tfa98xx_handle_t handles[],
+                   unsigned char module_id,
+                   unsigned char param_id,
+                   int num_bytes, const unsigned char data[],
+                   int waitRetryCount)
+{
+    enum Tfa98xx_Error error;
+
+    tfa98xx_lock_multiple(handle_cnt, handles);
+    error = tfa98xx_dsp_set_param_multiple_var_wait_unlocked(handle_cnt, handles,
+                   module_id, param_id, num_bytes, data, waitRetryCount);
+    tfa98xx_unlock_multiple(handle_cnt, handles);
+
+    return error;
+}
+
 /* Execute RPC protocol to write something to all the DSPs interleaved,
  * stop at the first error
  * optimized to minimize the latency between the execution point on the
@@ -1841,8 +2504,87 @@ tfa98xx_dsp_set_param_multiple(int handle_cnt,
                           TFA98XX_WAITRESULT_NTRIES);
 }
 
+/* nr of CF_MEM bursts that are queued in one I2C batch */
+#define STREAM_BATCH_BURSTS 8
+
+/*
+ * read num_bytes of DSP memory from start_offset on in bursts of the
+ *  largest transaction the bus allows; the CF_CONTROLS and CF_MAD writes go
+ *  in the first batch, cf_ctrl < 0 or the value CF_CONTROLS has already
+ *  leaves CF_CONTROLS as it is
+ */
+static enum Tfa98xx_Error
+tfa98xx_dsp_stream_bytes_unlocked(Tfa98xx_handle_t handle, int cf_ctrl,
+           unsigned short start_offset, int num_bytes, int bytes_per_word,
+           unsigned char *bytes)
+{
+    enum NXP_I2C_Error i2c_error;
+    unsigned char ctrl_data[3], mad_data[3];
+    const unsigned char mem_subaddress = TFA98XX_CF_MEM;
+    NXP_I2C_Msg_t msgs[2 + STREAM_BATCH_BURSTS];
+    int burst_size, num_msgs = 0, bursts;
+
+    if (!tfa98xx_handle_is_open(handle))
+        return Tfa98xx_Error_NotOpen;
+    burst_size = ROUND_DOWN(NXP_I2C_BufferSizeBus(handlesLocal[handle].bus), bytes_per_word);
+    if (num_bytes < 0 || burst_size <= 0)
+        return Tfa98xx_Error_Bad_Parameter;
+
+    if (cf_ctrl == handlesLocal[handle].cfCtrl)
+        cf_ctrl = -1;
+    if (cf_ctrl >= 0) {
+        ctrl_data[0] = TFA98XX_CF_CONTROLS;
+        ctrl_data[1] = (cf_ctrl >> 8) & 0xFF;
+        ctrl_data[2] = cf_ctrl & 0xFF;
+        msgs[num_msgs].sla = handlesLocal[handle].slave_address;
+        msgs[num_msgs].num_write_bytes = 3;
+        msgs[num_msgs].write_data = ctrl_data;
+        msgs[num_msgs].num_read_bytes = 0;
+        msgs[num_msgs].read_buffer = NULL;
+        num_msgs++;
+    }
+    mad_data[0] = TFA98XX_CF_MAD;
+    mad_data[1] = (start_offset >> 8) & 0xFF;
+    mad_data[2] = start_offset & 0xFF;
+    msgs[num_msgs].sla = handlesLocal[handle].slave_address;
+    msgs[num_msgs].num_write_bytes = 3;
+    msgs[num_msgs].write_data = mad_data;
+    msgs[num_msgs].num_read_bytes = 0;
+    msgs[num_msgs].read_buffer = NULL;
+    num_msgs++;
+
+    do {
+        /* the CF_MEM address autoincrements over the bursts */
+        for (bursts = 0; num_bytes > 0 && bursts < STREAM_BATCH_BURSTS; bursts++) {
+            int size = MIN(num_bytes, burst_size);
+            msgs[num_msgs].sla = handlesLocal[handle].slave_address;
+            msgs[num_msgs].num_write_bytes = 1;
+            msgs[num_msgs].write_data = &mem_subaddress;
+            msgs[num_msgs].num_read_bytes = size;
+            msgs[num_msgs].read_buffer = bytes;
+            num_msgs++;
+            bytes += size;
+            num_bytes -= size;
+        }
+
+        i2c_error = NXP_I2C_BatchBus(handlesLocal[handle].bus, num_msgs, msgs);
+        if (i2c_error != NXP_I2C_Ok) {
+            if (cf_ctrl >= 0)
+                tfa98xx_shadow_clear(handle, TFA98XX_CF_CONTROLS, 1);
+            return tfa98xx_classify_i2c_error(i2c_error);
+        }
+        if (cf_ctrl >= 0)
+            tfa98xx_cf_ctrl_set(handle, cf_ctrl);
+        /* next batch only has bursts */
+        num_msgs = 0;
+        cf_ctrl = -1;
+    } while (num_bytes > 0);
+
+    return Tfa98xx_Error_Ok;
+}
+
 /* Execute RPC protocol to read something from the DSP */
-enum Tfa98xx_Error tfa98xx_dsp_get_param(Tfa98xx_handle_t handle,
+static enum Tfa98xx_Error tfa98xx_dsp_get_param_unlocked(Tfa98xx_handle_t handle,
             unsigned char module_id,
             unsigned char param_id,
             int num_bytes, unsigned char data[])
@@ -1853,8 +2595,6 @@ enum Tfa98xx_Error tfa98xx_dsp_get_param(Tfa98xx_handle_t handle,
     unsigned short cf_ctrl = 0x0002;
     /* memory address to be accessed (0 : Status, 1 : ID, 2 : parameters)*/
     unsigned short cf_mad = 0x0001;
-    /* the contents of the CF_STATUS register */
-    unsigned short cf_status;
     int rpcStatus = STATUS_OK;
 
     if (!tfa98xx_handle_is_open(handle))
@@ -1899,24 +2639,10 @@ enum Tfa98xx_Error tfa98xx_dsp_get_param(Tfa98xx_handle_t handle,
     }
 
     /* 3) wait for the ack */
-    if (error == Tfa98xx_Error_Ok) {
-        int tries = 0;
-        do {
-            error = tfa98xx_read_register16(handle, TFA98XX_CF_STATUS, &cf_status);
-            tries++;
-        }
-
-        /* don't wait forever, DSP is pretty quick to respond (< 1ms)*/
-        while ((error == Tfa98xx_Error_Ok)
-            && ((cf_status & 0x0100) == 0)
-            && (tries < TFA98XX_WAITRESULT_NTRIES))
-            ;
-
-        if (tries >= TFA98XX_WAITRESULT_NTRIES) {
-            /* something wrong with communication with DSP */
-            return Tfa98xx_Error_DSP_not_running;
-        }
-    }
+    if (error == Tfa98xx_Error_Ok)
+        error = tfa98xx_wait_result(handle, TFA98XX_WAITRESULT_NTRIES);
+    if (error == Tfa98xx_Error_DSP_not_running)
+        return error;
 
     /* 4) check the RPC return value */
     if (error == Tfa98xx_Error_Ok)
@@ -1934,51 +2660,25 @@ enum Tfa98xx_Error tfa98xx_dsp_get_param(Tfa98xx_handle_t handle,
         /* memory address to be accessed (0: Status,
          * 1: ID, 2: parameters) */
         cf_mad = 0x0002;
-        error = tfa98xx_write_register16(handle, TFA98XX_CF_MAD, cf_mad);
-    }
-
-    if (error == Tfa98xx_Error_Ok) {
-        int offset = 0;
-        int chunk_size = ROUND_DOWN(NXP_I2C_BufferSize(), 3 /* XMEM word size */ );
-        int remaining_bytes = num_bytes;
-        /* due to autoincrement in cf_ctrl, next write will happen at
-         * the next address */
-        while ((error == Tfa98xx_Error_Ok) && (remaining_bytes > 0)) {
-            if (remaining_bytes < NXP_I2C_BufferSize())
-                chunk_size = remaining_bytes;
-
-            /* else chunk_size remains at initialize value above */
-            error = tfa98xx_read_data(handle, TFA98XX_CF_MEM, chunk_size, data + offset);
-            remaining_bytes -= chunk_size;
-            offset += chunk_size;
-        }
+        error = tfa98xx_dsp_stream_bytes_unlocked(handle, -1, cf_mad,
+                        num_bytes, 3 /* XMEM word size */, data);
     }
 
     return error;
 }
 
-/**
- convert memory bytes to signed 24 bit integers
-   input:  bytes contains "num_bytes" byte elements
-   output: data contains "num_bytes/3" int24 elements
-*/
-void tfa98xx_convert_bytes2data(int num_bytes, const unsigned char bytes[],
-                   int data[])
+enum Tfa98xx_Error tfa98xx_dsp_get_param(Tfa98xx_handle_t handle,
+            unsigned char module_id,
+            unsigned char param_id,
+            int num_bytes, unsigned char data[])
 {
-    int i;            /* index for data */
-    int k;            /* index for bytes */
-    int d;
-    int num_data = num_bytes / 3;
-    _ASSERT((num_bytes % 3) == 0);
-    for (i = 0, k = 0; i < num_data; ++i, k += 3) {
-        d = (bytes[k] << 16) | (bytes[k + 1] << 8) | (bytes[k + 2]);
-        _ASSERT(d >= 0);
-        _ASSERT(d < (1 << 24));    /* max 24 bits in use */
-        if (bytes[k] & 0x80)    /* sign bit was set */
-            d = -((1 << 24) - d);
+    enum Tfa98xx_Error error;
 
-        data[i] = d;
-    }
+    tfa98xx_lock(handle);
+    error = tfa98xx_dsp_get_param_unlocked(handle, module_id, param_id, num_bytes, data);
+    tfa98xx_unlock(handle);
+
+    return error;
 }
 
 enum Tfa98xx_Error
@@ -2087,60 +2787,169 @@ tfa98xx_dsp_set_calibration_impedance(Tfa98xx_handle_t handle, const unsigned ch
     return error;
 }
 
-enum Tfa98xx_Error
-tfa98xx_dsp_read_mem(Tfa98xx_handle_t handle,
-           unsigned short start_offset, int num_words, int *pValues)
+/* the bytes of a DSP word, PMEM is 32 bit */
+static int tfa98xx_dsp_word_size(enum Tfa98xx_DMEM which_mem)
 {
-    enum Tfa98xx_Error error = Tfa98xx_Error_Ok;
-    unsigned short cf_ctrl;    /* to sent to the CF_CONTROLS register */
-    unsigned char bytes[MAX_PARAM_SIZE];
-    int burst_size;        /* number of words per burst size */
-    int bytes_per_word = 3;
-    int num_bytes;
-    int *p;
-    /* first set DMEM and AIF, leaving other bits intact */
-    error = tfa98xx_read_register16(handle, TFA98XX_CF_CONTROLS, &cf_ctrl);
+    return (which_mem == Tfa98xx_DMEM_PMEM) ? 4 : 3;
+}
+
+/* set DMEM, leave AIF cleared for autoincrement and the other bits intact */
+static enum Tfa98xx_Error
+tfa98xx_dsp_stream_ctrl(Tfa98xx_handle_t handle, enum Tfa98xx_DMEM which_mem,
+           unsigned short *pCf_ctrl)
+{
+    enum Tfa98xx_Error error;
+
+    error = tfa98xx_read_register16(handle, TFA98XX_CF_CONTROLS, pCf_ctrl);
     if (error != Tfa98xx_Error_Ok)
         return error;
+    *pCf_ctrl &= ~0x000E;    /* clear AIF & DMEM */
+    *pCf_ctrl |= (which_mem << 1);
+    return Tfa98xx_Error_Ok;
+}
 
-    cf_ctrl &= ~0x000E;    /* clear AIF & DMEM */
-    /* set DMEM, leave AIF cleared for autoincrement */
-    cf_ctrl |= (Tfa98xx_DMEM_XMEM << 1);
-    error = tfa98xx_write_register16(handle, TFA98XX_CF_CONTROLS, cf_ctrl);
+static enum Tfa98xx_Error
+tfa98xx_dsp_stream_read_unlocked(Tfa98xx_handle_t handle,
+           enum Tfa98xx_DMEM which_mem, unsigned short start_offset,
+           int num_words, int *pValues)
+{
+    enum Tfa98xx_Error error;
+    unsigned short cf_ctrl;    /* to sent to the CF_CONTROLS register */
+    int bytes_per_word = tfa98xx_dsp_word_size(which_mem);
+    unsigned char *bytes;
+    int i;
+
+    error = tfa98xx_check_size(which_mem, num_words * bytes_per_word);
+    if (error != Tfa98xx_Error_Ok)
+        return error;
+    error = tfa98xx_dsp_stream_ctrl(handle, which_mem, &cf_ctrl);
     if (error != Tfa98xx_Error_Ok)
         return error;
 
-    error = tfa98xx_write_register16(handle, TFA98XX_CF_MAD, start_offset);
+    /* the bytes are read into the end of pValues and converted from the
+     * start on, a word is never overwritten before it has been converted */
+    bytes = (unsigned char *)pValues + num_words * (sizeof(int) - bytes_per_word);
+    error = tfa98xx_dsp_stream_bytes_unlocked(handle, cf_ctrl, start_offset,
+                    num_words * bytes_per_word, bytes_per_word, bytes);
     if (error != Tfa98xx_Error_Ok)
         return error;
 
-    num_bytes = num_words * bytes_per_word;
-    p = pValues;
-    for (; num_bytes > 0;) {
-        burst_size = ROUND_DOWN(NXP_I2C_BufferSize(), bytes_per_word);
-        if (num_bytes < burst_size)
-            burst_size = num_bytes;
+    if (bytes_per_word == 3)
+        tfa98xx_convert_bytes2data(num_words * 3, bytes, pValues);
+    else
+        for (i = 0; i < num_words; i++, bytes += bytes_per_word)
+            pValues[i] = (bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
 
-        _ASSERT(burst_size <= sizeof(bytes));
-        error =
-            tfa98xx_read_data(
-            handle, TFA98XX_CF_MEM, burst_size, bytes);
+    return Tfa98xx_Error_Ok;
+}
+
+static enum Tfa98xx_Error
+tfa98xx_dsp_stream_write_unlocked(Tfa98xx_handle_t handle,
+           enum Tfa98xx_DMEM which_mem, unsigned short start_offset,
+           int num_words, const int *pValues)
+{
+    enum Tfa98xx_Error error;
+    unsigned short cf_ctrl;    /* to sent to the CF_CONTROLS register */
+    int bytes_per_word = tfa98xx_dsp_word_size(which_mem);
+    unsigned char buffer[TFA98XX_MAX_WRITE_DATA];
+    /* a transaction is the subaddress and whole words */
+    int max_size = MIN(NXP_I2C_BufferSizeBus(handlesLocal[handle].bus),
+                    1 + TFA98XX_MAX_WRITE_DATA) - 1;
+    unsigned char subaddress = TFA98XX_CF_CONTROLS;
+    int header = 4, i;
+
+    error = tfa98xx_check_size(which_mem, num_words * bytes_per_word);
+    if (error != Tfa98xx_Error_Ok)
+        return error;
+    if (num_words <= 0 || max_size < header + bytes_per_word)
+        return Tfa98xx_Error_Bad_Parameter;
+    error = tfa98xx_dsp_stream_ctrl(handle, which_mem, &cf_ctrl);
+    if (error != Tfa98xx_Error_Ok)
+        return error;
+
+    /* CF_CONTROLS, CF_MAD and the first words go in one write,
+     * it starts at CF_MAD if CF_CONTROLS has the value already */
+    if (cf_ctrl == handlesLocal[handle].cfCtrl) {
+        subaddress = TFA98XX_CF_MAD;
+        header = 2;
+    } else {
+        buffer[0] = (cf_ctrl >> 8) & 0xFF;
+        buffer[1] = cf_ctrl & 0xFF;
+    }
+    buffer[header - 2] = (start_offset >> 8) & 0xFF;
+    buffer[header - 1] = start_offset & 0xFF;
+    while (num_words > 0) {
+        int chunk_words = MIN(num_words, (max_size - header) / bytes_per_word);
+        unsigned char *p = buffer + header;
+
+        for (i = 0; i < chunk_words; i++, p += bytes_per_word) {
+            if (bytes_per_word == 4) {
+                p[0] = (pValues[i] >> 24) & 0xFF;
+                p[1] = (pValues[i] >> 16) & 0xFF;
+                p[2] = (pValues[i] >> 8) & 0xFF;
+                p[3] = pValues[i] & 0xFF;
+            } else
+                tfa98xx_convert_data2bytes(1, &pValues[i], p);
+        }
+        error = tfa98xx_write_data(handle, subaddress, (int)(p - buffer), buffer);
         if (error != Tfa98xx_Error_Ok)
             return error;
 
-        tfa98xx_convert_bytes2data(burst_size, bytes, p);
-        num_bytes -= burst_size;
-        p += burst_size / bytes_per_word;
+        /* the CF_MEM address autoincrements over the writes */
+        pValues += chunk_words;
+        num_words -= chunk_words;
+        subaddress = TFA98XX_CF_MEM;
+        header = 0;
     }
+
     return Tfa98xx_Error_Ok;
 }
 
 enum Tfa98xx_Error
-tfa98xx_dsp_write_mem(Tfa98xx_handle_t handle, unsigned short address, int value, int memtype)
+tfa98xx_dsp_stream_read(Tfa98xx_handle_t handle, enum Tfa98xx_DMEM which_mem,
+           unsigned short start_offset, int num_words, int *pValues)
+{
+    enum Tfa98xx_Error error;
+
+    tfa98xx_lock(handle);
+    error = tfa98xx_dsp_stream_read_unlocked(handle, which_mem, start_offset, num_words, pValues);
+    tfa98xx_unlock(handle);
+
+    return error;
+}
+
+enum Tfa98xx_Error
+tfa98xx_dsp_stream_write(Tfa98xx_handle_t handle, enum Tfa98xx_DMEM which_mem,
+           unsigned short start_offset, int num_words, const int *pValues)
+{
+    enum Tfa98xx_Error error;
+
+    tfa98xx_lock(handle);
+    error = tfa98xx_dsp_stream_write_unlocked(handle, which_mem, start_offset, num_words, pValues);
+    tfa98xx_unlock(handle);
+
+    return error;
+}
+
+enum Tfa98xx_Error
+tfa98xx_dsp_read_mem(Tfa98xx_handle_t handle,
+           unsigned short start_offset, int num_words, int *pValues)
+{
+    enum Tfa98xx_Error error;
+
+    tfa98xx_lock(handle);
+    error = tfa98xx_dsp_stream_read_unlocked(handle, Tfa98xx_DMEM_XMEM, start_offset, num_words, pValues);
+    tfa98xx_unlock(handle);
+
+    return error;
+}
+
+static enum Tfa98xx_Error
+tfa98xx_dsp_write_mem_unlocked(Tfa98xx_handle_t handle, unsigned short address, int value, int memtype)
 {
     enum Tfa98xx_Error error = Tfa98xx_Error_Ok;
     unsigned short cf_ctrl;    /* to send to the CF_CONTROLS register */
-    unsigned char bytes[3];
+    unsigned char bytes[2 + 3];
     /* first set DMEM and AIF, leaving other bits intact */
     error = tfa98xx_read_register16(handle, TFA98XX_CF_CONTROLS, &cf_ctrl);
     if (error != Tfa98xx_Error_Ok)
@@ -2164,24 +2973,38 @@ tfa98xx_dsp_write_mem(Tfa98xx_handle_t handle, unsigned short address, int value
                 break;
     }
 
-    error = tfa98xx_write_register16(handle, TFA98XX_CF_CONTROLS, cf_ctrl);
-    if (error != Tfa98xx_Error_Ok)
-        return error;
-    error = tfa98xx_write_register16(handle, TFA98XX_CF_MAD, address);
-    if (error != Tfa98xx_Error_Ok)
-        return error;
+    if (cf_ctrl != handlesLocal[handle].cfCtrl) {
+        error = tfa98xx_write_register16(handle, TFA98XX_CF_CONTROLS, cf_ctrl);
+        if (error != Tfa98xx_Error_Ok)
+            return error;
+    }
 
-    tfa98xx_convert_data2bytes(1, &value, bytes);
-    error = tfa98xx_write_data(handle, TFA98XX_CF_MEM, 3, bytes);
+    /* CF_MEM follows CF_MAD, the address and the word go in one write */
+    bytes[0] = (address >> 8) & 0xFF;
+    bytes[1] = address & 0xFF;
+    tfa98xx_convert_data2bytes(1, &value, bytes + 2);
+    error = tfa98xx_write_data(handle, TFA98XX_CF_MAD, sizeof(bytes), bytes);
     if (error != Tfa98xx_Error_Ok)
         return error;
 
     return Tfa98xx_Error_Ok;
 }
 
-/* Execute generic RPC protocol that has both input and output parameters */
 enum Tfa98xx_Error
-tfa98xx_dsp_execute_rpc(Tfa98xx_handle_t handle,
+tfa98xx_dsp_write_mem(Tfa98xx_handle_t handle, unsigned short address, int value, int memtype)
+{
+    enum Tfa98xx_Error error;
+
+    tfa98xx_lock(handle);
+    error = tfa98xx_dsp_write_mem_unlocked(handle, address, value, memtype);
+    tfa98xx_unlock(handle);
+
+    return error;
+}
+
+/* Execute generic RPC protocol that has both input and output parameters */
+static enum Tfa98xx_Error
+tfa98xx_dsp_execute_rpc_unlocked(Tfa98xx_handle_t handle,
               unsigned char module_id,
               unsigned char param_id, int num_inbytes,
               unsigned char indata[], int num_outbytes,
@@ -2189,7 +3012,6 @@ tfa98xx_dsp_execute_rpc(Tfa98xx_handle_t handle,
 {
     enum Tfa98xx_Error error;
     int rpcStatus = STATUS_OK;
-    int i;
 
     if (!tfa98xx_handle_is_open(handle))
         return Tfa98xx_Error_NotOpen;
@@ -2217,23 +3039,22 @@ tfa98xx_dsp_execute_rpc(Tfa98xx_handle_t handle,
     }
 
     /* 5) read the resulting data */
-    error = tfa98xx_write_register16(handle, TFA98XX_CF_MAD, 2 /*start_offset */ );
-
-    if (error != Tfa98xx_Error_Ok)
-        return error;
-
-    /* read in chunks, limited by max I2C length */
-    for (i = 0; i < num_outbytes;) {
-        int burst_size = ROUND_DOWN(NXP_I2C_BufferSize(), 3);  /*bytes_per_word */
-        if ((num_outbytes - i) < burst_size)
-            burst_size = num_outbytes - i;
+    return tfa98xx_dsp_stream_bytes_unlocked(handle, -1, 2 /*start_offset */,
+                    num_outbytes, 3 /*bytes_per_word */, outdata);
+}
 
-        error = tfa98xx_read_data(handle, TFA98XX_CF_MEM, burst_size, outdata + i);
-        if (error != Tfa98xx_Error_Ok)
-            return error;
+enum Tfa98xx_Error
+tfa98xx_dsp_execute_rpc(Tfa98xx_handle_t handle,
+              unsigned char module_id,
+              unsigned char param_id, int num_inbytes,
+              unsigned char indata[], int num_outbytes,
+              unsigned char outdata[])
+{
+    enum Tfa98xx_Error error;
 
-        i += burst_size;
-    }
+    tfa98xx_lock(handle);
+    error = tfa98xx_dsp_execute_rpc_unlocked(handle, module_id, param_id, num_inbytes, indata, num_outbytes, outdata);
+    tfa98xx_unlock(handle);
 
     return error;
 }
@@ -2248,9 +3069,20 @@ tfa98xx_dsp_read_memory(Tfa98xx_handle_t handle, enum Tfa98xx_DMEM which_mem,
     unsigned char input_bytes[3 * 3];
     unsigned char output_bytes[80 * 3];
 
-    /* want to read all in 1 RPC call, so limit the max size */
-    if (num_words > 80)
-        return Tfa98xx_Error_Bad_Parameter;
+    /* one RPC call takes at most 80 words, 24 bit memory beyond that is
+     * streamed directly, PMEM goes in RPC calls of 80 words */
+    if (num_words > 80) {
+        if (which_mem != Tfa98xx_DMEM_PMEM)
+            return tfa98xx_dsp_stream_read(handle, which_mem, start_offset,
+                            num_words, pValues);
+        for (; error == Tfa98xx_Error_Ok && num_words > 0; num_words -= 80) {
+            error = tfa98xx_dsp_read_memory(handle, which_mem, start_offset,
+                            MIN(num_words, 80), pValues);
+            start_offset += 80;
+            pValues += 80;
+        }
+        return error;
+    }
 
     input[0] = which_mem;
     input[1] = start_offset;
@@ -2272,13 +3104,24 @@ enum Tfa98xx_Error tfa98xx_dsp_write_memory(Tfa98xx_handle_t handle,
                        unsigned short start_offset,
                        int num_words, int *pValues)
 {
+    enum Tfa98xx_Error error = Tfa98xx_Error_Ok;
     int output[3];
     unsigned char output_bytes[83 * 3];
     int num_bytes;
 
-    /* want to read all in 1 RPC call, so limit the max size */
-    if (num_words > 80)
-        return Tfa98xx_Error_Bad_Parameter;
+    /* one RPC call takes at most 80 words, see tfa98xx_dsp_read_memory() */
+    if (num_words > 80) {
+        if (which_mem != Tfa98xx_DMEM_PMEM)
+            return tfa98xx_dsp_stream_write(handle, which_mem, start_offset,
+                            num_words, pValues);
+        for (; error == Tfa98xx_Error_Ok && num_words > 0; num_words -= 80) {
+            error = tfa98xx_dsp_write_memory(handle, which_mem, start_offset,
+                            MIN(num_words, 80), pValues);
+            start_offset += 80;
+            pValues += 80;
+        }
+        return error;
+    }
 
     output[0] = which_mem;
     output[1] = start_offset;
@@ -2328,7 +3171,7 @@ enum Tfa98xx_Error tfa98xx_dsp_write_tables(int handle){
  *  The functions will return immediately and do not not wait for DSP reponse.
  */
 #define MAX_WORDS (300)
-enum Tfa98xx_Error tfa98xx_dsp_msg(int handle, int length, const char *buf, int *msg_status){
+static enum Tfa98xx_Error tfa98xx_dsp_msg_unlocked(int handle, int length, const char *buf, int *msg_status){
     enum Tfa98xx_Error error;
     int tries;
 
@@ -2346,10 +3189,20 @@ enum Tfa98xx_Error tfa98xx_dsp_msg(int handle, int length, const char *buf, int
 
     return error;
 }
-enum Tfa98xx_Error tfa98xx_dsp_msg_write(int handle, int length, const char *buf){
+
+enum Tfa98xx_Error tfa98xx_dsp_msg(int handle, int length, const char *buf, int *msg_status){
+    enum Tfa98xx_Error error;
+
+    tfa98xx_lock(handle);
+    error = tfa98xx_dsp_msg_unlocked(handle, length, buf, msg_status);
+    tfa98xx_unlock(handle);
+
+    return error;
+}
+static enum Tfa98xx_Error tfa98xx_dsp_msg_write_unlocked(int handle, int length, const char *buf){
     unsigned char buffer[2*2 + MAX_WORDS*3]; /* all data for single i2c burst */
     int offset = 0;
-    int chunk_size = ROUND_DOWN(NXP_I2C_BufferSize(), 3);  /* XMEM word size */
+    int chunk_size = ROUND_DOWN(MIN(NXP_I2C_BufferSize(), TFA98XX_MAX_WRITE_DATA), 3);  /* XMEM word size */
     int remaining_bytes = length+4;
     enum Tfa98xx_Error error = Tfa98xx_Error_Ok;
 
@@ -2379,50 +3232,41 @@ enum Tfa98xx_Error tfa98xx_dsp_msg_write(int handle, int length, const char *buf
     return error;
 }
 
-enum Tfa98xx_Error tfa98xx_dsp_msg_read(int handle,int length, unsigned char *bytes){
+enum Tfa98xx_Error tfa98xx_dsp_msg_write(int handle, int length, const char *buf){
+    enum Tfa98xx_Error error;
+
+    tfa98xx_lock(handle);
+    error = tfa98xx_dsp_msg_write_unlocked(handle, length, buf);
+    tfa98xx_unlock(handle);
+
+    return error;
+}
+
+static enum Tfa98xx_Error tfa98xx_dsp_msg_read_unlocked(int handle,int length, unsigned char *bytes){
     enum Tfa98xx_Error error = Tfa98xx_Error_Ok;
     unsigned short cf_ctrl;    /* to sent to the CF_CONTROLS register */
-    int burst_size;        /* number of words per burst size */
-    int bytes_per_word = 3;
-    int num_bytes;
-
     unsigned short start_offset=2; /* msg starts @xmem[2] ,[1]=cmd */
 
     if ( length > MAX_PARAM_SIZE)
         return Tfa98xx_Error_Bad_Parameter;
 
     /* first set DMEM and AIF, leaving other bits intact */
-    error = tfa98xx_read_register16(handle, TFA98XX_CF_CONTROLS, &cf_ctrl);
+    error = tfa98xx_dsp_stream_ctrl(handle, Tfa98xx_DMEM_XMEM, &cf_ctrl);
     if (error != Tfa98xx_Error_Ok)
         return error;
 
-    cf_ctrl &= ~0x000E;    /* clear AIF & DMEM */
-    /* set DMEM, leave AIF cleared for autoincrement */
-    cf_ctrl |= (Tfa98xx_DMEM_XMEM << 1);
-    error = tfa98xx_write_register16(handle, TFA98XX_CF_CONTROLS, cf_ctrl);
-    if (error != Tfa98xx_Error_Ok)
-        return error;
-
-    error = tfa98xx_write_register16(handle, TFA98XX_CF_MAD, start_offset);
-    if (error != Tfa98xx_Error_Ok)
-        return error;
+    return tfa98xx_dsp_stream_bytes_unlocked(handle, cf_ctrl, start_offset,
+                    length, 3 /* bytes_per_word */, bytes);
+}
 
-    num_bytes = length; /* input param */
-//    p = pValues;
-    for (; num_bytes > 0;) {
-        burst_size = ROUND_DOWN(NXP_I2C_BufferSize(), bytes_per_word);
-        if (num_bytes < burst_size)
-            burst_size = num_bytes;
-        error =
-            tfa98xx_read_data(handle, TFA98XX_CF_MEM, burst_size, bytes);
-        if (error != Tfa98xx_Error_Ok)
-            return error;
+enum Tfa98xx_Error tfa98xx_dsp_msg_read(int handle,int length, unsigned char *bytes){
+    enum Tfa98xx_Error error;
 
-//        tfa98xx_convert_bytes2data(burst_size, bytes, p);
-        num_bytes -= burst_size;
+    tfa98xx_lock(handle);
+    error = tfa98xx_dsp_msg_read_unlocked(handle, length, bytes);
+    tfa98xx_unlock(handle);
 
-    }
-    return Tfa98xx_Error_Ok;
+    return error;
 }
 
 /*
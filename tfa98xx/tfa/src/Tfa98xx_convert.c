@@ -0,0 +1,246 @@
+/*
+ *Copyright 2014 NXP Semiconductors
+ *
+ *Licensed under the Apache License, Version 2.0 (the "License");
+ *you may not use this file except in compliance with the License.
+ *You may obtain a copy of the License at
+ *
+ *http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *Unless required by applicable law or agreed to in writing, software
+ *distributed under the License is distributed on an "AS IS" BASIS,
+ *WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *See the License for the specific language governing permissions and
+ *limitations under the License.
+ */
+
+/*
+ * conversion between the 24 bit big endian DSP words and host ints
+ *  the SIMD versions are used when the CPU has them, they give the same
+ *  result as the plain C version
+ */
+
+#ifdef __KERNEL__
+#include <linux/kernel.h>
+#define _ASSERT(e) do { if ((e)) pr_err("PrintAssert:%s (%s:%d)\n",\
+        __func__, __FILE__, __LINE__); } while (0)
+#else
+#include <assert.h>
+#include <string.h>
+#define _ASSERT(e)  assert(e)
+#endif
+#include "Tfa98xx.h"
+#include "Tfa98xx_internals.h"
+
+/* no SIMD in the kernel, it would need the FPU state saved
+ * the NEON version has not run on a device yet, it is only built with
+ * -DTFA98XX_NEON, check it with tfa/test/convert_bench first */
+#if !defined(__KERNEL__) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TFA98XX_CONVERT_SSE41
+#include <smmintrin.h>
+#elif !defined(__KERNEL__) && defined(TFA98XX_NEON) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define TFA98XX_CONVERT_NEON
+#include <arm_neon.h>
+#endif
+
+static void convert_data2bytes_c(int num_data, const int data[],
+                   unsigned char bytes[])
+{
+    int i;            /* index for data */
+    int k;            /* index for bytes */
+    int d;
+    /* note: cannot just take the lowest 3 bytes from the 32 bit
+     * integer, because also need to take care of clipping any
+     * value > 2&23 */
+    for (i = 0, k = 0; i < num_data; ++i, k += 3) {
+        if (data[i] >= 0)
+            d = MIN(data[i], (1 << 23) - 1);
+        else {
+            /* 2's complement */
+            d = (1 << 24) - MIN(-data[i], 1 << 23);
+        }
+        _ASSERT(d >= 0);
+        _ASSERT(d < (1 << 24));    /* max 24 bits in use */
+        bytes[k] = (d >> 16) & 0xFF;    /* MSB */
+        bytes[k + 1] = (d >> 8) & 0xFF;
+        bytes[k + 2] = (d) & 0xFF;    /* LSB */
+    }
+}
+
+static void convert_bytes2data_c(int num_bytes, const unsigned char bytes[],
+                   int data[])
+{
+    int i;            /* index for data */
+    int k;            /* index for bytes */
+    int d;
+    int num_data = num_bytes / 3;
+    _ASSERT((num_bytes % 3) == 0);
+    for (i = 0, k = 0; i < num_data; ++i, k += 3) {
+        d = (bytes[k] << 16) | (bytes[k + 1] << 8) | (bytes[k + 2]);
+        _ASSERT(d >= 0);
+        _ASSERT(d < (1 << 24));    /* max 24 bits in use */
+        if (bytes[k] & 0x80)    /* sign bit was set */
+            d = -((1 << 24) - d);
+
+        data[i] = d;
+    }
+}
+
+#ifdef TFA98XX_CONVERT_SSE41
+/* 4 words per step, the rest goes to the C version */
+__attribute__((target("sse4.1")))
+static void convert_data2bytes_sse41(int num_data, const int data[],
+                   unsigned char bytes[])
+{
+    const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12,
+                    -1, -1, -1, -1);
+    const __m128i max = _mm_set1_epi32((1 << 23) - 1);
+    const __m128i min = _mm_set1_epi32(-(1 << 23));
+    int i, tail;
+
+    for (i = 0; i + 4 <= num_data; i += 4, bytes += 12) {
+        __m128i d = _mm_loadu_si128((const __m128i *)(data + i));
+        d = _mm_max_epi32(_mm_min_epi32(d, max), min);
+        d = _mm_shuffle_epi8(d, shuffle);
+        _mm_storel_epi64((__m128i *)bytes, d);
+        tail = _mm_extract_epi32(d, 2);
+        memcpy(bytes + 8, &tail, 4);
+    }
+    convert_data2bytes_c(num_data - i, data + i, bytes);
+}
+
+/* a 16 byte load takes 4 words and must stay inside bytes[] */
+__attribute__((target("sse4.1")))
+static void convert_bytes2data_sse41(int num_bytes, const unsigned char bytes[],
+                   int data[])
+{
+    /* the word goes to the upper 3 bytes, the shift extends the sign */
+    const __m128i shuffle = _mm_setr_epi8(-1, 2, 1, 0, -1, 5, 4, 3,
+                    -1, 8, 7, 6, -1, 11, 10, 9);
+    int k;
+
+    _ASSERT((num_bytes % 3) == 0);
+    for (k = 0; k + 16 <= num_bytes; k += 12, data += 4) {
+        __m128i b = _mm_loadu_si128((const __m128i *)(bytes + k));
+        b = _mm_srai_epi32(_mm_shuffle_epi8(b, shuffle), 8);
+        _mm_storeu_si128((__m128i *)data, b);
+    }
+    convert_bytes2data_c(num_bytes - k, bytes + k, data);
+}
+#endif
+
+#ifdef TFA98XX_CONVERT_NEON
+/* 8 words per step, the rest goes to the C version */
+static void convert_data2bytes_neon(int num_data, const int data[],
+                   unsigned char bytes[])
+{
+    const int32x4_t max = vdupq_n_s32((1 << 23) - 1);
+    const int32x4_t min = vdupq_n_s32(-(1 << 23));
+    int i;
+
+    for (i = 0; i + 8 <= num_data; i += 8, bytes += 24) {
+        int32x4_t lo = vmaxq_s32(vminq_s32(vld1q_s32(data + i), max), min);
+        int32x4_t hi = vmaxq_s32(vminq_s32(vld1q_s32(data + i + 4), max), min);
+        uint8x8x3_t b;
+
+        b.val[0] = vmovn_u16(vcombine_u16(vmovn_u32(vreinterpretq_u32_s32(vshrq_n_s32(lo, 16))),
+                        vmovn_u32(vreinterpretq_u32_s32(vshrq_n_s32(hi, 16)))));
+        b.val[1] = vmovn_u16(vcombine_u16(vmovn_u32(vreinterpretq_u32_s32(vshrq_n_s32(lo, 8))),
+                        vmovn_u32(vreinterpretq_u32_s32(vshrq_n_s32(hi, 8)))));
+        b.val[2] = vmovn_u16(vcombine_u16(vmovn_u32(vreinterpretq_u32_s32(lo)),
+                        vmovn_u32(vreinterpretq_u32_s32(hi))));
+        vst3_u8(bytes, b);
+    }
+    convert_data2bytes_c(num_data - i, data + i, bytes);
+}
+
+static void convert_bytes2data_neon(int num_bytes, const unsigned char bytes[],
+                   int data[])
+{
+    int k;
+
+    _ASSERT((num_bytes % 3) == 0);
+    for (k = 0; k + 24 <= num_bytes; k += 24, data += 8) {
+        /* MSB, middle and LSB of 8 words */
+        uint8x8x3_t b = vld3_u8(bytes + k);
+        uint16x8_t hi = vorrq_u16(vshll_n_u8(b.val[0], 8), vmovl_u8(b.val[1]));
+        uint16x8_t lo = vshll_n_u8(b.val[2], 8);
+        /* the word goes to the upper 3 bytes, the shift extends the sign */
+        uint32x4_t w0 = vorrq_u32(vshll_n_u16(vget_low_u16(hi), 16), vmovl_u16(vget_low_u16(lo)));
+        uint32x4_t w1 = vorrq_u32(vshll_n_u16(vget_high_u16(hi), 16), vmovl_u16(vget_high_u16(lo)));
+
+        vst1q_s32(data, vshrq_n_s32(vreinterpretq_s32_u32(w0), 8));
+        vst1q_s32(data + 4, vshrq_n_s32(vreinterpretq_s32_u32(w1), 8));
+    }
+    convert_bytes2data_c(num_bytes - k, bytes + k, data);
+}
+#endif
+
+static void convert_select(void);
+static void convert_data2bytes_first(int num_data, const int data[],
+                   unsigned char bytes[]);
+static void convert_bytes2data_first(int num_bytes, const unsigned char bytes[],
+                   int data[]);
+
+/* the first call selects the version for this CPU */
+static void (*convert_data2bytes)(int num_data, const int data[],
+                   unsigned char bytes[]) = convert_data2bytes_first;
+static void (*convert_bytes2data)(int num_bytes, const unsigned char bytes[],
+                   int data[]) = convert_bytes2data_first;
+
+static void convert_select(void)
+{
+#if defined(TFA98XX_CONVERT_SSE41)
+    if (__builtin_cpu_supports("sse4.1")) {
+        convert_data2bytes = convert_data2bytes_sse41;
+        convert_bytes2data = convert_bytes2data_sse41;
+        return;
+    }
+#elif defined(TFA98XX_CONVERT_NEON)
+    /* NEON is part of the target the code was built for */
+    convert_data2bytes = convert_data2bytes_neon;
+    convert_bytes2data = convert_bytes2data_neon;
+    return;
+#endif
+    convert_data2bytes = convert_data2bytes_c;
+    convert_bytes2data = convert_bytes2data_c;
+}
+
+static void convert_data2bytes_first(int num_data, const int data[],
+                   unsigned char bytes[])
+{
+    convert_select();
+    convert_data2bytes(num_data, data, bytes);
+}
+
+static void convert_bytes2data_first(int num_bytes, const unsigned char bytes[],
+                   int data[])
+{
+    convert_select();
+    convert_bytes2data(num_bytes, bytes, data);
+}
+
+/**
+ convert signed 24 bit integers to 3 byte big endian memory words,
+ values outside the 24 bit range are clipped
+   input:  data contains "num_data" int elements
+   output: bytes contains "num_data*3" byte elements
+*/
+void tfa98xx_convert_data2bytes(int num_data, const int data[],
+                   unsigned char bytes[])
+{
+    convert_data2bytes(num_data, data, bytes);
+}
+
+/**
+ convert memory bytes to signed 24 bit integers
+   input:  bytes contains "num_bytes" byte elements
+   output: data contains "num_bytes/3" int24 elements
+ the bytes may be in the upper part of data itself: a word is read before
+ the ints in front of it are written
+*/
+void tfa98xx_convert_bytes2data(int num_bytes, const unsigned char bytes[],
+                   int data[])
+{
+    convert_bytes2data(num_bytes, bytes, data);
+}
@@ -0,0 +1,175 @@
+/*
+ *Copyright 2014 NXP Semiconductors
+ *
+ *Licensed under the Apache License, Version 2.0 (the "License");
+ *you may not use this file except in compliance with the License.
+ *You may obtain a copy of the License at
+ *
+ *http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *Unless required by applicable law or agreed to in writing, software
+ *distributed under the License is distributed on an "AS IS" BASIS,
+ *WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *See the License for the specific language governing permissions and
+ *limitations under the License.
+ */
+
+/*
+ * check and time the SIMD versions of the 24 bit word conversion
+ *  the SIMD result must be the same as the C version for 0..300 words,
+ *  incl the clip limits and a read that converts in place
+ *  the timings are for the sizes the API converts most
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* the static versions are needed, not only the selected one */
+#include "../src/Tfa98xx_convert.c"
+#include "Tfa98API.h"
+
+#if defined(TFA98XX_CONVERT_SSE41)
+#define SIMD_NAME "SSE4.1"
+#define SIMD_AVAILABLE __builtin_cpu_supports("sse4.1")
+#define simd_data2bytes convert_data2bytes_sse41
+#define simd_bytes2data convert_bytes2data_sse41
+#elif defined(TFA98XX_CONVERT_NEON)
+#define SIMD_NAME "NEON"
+#define SIMD_AVAILABLE 1
+#define simd_data2bytes convert_data2bytes_neon
+#define simd_bytes2data convert_bytes2data_neon
+#else
+#define SIMD_NAME "none"
+#define SIMD_AVAILABLE 0
+#define simd_data2bytes convert_data2bytes_c
+#define simd_bytes2data convert_bytes2data_c
+#endif
+
+#define CHECK_WORDS 300
+#define BENCH_WORDS 4096
+#define BENCH_LOOPS (20*1000*1000) /* words per timing */
+
+static int data[BENCH_WORDS], cdata[BENCH_WORDS], sdata[BENCH_WORDS];
+static int inplace[BENCH_WORDS];
+static unsigned char cbytes[BENCH_WORDS*3], sbytes[BENCH_WORDS*3];
+
+static double now(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/* random words, some far outside 24 bits, and the clip limits */
+static void fill(int words)
+{
+    int i;
+
+    for (i = 0; i < words; i++) {
+        if (rand() % 5 == 0)
+            data[i] = (int)((unsigned int)rand() * 2u) - (1 << 30);
+        else
+            data[i] = (rand() % (1 << 24)) - (1 << 23);
+    }
+    if (words >= 6) {
+        data[0] = (1 << 23) - 1;
+        data[1] = -(1 << 23);
+        data[2] = 1 << 23;
+        data[3] = -(1 << 23) - 1;
+        data[4] = 0x7fffffff;
+        data[5] = -0x7fffffff - 1;
+    }
+}
+
+static int check(void)
+{
+    int words, errors = 0;
+
+    for (words = 0; words <= CHECK_WORDS; words++) {
+        fill(words);
+        convert_data2bytes_c(words, data, cbytes);
+        simd_data2bytes(words, data, sbytes);
+        if (memcmp(cbytes, sbytes, words * 3)) {
+            printf("data2bytes differs for %d words\n", words);
+            errors++;
+        }
+        convert_bytes2data_c(words * 3, cbytes, cdata);
+        simd_bytes2data(words * 3, cbytes, sdata);
+        if (memcmp(cdata, sdata, words * sizeof(int))) {
+            printf("bytes2data differs for %d words\n", words);
+            errors++;
+        }
+        /* the bytes in the upper part of the int buffer, as a DSP read has them */
+        memcpy((unsigned char *)inplace + words, cbytes, words * 3);
+        simd_bytes2data(words * 3, (unsigned char *)inplace + words, inplace);
+        if (memcmp(cdata, inplace, words * sizeof(int))) {
+            printf("in place bytes2data differs for %d words\n", words);
+            errors++;
+        }
+    }
+    return errors;
+}
+
+static double time_bytes2data(void (*convert)(int, const unsigned char *, int *), int words)
+{
+    int i, loops = BENCH_LOOPS / words;
+    double t = now();
+
+    for (i = 0; i < loops; i++) {
+        convert(words * 3, cbytes, sdata);
+        __asm__ volatile("" : : "r"(sdata) : "memory");
+    }
+    return (now() - t) / loops / words * 1e9;
+}
+
+static double time_data2bytes(void (*convert)(int, const int *, unsigned char *), int words)
+{
+    int i, loops = BENCH_LOOPS / words;
+    double t = now();
+
+    for (i = 0; i < loops; i++) {
+        convert(words, data, sbytes);
+        __asm__ volatile("" : : "r"(sbytes) : "memory");
+    }
+    return (now() - t) / loops / words * 1e9;
+}
+
+int main(void)
+{
+    static const struct {
+        int words;
+        const char *name;
+    } sizes[] = {
+        { MAX_PARAM_SIZE / 3, "MAX_PARAM_SIZE" },
+        { TFA98XX_SPEAKERPARAMETER_LENGTH / 3, "speaker model" },
+        { BENCH_WORDS, "" },
+    };
+    unsigned int i;
+    int errors;
+
+    if (!SIMD_AVAILABLE) {
+        printf("no SIMD version (%s) for this build or CPU, nothing to check\n", SIMD_NAME);
+        return 0;
+    }
+
+    srand(1);
+    errors = check();
+    printf("%s against C, 0..%d words: %d differences\n", SIMD_NAME, CHECK_WORDS, errors);
+
+    fill(BENCH_WORDS);
+    convert_data2bytes_c(BENCH_WORDS, data, cbytes);
+    printf("ns/word                      bytes->int         int->bytes\n");
+    printf("                             C       %-8s   C       %s\n", SIMD_NAME, SIMD_NAME);
+    for (i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++)
+        printf("%4d words %-16s  %-7.2f %-8.2f   %-7.2f %.2f\n",
+            sizes[i].words, sizes[i].name,
+            time_bytes2data(convert_bytes2data_c, sizes[i].words),
+            time_bytes2data(simd_bytes2data, sizes[i].words),
+            time_data2bytes(convert_data2bytes_c, sizes[i].words),
+            time_data2bytes(simd_data2bytes, sizes[i].words));
+
+    return errors ? 1 : 0;
+}